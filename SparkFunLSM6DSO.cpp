@@ -1,7 +1,34 @@
 
 #include "SparkFunLSM6DSO.h"
 
-LSM6DSOCore::LSM6DSOCore() { }
+#ifdef LSM6DSO_LINUX_I2C
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/ioctl.h>
+  #include <linux/i2c.h>
+  #include <linux/i2c-dev.h>
+#endif
+
+LSM6DSOCore::LSM6DSOCore() 
+{
+  for( uint8_t i = 0; i < SHADOW_LENGTH; i++ )
+    shadowRegs[i] = 0;
+
+  embeddedBankActive = false;
+  scaleChanged = true;
+  configDepth = 0;
+  configAborted = false;
+
+  embeddedDepth = 0;
+  embeddedOpened = false;
+  pageIncCleared = false;
+  embeddedAccess = false;
+
+#ifdef LSM6DSO_LINUX_I2C
+  _i2cFile = -1;
+  _i2cPlainTransfers = false;
+#endif
+}
 
 status_t LSM6DSOCore::beginCore(uint8_t deviceAddress, TwoWire &i2cPort)
 {
@@ -15,9 +42,122 @@ status_t LSM6DSOCore::beginCore(uint8_t deviceAddress, TwoWire &i2cPort)
 	status_t returnError = readRegister(&partID, WHO_AM_I_REG);
 	if( partID != 0x6C && returnError != IMU_SUCCESS)
 		return returnError;
-  else
-    return IMU_SUCCESS;
 
+  return resyncShadow();
+
+}
+
+// Identifies the Wire or SPI port this instance talks over, so sensors
+// sharing a bus can be told apart from ones that don't.
+const void *LSM6DSOCore::getBus()
+{
+  if( commInterface == I2C_MODE )
+    return _i2cPort;
+  if( commInterface == SPI_MODE )
+    return _spiPort;
+  return this;
+}
+
+// SPI mode 3, MSB first. The sensor supports clocks up to 10MHz. Call
+// spiPort.begin() before this, as with Wire.begin() for I2C.
+status_t LSM6DSOCore::beginCoreSPI(uint8_t csPin, uint32_t spiPortSpeed, SPIClass &spiPort)
+{
+
+  commInterface = SPI_MODE;
+  _spiPort = &spiPort;
+  chipSelectPin = csPin;
+  commSettings = SPISettings(spiPortSpeed, MSBFIRST, SPI_MODE3);
+
+  pinMode(chipSelectPin, OUTPUT);
+  digitalWrite(chipSelectPin, HIGH);
+
+	uint8_t partID;
+	status_t returnError = readRegister(&partID, WHO_AM_I_REG);
+	if( returnError != IMU_SUCCESS )
+		return returnError;
+  if( partID != 0x6C )
+    return IMU_HW_ERROR;
+
+  return resyncShadow();
+
+}
+
+#ifdef LSM6DSO_LINUX_I2C
+// Opens an i2c-dev node, e.g. "/dev/i2c-1". Adapters that can do plain I2C
+// transfers get every read as a single I2C_RDWR ioctl (register address
+// write, repeated start, read). SMBus-only adapters, such as the i2c-stub
+// test module, fall back to I2C block transfers of up to 32 bytes.
+status_t LSM6DSOCore::beginCoreLinux(const char *device, uint8_t deviceAddress)
+{
+
+  endCoreLinux();
+
+  commInterface = LINUX_I2C_MODE;
+  I2CAddress = deviceAddress;
+
+  _i2cFile = open(device, O_RDWR);
+  if( _i2cFile < 0 )
+    return IMU_HW_ERROR;
+
+  unsigned long functions = 0;
+  if( ioctl(_i2cFile, I2C_FUNCS, &functions) < 0 ){
+    endCoreLinux();
+    return IMU_HW_ERROR;
+  }
+
+  _i2cPlainTransfers = (functions & I2C_FUNC_I2C) != 0;
+
+  if( !_i2cPlainTransfers ){
+    if( !(functions & I2C_FUNC_SMBUS_I2C_BLOCK) || ioctl(_i2cFile, I2C_SLAVE, deviceAddress) < 0 ){
+      endCoreLinux();
+      return IMU_NOT_SUPPORTED;
+    }
+  }
+
+  // Closed on every failure, so probing several buses or addresses
+  // doesn't leak descriptors.
+	uint8_t partID;
+	status_t returnError = readRegister(&partID, WHO_AM_I_REG);
+	if( returnError == IMU_SUCCESS && partID != 0x6C )
+		returnError = IMU_HW_ERROR;
+	if( returnError == IMU_SUCCESS )
+		returnError = resyncShadow();
+
+	if( returnError != IMU_SUCCESS )
+		endCoreLinux();
+
+	return returnError;
+
+}
+
+LSM6DSOCore::~LSM6DSOCore()
+{
+  endCoreLinux();
+}
+
+void LSM6DSOCore::endCoreLinux()
+{
+  if( _i2cFile >= 0 )
+    close(_i2cFile);
+
+  _i2cFile = -1;
+}
+#endif
+
+// Largest number of bytes a single readMultipleRegisters() call can move on
+// the current interface. Wire buffers are small; SPI is only bounded by the
+// 8 bit length argument.
+uint8_t LSM6DSOCore::maxReadLength()
+{
+  if( commInterface == I2C_MODE )
+    return LSM6DSO_I2C_BUFFER_LENGTH > 255 ? 255 : LSM6DSO_I2C_BUFFER_LENGTH;
+
+#ifdef LSM6DSO_LINUX_I2C
+  if( commInterface == LINUX_I2C_MODE && !_i2cPlainTransfers )
+    return I2C_SMBUS_BLOCK_MAX;
+#endif
+
+  return 255;
 }
 
 
@@ -43,6 +183,14 @@ status_t LSM6DSOCore::readMultipleRegisters(uint8_t outputPointer[], uint8_t add
 	status_t returnError;
   uint8_t byteReturn;
 
+  if( bankBlocks(address) )
+    return IMU_GENERIC_ERROR;
+
+  // Longer than the interface can return in one go: split it up rather
+  // than letting requestFrom() silently truncate.
+  if( numBytes > maxReadLength() )
+    return readBulk(outputPointer, address, numBytes);
+
 	switch( commInterface ){
 
     case I2C_MODE:
@@ -54,14 +202,44 @@ status_t LSM6DSOCore::readMultipleRegisters(uint8_t outputPointer[], uint8_t add
 
       byteReturn = _i2cPort->requestFrom(static_cast<uint8_t>(I2CAddress), static_cast<uint8_t>(numBytes));
 
-      if( byteReturn == 0 )
+      if( byteReturn != numBytes )
         return IMU_HW_ERROR;
 
       for(size_t i = 0; i < numBytes; i++){
          outputPointer[i] =  _i2cPort->read(); 
       }
 
+      updateShadow(outputPointer, address, numBytes);
+      return IMU_SUCCESS;
+
+    case SPI_MODE:
+
+      // The read bit is set on the address; with IF_INC the address
+      // auto-increments for the rest of the burst.
+      _spiPort->beginTransaction(commSettings);
+      digitalWrite(chipSelectPin, LOW);
+
+      _spiPort->transfer(address | SPI_READ_COMMAND);
+      for(size_t i = 0; i < numBytes; i++){
+         outputPointer[i] = _spiPort->transfer(0x00);
+      }
+
+      digitalWrite(chipSelectPin, HIGH);
+      _spiPort->endTransaction();
+
+      updateShadow(outputPointer, address, numBytes);
+      return IMU_SUCCESS;
+
+#ifdef LSM6DSO_LINUX_I2C
+    case LINUX_I2C_MODE:
+
+      returnError = linuxRead(outputPointer, address, numBytes);
+      if( returnError != IMU_SUCCESS )
+        return returnError;
+
+      updateShadow(outputPointer, address, numBytes);
       return IMU_SUCCESS;
+#endif
 
     default:
       return IMU_GENERIC_ERROR;
@@ -69,6 +247,71 @@ status_t LSM6DSOCore::readMultipleRegisters(uint8_t outputPointer[], uint8_t add
   }
 }
 
+//****************************************************************************//
+//  readBulk
+//
+//  Parameters:
+//    *outputPointer -- buffer of at least numBytes
+//    address -- first register to read
+//    numBytes -- number of bytes to read, may exceed the interface's limit
+//
+//  Splits the read into the largest chunks the interface allows. Reads that
+//  start at FIFO_DATA_OUT_TAG use chunks that are a whole number of FIFO
+//  words, so every chunk starts on a tag byte. Each chunk re-sends the
+//  register address the sensor's auto-increment would have reached, and
+//  every chunk must come back complete.
+//****************************************************************************//
+status_t LSM6DSOCore::readBulk(uint8_t outputPointer[], uint8_t address, uint16_t numBytes)
+{
+
+  if( bankBlocks(address) )
+    return IMU_GENERIC_ERROR;
+
+#ifdef LSM6DSO_LINUX_I2C
+  // I2C_RDWR takes 16 bit lengths; no need to split at all.
+  if( commInterface == LINUX_I2C_MODE && _i2cPlainTransfers ){
+    status_t returnError = linuxRead(outputPointer, address, numBytes);
+    if( returnError == IMU_SUCCESS )
+      updateShadow(outputPointer, address, numBytes > 255 ? 255 : numBytes);
+    return returnError;
+  }
+#endif
+
+  uint8_t chunkLimit = maxReadLength();
+  if( address == FIFO_DATA_OUT_TAG && chunkLimit >= FIFO_WORD_LENGTH )
+    chunkLimit -= chunkLimit % FIFO_WORD_LENGTH;
+
+  uint16_t bytesRead = 0;
+  while( bytesRead < numBytes ){
+
+    uint8_t chunk = numBytes - bytesRead > chunkLimit ? chunkLimit : numBytes - bytesRead;
+
+    status_t returnError = readMultipleRegisters(&outputPointer[bytesRead], address, chunk);
+    if( returnError != IMU_SUCCESS )
+      return returnError;
+
+    bytesRead += chunk;
+    address = advanceAddress(address, chunk);
+  }
+
+  return IMU_SUCCESS;
+}
+
+// Register the sensor's pointer reaches after numBytes bytes from address.
+// Without IF_INC it doesn't move; with it, it wraps from FIFO_DATA_OUT_Z_H
+// back to FIFO_DATA_OUT_TAG.
+uint8_t LSM6DSOCore::advanceAddress(uint8_t address, uint16_t numBytes)
+{
+  if( !(readShadow(CTRL3_C) & IF_INC_ENABLED) )
+    return address;
+
+  uint16_t end = address + numBytes;
+  if( end >= FIFO_DATA_OUT_TAG )
+    return FIFO_DATA_OUT_TAG + (end - FIFO_DATA_OUT_TAG) % FIFO_WORD_LENGTH;
+
+  return end;
+}
+
 //****************************************************************************//
 //  readRegister
 //
@@ -81,6 +324,9 @@ status_t LSM6DSOCore::readRegister(uint8_t* outputPointer, uint8_t address) {
 	status_t returnError; 
   uint8_t byteReturn;
 
+  if( bankBlocks(address) )
+    return IMU_GENERIC_ERROR;
+
 	switch (commInterface) {
 
 	case I2C_MODE:
@@ -97,7 +343,33 @@ status_t LSM6DSOCore::readRegister(uint8_t* outputPointer, uint8_t address) {
 
     *outputPointer = _i2cPort->read(); // receive a byte as a proper uint8_t
 
+    updateShadow(outputPointer, address, 1);
+    return IMU_SUCCESS;
+
+	case SPI_MODE:
+
+    _spiPort->beginTransaction(commSettings);
+    digitalWrite(chipSelectPin, LOW);
+
+    _spiPort->transfer(address | SPI_READ_COMMAND);
+    *outputPointer = _spiPort->transfer(0x00);
+
+    digitalWrite(chipSelectPin, HIGH);
+    _spiPort->endTransaction();
+
+    updateShadow(outputPointer, address, 1);
+    return IMU_SUCCESS;
+
+#ifdef LSM6DSO_LINUX_I2C
+  case LINUX_I2C_MODE:
+
+    returnError = linuxRead(outputPointer, address, 1);
+    if( returnError != IMU_SUCCESS )
+      return returnError;
+
+    updateShadow(outputPointer, address, 1);
     return IMU_SUCCESS;
+#endif
 	
   default:
     return IMU_GENERIC_ERROR;
@@ -133,6 +405,12 @@ status_t LSM6DSOCore::writeRegister(uint8_t address, uint8_t dataToWrite) {
 
 	status_t returnError;
 
+  if( bankBlocks(address) )
+    return IMU_GENERIC_ERROR;
+
+  if( stageWrite(&dataToWrite, address, 1) )
+    return IMU_SUCCESS;
+
 	switch (commInterface) {
 
     case I2C_MODE:
@@ -142,7 +420,34 @@ status_t LSM6DSOCore::writeRegister(uint8_t address, uint8_t dataToWrite) {
       _i2cPort->write(dataToWrite);
       if( _i2cPort->endTransmission() != 0 )
         return IMU_HW_ERROR;
+
+      updateShadow(&dataToWrite, address, 1);
+      break;
+
+    case SPI_MODE:
+
+      _spiPort->beginTransaction(commSettings);
+      digitalWrite(chipSelectPin, LOW);
+
+      _spiPort->transfer(address);
+      _spiPort->transfer(dataToWrite);
+
+      digitalWrite(chipSelectPin, HIGH);
+      _spiPort->endTransaction();
+
+      updateShadow(&dataToWrite, address, 1);
+      break;
+
+#ifdef LSM6DSO_LINUX_I2C
+    case LINUX_I2C_MODE:
+
+      returnError = linuxWrite(&dataToWrite, address, 1);
+      if( returnError != IMU_SUCCESS )
+        return returnError;
+
+      updateShadow(&dataToWrite, address, 1);
       break;
+#endif
 
     default:
       break;
@@ -164,6 +469,12 @@ status_t LSM6DSOCore::writeMultipleRegisters(uint8_t inputPointer[], uint8_t add
 
 	status_t returnError;
 
+  if( bankBlocks(address) )
+    return IMU_GENERIC_ERROR;
+
+  if( stageWrite(inputPointer, address, numBytes) )
+    return IMU_SUCCESS;
+
 	switch( commInterface ){
 
     case I2C_MODE:
@@ -177,8 +488,36 @@ status_t LSM6DSOCore::writeMultipleRegisters(uint8_t inputPointer[], uint8_t add
 
       if( _i2cPort->endTransmission() != 0 )
         return IMU_HW_ERROR;
-      else
-        return IMU_SUCCESS;
+
+      updateShadow(inputPointer, address, numBytes);
+      return IMU_SUCCESS;
+
+    case SPI_MODE:
+
+      _spiPort->beginTransaction(commSettings);
+      digitalWrite(chipSelectPin, LOW);
+
+      _spiPort->transfer(address);
+      for(size_t i = 0; i < numBytes; i++){
+         _spiPort->transfer(inputPointer[i]);
+      }
+
+      digitalWrite(chipSelectPin, HIGH);
+      _spiPort->endTransaction();
+
+      updateShadow(inputPointer, address, numBytes);
+      return IMU_SUCCESS;
+
+#ifdef LSM6DSO_LINUX_I2C
+    case LINUX_I2C_MODE:
+
+      returnError = linuxWrite(inputPointer, address, numBytes);
+      if( returnError != IMU_SUCCESS )
+        return returnError;
+
+      updateShadow(inputPointer, address, numBytes);
+      return IMU_SUCCESS;
+#endif
 
     default:
       return IMU_GENERIC_ERROR;
@@ -186,6 +525,122 @@ status_t LSM6DSOCore::writeMultipleRegisters(uint8_t inputPointer[], uint8_t add
   }
 }
 
+#ifdef LSM6DSO_LINUX_I2C
+//****************************************************************************//
+//
+//  Linux i2c-dev transfers
+//
+//****************************************************************************//
+
+// A register read is one combined transaction: the address write and the
+// data read are separated by a repeated start, so nothing else on the bus
+// can move the sensor's register pointer in between. With I2C_RDWR the
+// whole length goes out as one message.
+status_t LSM6DSOCore::linuxRead(uint8_t outputPointer[], uint8_t address, uint16_t numBytes)
+{
+  if( _i2cFile < 0 )
+    return IMU_HW_ERROR;
+
+  if( _i2cPlainTransfers ){
+
+    struct i2c_msg messages[2];
+    messages[0].addr = I2CAddress;
+    messages[0].flags = 0;
+    messages[0].len = 1;
+    messages[0].buf = &address;
+    messages[1].addr = I2CAddress;
+    messages[1].flags = I2C_M_RD;
+    messages[1].len = numBytes;
+    messages[1].buf = outputPointer;
+
+    struct i2c_rdwr_ioctl_data transfer;
+    transfer.msgs = messages;
+    transfer.nmsgs = 2;
+
+    if( ioctl(_i2cFile, I2C_RDWR, &transfer) != 2 )
+      return IMU_HW_ERROR;
+
+    return IMU_SUCCESS;
+  }
+
+  // SMBus adapters: I2C block reads, which are also a write of the
+  // register address followed by a repeated start.
+  uint16_t bytesRead = 0;
+  while( bytesRead < numBytes ){
+
+    uint8_t chunk = numBytes - bytesRead > I2C_SMBUS_BLOCK_MAX ? I2C_SMBUS_BLOCK_MAX : numBytes - bytesRead;
+
+    union i2c_smbus_data data;
+    data.block[0] = chunk;
+
+    struct i2c_smbus_ioctl_data args;
+    args.read_write = I2C_SMBUS_READ;
+    args.command = address;
+    args.size = I2C_SMBUS_I2C_BLOCK_DATA;
+    args.data = &data;
+
+    if( ioctl(_i2cFile, I2C_SMBUS, &args) < 0 || data.block[0] != chunk )
+      return IMU_HW_ERROR;
+
+    memcpy(&outputPointer[bytesRead], &data.block[1], chunk);
+    bytesRead += chunk;
+
+    // Continue where the sensor's auto-increment left off; the FIFO output
+    // registers roll over from FIFO_DATA_OUT_Z_H back to FIFO_DATA_OUT_TAG.
+    for( uint8_t i = 0; i < chunk; i++ )
+      address = (address == FIFO_DATA_OUT_Z_H) ? FIFO_DATA_OUT_TAG : address + 1;
+  }
+
+  return IMU_SUCCESS;
+}
+
+status_t LSM6DSOCore::linuxWrite(const uint8_t inputPointer[], uint8_t address, uint8_t numBytes)
+{
+  if( _i2cFile < 0 )
+    return IMU_HW_ERROR;
+
+  if( _i2cPlainTransfers ){
+
+    uint8_t buffer[256];
+    buffer[0] = address;
+    memcpy(&buffer[1], inputPointer, numBytes);
+
+    struct i2c_msg message;
+    message.addr = I2CAddress;
+    message.flags = 0;
+    message.len = numBytes + 1;
+    message.buf = buffer;
+
+    struct i2c_rdwr_ioctl_data transfer;
+    transfer.msgs = &message;
+    transfer.nmsgs = 1;
+
+    if( ioctl(_i2cFile, I2C_RDWR, &transfer) != 1 )
+      return IMU_HW_ERROR;
+
+    return IMU_SUCCESS;
+  }
+
+  if( numBytes > I2C_SMBUS_BLOCK_MAX )
+    return IMU_NOT_SUPPORTED;
+
+  union i2c_smbus_data data;
+  data.block[0] = numBytes;
+  memcpy(&data.block[1], inputPointer, numBytes);
+
+  struct i2c_smbus_ioctl_data args;
+  args.read_write = I2C_SMBUS_WRITE;
+  args.command = address;
+  args.size = I2C_SMBUS_I2C_BLOCK_DATA;
+  args.data = &data;
+
+  if( ioctl(_i2cFile, I2C_SMBUS, &args) < 0 )
+    return IMU_HW_ERROR;
+
+  return IMU_SUCCESS;
+}
+#endif
+
 
 status_t LSM6DSOCore::enableEmbeddedFunctions(bool enable)
 {
@@ -196,8 +651,6 @@ status_t LSM6DSOCore::enableEmbeddedFunctions(bool enable)
 
   if( enable )
     tempVal |= 0x80;  
-  else
-    tempVal |= 0x7F; 
 
 	status_t returnError = writeRegister( FUNC_CFG_ACCESS, tempVal );
 	return returnError;
@@ -205,93 +658,615 @@ status_t LSM6DSOCore::enableEmbeddedFunctions(bool enable)
 
 //****************************************************************************//
 //
-//  Main user class -- wrapper for the core class + maths
+//  Embedded function bank and advanced feature pages
 //
-//  Construct with same rules as the core ( uint8_t busType, uint8_t inputArg )
+//  openEmbeddedBank() and closeEmbeddedBank() nest, usually through
+//  LSM6DSOEmbeddedBank; only the outermost pair touches FUNC_CFG_ACCESS. A
+//  bank already selected with enableEmbeddedFunctions() is left selected.
+//  While the bank is open this way, plain register calls are refused, so
+//  only the embedded accessors and FUNC_CFG_ACCESS reach the bus.
+//
+//  Page transfers go through PAGE_VALUE, whose PAGE_ADDRESS steps after
+//  every byte. With IF_INC cleared, a burst keeps hitting PAGE_VALUE and
+//  moves a whole run in one transaction instead of one per byte.
 //
 //****************************************************************************//
-LSM6DSO::LSM6DSO() 
+
+status_t LSM6DSOCore::openEmbeddedBank(bool pageBursts)
 {
-	//Construct with these default imuSettings
+  if( embeddedDepth > 0 ){
+    if( embeddedDepth == 0xFF )
+      return IMU_OUT_OF_BOUNDS;
+    embeddedDepth++;
+    return IMU_SUCCESS;
+  }
 
-	imuSettings.gyroEnabled = true;       //Can be 0 or 1
-	imuSettings.gyroRange = 500;          //Max deg/s.  Can be: 125, 250, 500, 1000, 2000
-	imuSettings.gyroSampleRate = 416;     //Hz.  Can be: 13, 26, 52, 104, 208, 416, 833, 1666
-	imuSettings.gyroBandWidth = 400;      //Hz.  Can be: 50, 100, 200, 400;
-	imuSettings.gyroFifoEnabled = 1;      //Set to include gyro in FIFO
-	imuSettings.gyroAccelDecimation = 1;  //Set to include gyro in FIFO
+  // IF_INC lives in the main bank, so it goes first. Inside a configuration
+  // transaction the write would only be staged; page transfers then fall
+  // back to a byte at a time.
+  pageIncCleared = false;
+  if( pageBursts && !embeddedBankActive && configDepth == 0 && (readShadow(CTRL3_C) & IF_INC_ENABLED) ){
+    status_t returnError = writeRegister(CTRL3_C, readShadow(CTRL3_C) & ~IF_INC_ENABLED);
+    if( returnError != IMU_SUCCESS )
+      return returnError;
+    pageIncCleared = true;
+  }
 
-	imuSettings.accelEnabled = true;
-	imuSettings.accelRange = 8;         //Max G force readable.  Can be: 2, 4, 8, 16
-	imuSettings.accelSampleRate = 416;  //Hz.  Can be: 1.6 (16), 12.5 (125), 26, 52, 104, 208, 416, 833, 1660, 3330, 6660
-	imuSettings.accelFifoEnabled = 1;   //Set to include accelerometer in the FIFO
+  embeddedOpened = false;
+  if( !embeddedBankActive ){
+    status_t returnError = enableEmbeddedFunctions(true);
+    if( returnError != IMU_SUCCESS ){
+      if( pageIncCleared )
+        writeRegister(CTRL3_C, readShadow(CTRL3_C) | IF_INC_ENABLED);
+      pageIncCleared = false;
+      return returnError;
+    }
+    embeddedOpened = true;
+  }
 
-  imuSettings.fifoEnabled = true;
-	imuSettings.fifoThreshold = 3000;   //Can be 0 to 4096 (16 bit bytes)
-	imuSettings.fifoSampleRate = 416; 
-	imuSettings.fifoModeWord = 0;       //Default off
+  embeddedDepth = 1;
+  return IMU_SUCCESS;
+}
 
-	allOnesCounter = 0;
-	nonSuccessCounter = 0;
+status_t LSM6DSOCore::closeEmbeddedBank()
+{
+  if( embeddedDepth == 0 )
+    return IMU_GENERIC_ERROR;
 
-}
+  if( --embeddedDepth > 0 )
+    return IMU_SUCCESS;
 
-bool LSM6DSO::begin(uint8_t address, TwoWire &i2cPort){
+  status_t returnError = IMU_SUCCESS;
+  if( embeddedOpened )
+    returnError = enableEmbeddedFunctions(false);
 
-  if( address != DEFAULT_ADDRESS && address != ALT_ADDRESS )
-    return false;
+  // Only once back in the main bank; otherwise the write would land on
+  // EMB_FUNC_STATUS.
+  if( pageIncCleared && returnError == IMU_SUCCESS )
+    returnError = writeRegister(CTRL3_C, readShadow(CTRL3_C) | IF_INC_ENABLED);
 
-  uint8_t regVal;
-	status_t returnError = beginCore(address, i2cPort);
-  if( returnError != IMU_SUCCESS )
-    return false;
-  else
-    return true; 
-  
+  embeddedOpened = false;
+  pageIncCleared = false;
+  return returnError;
 }
 
+// Address: embedded bank
+// Reads or writes embedded function registers, switching banks only if no
+// LSM6DSOEmbeddedBank is already held.
+status_t LSM6DSOCore::readEmbedded(uint8_t outputPointer[], uint8_t address, uint8_t numBytes)
+{
+  LSM6DSOEmbeddedBank bank(*this);
+  if( bank.getStatus() != IMU_SUCCESS )
+    return bank.getStatus();
 
-bool LSM6DSO::initialize(uint8_t settings){
+  embeddedAccess = true;
+  status_t returnError = readMultipleRegisters(outputPointer, address, numBytes);
+  embeddedAccess = false;
 
-  setIncrement();
+  return returnError;
+}
 
-  if( settings == BASIC_SETTINGS ){
-    setAccelRange(8);
-    setAccelDataRate(416);
-    setGyroRange(500);
-    setGyroDataRate(416);
-    setBlockDataUpdate(true);
-  }
- 
+status_t LSM6DSOCore::writeEmbedded(uint8_t inputPointer[], uint8_t address, uint8_t numBytes)
+{
+  LSM6DSOEmbeddedBank bank(*this);
+  if( bank.getStatus() != IMU_SUCCESS )
+    return bank.getStatus();
 
-  return true;
+  embeddedAccess = true;
+  status_t returnError = writeMultipleRegisters(inputPointer, address, numBytes);
+  embeddedAccess = false;
 
+  return returnError;
 }
 
-status_t LSM6DSO::beginSettings() {
+// Address: page in bits[11:8], address within it in bits[7:0]
+// Reads numBytes from the advanced feature pages.
+status_t LSM6DSOCore::readPage(uint8_t outputPointer[], uint16_t address, uint16_t numBytes)
+{
+  return pageTransfer(outputPointer, address, numBytes, PAGE_READ_ENABLED);
+}
 
-	uint8_t dataToWrite = 0;  //Temporary variable
+// writeMultipleRegisters() doesn't modify the buffer it is given.
+status_t LSM6DSOCore::writePage(const uint8_t inputPointer[], uint16_t address, uint16_t numBytes)
+{
+  return pageTransfer(const_cast<uint8_t*>(inputPointer), address, numBytes, PAGE_WRITE_ENABLED);
+}
 
-	//Setup the accelerometer******************************
-	dataToWrite = 0; //Start Fresh!
-	if ( imuSettings.accelEnabled == 1) {
-    //Range
-		switch (imuSettings.accelRange) {
-		case 2:
-			dataToWrite |= FS_XL_2g;
-			break;
-		case 4:
-			dataToWrite |= FS_XL_4g;
-			break;
-		case 8:
-			dataToWrite |= FS_XL_8g;
-			break;
-		default:  //set default case to 16(max)
-		case 16:
-			dataToWrite |= FS_XL_16g;
-			break;
-		}
-		// Accelerometer ODR
+// Selects the page and address once per page touched and moves the bytes
+// in the largest bursts the interface and IF_INC allow. A Wire write shares
+// its buffer with the register address, hence one byte less than a read.
+status_t LSM6DSOCore::pageTransfer(uint8_t data[], uint16_t address, uint16_t numBytes, uint8_t direction)
+{
+  if( numBytes == 0 )
+    return IMU_SUCCESS;
+  if( static_cast<uint32_t>(address) + numBytes > (static_cast<uint32_t>(PAGE_LAST) + 1) << 8 )
+    return IMU_OUT_OF_BOUNDS;
+
+  LSM6DSOEmbeddedBank bank(*this, numBytes > 1);
+  if( bank.getStatus() != IMU_SUCCESS )
+    return bank.getStatus();
+
+  uint8_t chunkLimit = 1;
+  if( !(readShadow(CTRL3_C) & IF_INC_ENABLED) )
+    chunkLimit = direction == PAGE_READ_ENABLED ? maxReadLength() : maxReadLength() - 1;
+
+  // EMB_FUNC_LIR shares PAGE_RW and is kept.
+  uint8_t pageRw;
+  status_t returnError = readEmbedded(&pageRw, PAGE_RW, 1);
+  if( returnError != IMU_SUCCESS )
+    return returnError;
+
+  uint8_t regVal = (pageRw & PAGE_RW_MASK) | direction;
+  returnError = writeEmbedded(&regVal, PAGE_RW, 1);
+
+  uint16_t done = 0;
+  while( returnError == IMU_SUCCESS && done < numBytes ){
+
+    uint16_t position = address + done;
+    uint8_t page = position >> 8;
+    uint8_t offset = position & 0xFF;
+
+    regVal = (page << PAGE_SEL_SHIFT) | PAGE_SEL_RESERVED;
+    returnError = writeEmbedded(&regVal, PAGE_SEL, 1);
+    if( returnError == IMU_SUCCESS )
+      returnError = writeEmbedded(&offset, PAGE_ADDRESS, 1);
+
+    // PAGE_ADDRESS wraps at the end of the page without moving PAGE_SEL.
+    uint16_t run = 256 - offset;
+    if( run > numBytes - done )
+      run = numBytes - done;
+
+    while( returnError == IMU_SUCCESS && run > 0 ){
+
+      uint8_t chunk = run > chunkLimit ? chunkLimit : run;
+
+      if( direction == PAGE_READ_ENABLED )
+        returnError = readEmbedded(&data[done], PAGE_VALUE, chunk);
+      else
+        returnError = writeEmbedded(&data[done], PAGE_VALUE, chunk);
+
+      done += chunk;
+      run -= chunk;
+    }
+  }
+
+  regVal = pageRw & PAGE_RW_MASK;
+  status_t clearError = writeEmbedded(&regVal, PAGE_RW, 1);
+
+  return returnError != IMU_SUCCESS ? returnError : clearError;
+}
+
+//****************************************************************************//
+//
+//  Register write scripts
+//
+//****************************************************************************//
+
+// Plays a script from program memory (see SCRIPT_END and friends), each
+// burst through writeMultipleRegisters() in pieces the interface can take.
+// Bank switches are the script's own FUNC_CFG_ACCESS writes. Scripts are
+// compiled for IF_INC set at the start, as after reset; refused inside a
+// configuration transaction, where main bank writes would be staged and
+// fall out of order with the bank switches.
+status_t LSM6DSOCore::writeScript(const uint8_t script[])
+{
+  if( configDepth > 0 || embeddedDepth > 0 )
+    return IMU_GENERIC_ERROR;
+  if( !(readShadow(CTRL3_C) & IF_INC_ENABLED) )
+    return IMU_GENERIC_ERROR;
+
+  uint8_t chunkLimit = maxReadLength() - 1;
+  if( chunkLimit > LSM6DSO_SCRIPT_CHUNK )
+    chunkLimit = LSM6DSO_SCRIPT_CHUNK;
+
+  uint8_t buffer[LSM6DSO_SCRIPT_CHUNK];
+  uint16_t position = 0;
+
+  while( true ){
+
+    uint8_t code = pgm_read_byte(&script[position++]);
+
+    if( code == SCRIPT_END )
+      return IMU_SUCCESS;
+
+    if( code == SCRIPT_WAIT ){
+      uint16_t milliseconds = pgm_read_byte(&script[position]) |
+                              static_cast<uint16_t>(pgm_read_byte(&script[position + 1]) << 8);
+      position += 2;
+      delay(milliseconds);
+      continue;
+    }
+
+    if( code == SCRIPT_INC_OFF || code == SCRIPT_INC_ON ){
+      if( embeddedBankActive )
+        return IMU_GENERIC_ERROR;
+
+      uint8_t regVal = readShadow(CTRL3_C) & ~IF_INC_ENABLED;
+      if( code == SCRIPT_INC_ON )
+        regVal |= IF_INC_ENABLED;
+
+      status_t returnError = writeRegister(CTRL3_C, regVal);
+      if( returnError != IMU_SUCCESS )
+        return returnError;
+      continue;
+    }
+
+    uint8_t address = pgm_read_byte(&script[position++]);
+    uint8_t remaining = code;
+
+    while( remaining > 0 ){
+
+      uint8_t chunk = remaining > chunkLimit ? chunkLimit : remaining;
+      for( uint8_t i = 0; i < chunk; i++ )
+        buffer[i] = pgm_read_byte(&script[position++]);
+
+      status_t returnError = writeMultipleRegisters(buffer, address, chunk);
+      if( returnError != IMU_SUCCESS )
+        return returnError;
+
+      address = advanceAddress(address, chunk);
+      remaining -= chunk;
+    }
+  }
+}
+
+// Whether an access has to be refused because an open embedded bank would
+// take it for one of its own registers.
+bool LSM6DSOCore::bankBlocks(uint8_t address)
+{
+  return embeddedDepth > 0 && !embeddedAccess && address != FUNC_CFG_ACCESS;
+}
+
+//****************************************************************************//
+//
+//  Register shadow
+//
+//  Every successful read or write that touches FIFO_CTRL1 (0x07) through
+//  CTRL10_C (0x19) or TAP_CFG0 (0x56) through TAP_CFG2 (0x58) in the main
+//  register bank is mirrored into shadowRegs. Writes to FUNC_CFG_ACCESS are
+//  tracked so that accesses made while the embedded function bank is
+//  selected don't corrupt the copy.
+//
+//****************************************************************************//
+
+// Re-reads both shadowed regions. Call this after anything that changes the
+// registers behind the driver's back, e.g. a software reset or a reboot of
+// the memory content.
+status_t LSM6DSOCore::resyncShadow()
+{
+  uint8_t tempVal[SHADOW_MAIN_LENGTH];
+
+  if( embeddedBankActive )
+    return IMU_GENERIC_ERROR;
+
+  status_t returnError = readMultipleRegisters(tempVal, SHADOW_FIRST_REG, SHADOW_MAIN_LENGTH);
+  if( returnError != IMU_SUCCESS )
+    return returnError;
+
+  return readMultipleRegisters(tempVal, SHADOW_TAP_FIRST_REG, SHADOW_TAP_LENGTH);
+}
+
+// Returns the last known value of a shadowed register without touching the
+// bus. Inside a configuration transaction this is the staged value.
+// Addresses outside the shadowed regions return zero.
+uint8_t LSM6DSOCore::readShadow(uint8_t address)
+{
+  uint8_t index = shadowIndex(address);
+  if( index == SHADOW_NONE )
+    return 0;
+
+  if( configDepth > 0 )
+    return stagedRegs[index];
+
+  return shadowRegs[index];
+}
+
+uint8_t LSM6DSOCore::shadowIndex(uint8_t address)
+{
+  if( address >= SHADOW_FIRST_REG && address <= SHADOW_LAST_REG )
+    return address - SHADOW_FIRST_REG;
+
+  if( address >= SHADOW_TAP_FIRST_REG && address <= SHADOW_TAP_LAST_REG )
+    return SHADOW_MAIN_LENGTH + address - SHADOW_TAP_FIRST_REG;
+
+  return SHADOW_NONE;
+}
+
+uint8_t LSM6DSOCore::shadowAddress(uint8_t index)
+{
+  if( index < SHADOW_MAIN_LENGTH )
+    return SHADOW_FIRST_REG + index;
+
+  return SHADOW_TAP_FIRST_REG + index - SHADOW_MAIN_LENGTH;
+}
+
+void LSM6DSOCore::updateShadow(const uint8_t data[], uint8_t address, uint8_t numBytes)
+{
+  for( uint16_t i = 0; i < numBytes; i++ ){
+
+    uint16_t reg = address + i;
+    if( reg > SHADOW_TAP_LAST_REG )
+      break;
+
+    if( reg == FUNC_CFG_ACCESS ){
+      embeddedBankActive = (data[i] & 0x80) != 0;
+      continue;
+    }
+
+    uint8_t index = shadowIndex(reg);
+    if( embeddedBankActive || index == SHADOW_NONE )
+      continue;
+
+    // BOOT, SW_RESET and RST_COUNTER_BDR clear themselves; keeping them
+    // would make a later burst that rewrites their register reset again.
+    if( reg == CTRL3_C )
+      shadowRegs[index] = data[i] & ~(BOOT_REBOOT_MODE | SW_RESET_DEVICE);
+    else if( reg == COUNTER_BDR_REG1 )
+      shadowRegs[index] = data[i] & ~RST_COUNTER_BDR_ENABLED;
+    else
+      shadowRegs[index] = data[i];
+
+    if( reg == CTRL1_XL || reg == CTRL2_G || reg == CTRL8_XL )
+      scaleChanged = true;
+  }
+}
+
+//****************************************************************************//
+//
+//  Configuration transactions
+//
+//  Between beginConfig() and commitConfig(), writes to shadowed registers
+//  are collected in stagedRegs instead of going to the sensor, and
+//  readShadow() answers from the staged copy so read-modify-write setters
+//  build on each other. commitConfig() then writes only the registers that
+//  differ from the shadow, as a few multi-register bursts.
+//
+//  Transactions nest; only the outermost commitConfig() touches the bus.
+//
+//****************************************************************************//
+
+void LSM6DSOCore::beginConfig()
+{
+  if( configDepth++ > 0 )
+    return;
+
+  for( uint8_t i = 0; i < SHADOW_LENGTH; i++ )
+    stagedRegs[i] = shadowRegs[i];
+}
+
+// Ends the innermost transaction and marks the whole one failed: nested
+// levels share the staged copy, so the outer callers keep staging and the
+// outermost commitConfig() drops everything and reports the failure.
+void LSM6DSOCore::abortConfig()
+{
+  if( configDepth == 0 )
+    return;
+
+  configAborted = true;
+  if( --configDepth == 0 )
+    configAborted = false;
+}
+
+status_t LSM6DSOCore::commitConfig()
+{
+  if( configDepth == 0 )
+    return IMU_GENERIC_ERROR;
+
+  if( --configDepth > 0 )
+    return IMU_SUCCESS;
+
+  if( configAborted ){
+    configAborted = false;
+    return IMU_GENERIC_ERROR;
+  }
+
+  // Bursts need IF_INC; without it every register is written on its own.
+  bool burst = (readShadow(CTRL3_C) & IF_INC_ENABLED) != 0;
+
+  uint8_t first = 0;
+  while( first < SHADOW_LENGTH ){
+
+    if( stagedRegs[first] == shadowRegs[first] ){
+      first++;
+      continue;
+    }
+
+    // Extend the run over following dirty registers. Up to
+    // CONFIG_MERGE_GAP unchanged registers in between are rewritten with
+    // their current value, which is cheaper than starting a new transfer.
+    // Runs never cross into the other shadowed region or over WHO_AM_I.
+    uint8_t last = first;
+    for( uint8_t next = first + 1; burst && next < SHADOW_LENGTH; next++ ){
+
+      if( shadowAddress(next) != shadowAddress(next - 1) + 1 || shadowAddress(next) == WHO_AM_I_REG )
+        break;
+      if( next - last > CONFIG_MERGE_GAP + 1 )
+        break;
+
+      if( stagedRegs[next] != shadowRegs[next] )
+        last = next;
+    }
+
+    status_t returnError = writeMultipleRegisters(&stagedRegs[first], shadowAddress(first), last - first + 1);
+    if( returnError != IMU_SUCCESS )
+      return returnError;
+
+    first = last + 1;
+  }
+
+  return IMU_SUCCESS;
+}
+
+// Takes a write into the staged copy if every byte lands on a writable
+// shadowed register of the main bank. Returns false if the write has to go
+// to the bus.
+bool LSM6DSOCore::stageWrite(const uint8_t data[], uint8_t address, uint8_t numBytes)
+{
+  if( configDepth == 0 || embeddedBankActive )
+    return false;
+
+  for( uint16_t i = 0; i < numBytes; i++ ){
+    uint16_t reg = address + i;
+    if( reg > SHADOW_TAP_LAST_REG || reg == WHO_AM_I_REG || shadowIndex(reg) == SHADOW_NONE )
+      return false;
+  }
+
+  for( uint8_t i = 0; i < numBytes; i++ )
+    stagedRegs[shadowIndex(address + i)] = data[i];
+
+  return true;
+}
+
+//****************************************************************************//
+//
+//  Main user class -- wrapper for the core class + maths
+//
+//  Construct with same rules as the core ( uint8_t busType, uint8_t inputArg )
+//
+//****************************************************************************//
+LSM6DSO::LSM6DSO() 
+{
+	//Construct with these default imuSettings
+
+	imuSettings.gyroEnabled = true;       //Can be 0 or 1
+	imuSettings.gyroRange = 500;          //Max deg/s.  Can be: 125, 250, 500, 1000, 2000
+	imuSettings.gyroSampleRate = 416;     //Hz.  Can be: 13, 26, 52, 104, 208, 416, 833, 1666
+	imuSettings.gyroBandWidth = 400;      //Hz.  Can be: 50, 100, 200, 400;
+	imuSettings.gyroFifoEnabled = 1;      //Set to include gyro in FIFO
+	imuSettings.gyroAccelDecimation = 1;  //Set to include gyro in FIFO
+
+	imuSettings.accelEnabled = true;
+	imuSettings.accelRange = 8;         //Max G force readable.  Can be: 2, 4, 8, 16
+	imuSettings.accelSampleRate = 416;  //Hz.  Can be: 1.6 (16), 12.5 (125), 26, 52, 104, 208, 416, 833, 1660, 3330, 6660
+	imuSettings.accelFifoEnabled = 1;   //Set to include accelerometer in the FIFO
+
+  imuSettings.fifoEnabled = true;
+	imuSettings.fifoThreshold = 500;    //Can be 0 to 511 (7 byte words)
+	imuSettings.fifoSampleRate = 416; 
+	imuSettings.fifoModeWord = 0;       //Default off
+
+	allOnesCounter = 0;
+	nonSuccessCounter = 0;
+
+  accelSensitivity = 0;
+  gyroSensitivity = 0;
+  accelMilliMultiplier = 0;
+  gyroMilliMultiplier = 0;
+
+  resetPollStatistics();
+
+  tickPicoseconds = TIMESTAMP_TICK_PS;
+  lastTimestampLow = 0;
+  timestampHigh = 0;
+  lastFifoTimestampLow = 0;
+  fifoTimestampHigh = 0;
+
+  resetFifoDecoder();
+
+}
+
+bool LSM6DSO::begin(uint8_t address, TwoWire &i2cPort){
+
+  if( address != DEFAULT_ADDRESS && address != ALT_ADDRESS )
+    return false;
+
+  uint8_t regVal;
+	status_t returnError = beginCore(address, i2cPort);
+  if( returnError != IMU_SUCCESS )
+    return false;
+  else
+    return true; 
+  
+}
+
+bool LSM6DSO::beginSPI(uint8_t csPin, uint32_t spiPortSpeed, SPIClass &spiPort){
+
+  if( spiPortSpeed > 10000000 )
+    return false;
+
+	status_t returnError = beginCoreSPI(csPin, spiPortSpeed, spiPort);
+  if( returnError != IMU_SUCCESS )
+    return false;
+  else
+    return true; 
+}
+
+#ifdef LSM6DSO_LINUX_I2C
+// device is the i2c-dev node the sensor hangs off, e.g. "/dev/i2c-1".
+bool LSM6DSO::beginLinux(const char *device, uint8_t address){
+
+  if( address != DEFAULT_ADDRESS && address != ALT_ADDRESS )
+    return false;
+
+	status_t returnError = beginCoreLinux(device, address);
+  if( returnError != IMU_SUCCESS )
+    return false;
+  else
+    return true; 
+}
+#endif
+
+
+bool LSM6DSO::initialize(uint8_t settings){
+
+  setIncrement();
+
+  // Everything below is staged and written in a couple of bursts.
+  beginConfig();
+
+  if( settings == BASIC_SETTINGS ){
+    setAccelRange(8);
+    setAccelDataRate(416);
+    setGyroRange(500);
+    setGyroDataRate(416);
+    setBlockDataUpdate(true);
+  }
+
+  if( settings == FIFO_SETTINGS ){
+    setAccelRange(8);
+    setAccelDataRate(416);
+    setGyroRange(500);
+    setGyroDataRate(416);
+    setFifoDepth(imuSettings.fifoThreshold);
+    setAccelBatchDataRate(416);
+    setGyroBatchDataRate(416);
+    setFifoMode(FIFO_MODE_CONTINUOUS);
+  }
+
+  if( commitConfig() != IMU_SUCCESS )
+    return false;
+
+  return true;
+
+}
+
+status_t LSM6DSO::beginSettings() {
+
+	uint8_t dataToWrite = 0;  //Temporary variable
+
+  // CTRL1_XL and CTRL2_G go out as one burst.
+  beginConfig();
+
+	//Setup the accelerometer******************************
+	dataToWrite = 0; //Start Fresh!
+	if ( imuSettings.accelEnabled == 1) {
+    //Range
+		switch (imuSettings.accelRange) {
+		case 2:
+			dataToWrite |= FS_XL_2g;
+			break;
+		case 4:
+			dataToWrite |= FS_XL_4g;
+			break;
+		case 8:
+			dataToWrite |= FS_XL_8g;
+			break;
+		default:  //set default case to 16(max)
+		case 16:
+			dataToWrite |= FS_XL_16g;
+			break;
+		}
+		// Accelerometer ODR
 		switch (imuSettings.accelSampleRate) {
 		case 16:
 			dataToWrite |= ODR_XL_1_6Hz;
@@ -393,7 +1368,7 @@ status_t LSM6DSO::beginSettings() {
   // Write the gyroscope imuSettings. 
 	writeRegister(CTRL2_G, dataToWrite);
 
-	return IMU_SUCCESS;
+	return commitConfig();
 }
 
 
@@ -402,15 +1377,12 @@ status_t LSM6DSO::beginSettings() {
 // the FIFO buffer.
 bool LSM6DSO::setBlockDataUpdate(bool enable){
 
-  uint8_t regVal;
-  status_t returnError = readRegister(&regVal, CTRL3_C); 
-  if( returnError != IMU_SUCCESS )
-    return false;
+  uint8_t regVal = readShadow(CTRL3_C);
     
   regVal &= 0xBF;
   regVal |= BDU_BLOCK_UPDATE;   
 
-  returnError = writeRegister(CTRL3_C, regVal);  			
+  status_t returnError = writeRegister(CTRL3_C, regVal);  			
   if( returnError != IMU_SUCCESS )
     return false;
   else 
@@ -421,44 +1393,153 @@ bool LSM6DSO::setBlockDataUpdate(bool enable){
 
 
 
-// Address:0x15 , bit[4]: default value is: 0x00
-// Sets whether high performance mode is on for the acclerometer, by default it is ON.
-bool LSM6DSO::setHighPerfAccel(bool enable){
+// Address:0x15 , bit[4]: default value is: 0x00
+// Sets whether high performance mode is on for the acclerometer, by default it is ON.
+bool LSM6DSO::setHighPerfAccel(bool enable){
+
+  uint8_t regVal = readShadow(CTRL6_C);
+
+  if( enable )
+    regVal |=  HIGH_PERF_ACC_ENABLE; 
+  else
+    regVal |=  HIGH_PERF_ACC_DISABLE; 
+
+  status_t returnError = writeRegister(CTRL6_C, regVal);
+  if( returnError != IMU_SUCCESS )
+    return false; 
+  else
+    return true;
+}
+
+// Address:0x16 , bit[7]: default value is: 0x00
+// Sets whether high performance mode is on for the gyroscope, by default it is ON.
+bool LSM6DSO::setHighPerfGyro(bool enable){
+
+  uint8_t regVal = readShadow(CTRL7_G);
+
+  if( enable )
+    regVal |=  HIGH_PERF_GYRO_ENABLE; 
+  else
+    regVal |=  HIGH_PERF_GYRO_DISABLE; 
+
+  status_t returnError = writeRegister(CTRL7_G, regVal);
+  if( returnError != IMU_SUCCESS )
+    return false; 
+  else
+    return true;
+}
+
+// Address: 0x73 - 0x75, CTRL6_C bit[3]
+// Loads the accelerometer user offset, one signed byte per axis in units of
+// the weight: USER_OFFSET_2_10 (2^-10 g, up to +-0.124g) or USER_OFFSET_2_6
+// (2^-6 g, up to +-1.98g). The sensor subtracts it from every sample once
+// enableAccelUserOffset() is on.
+bool LSM6DSO::setAccelUserOffset(const int8_t offset[], uint8_t weight){
+
+  uint8_t values[3];
+  for( uint8_t i = 0; i < 3; i++ )
+    values[i] = static_cast<uint8_t>(offset[i]);
+
+  status_t returnError = writeMultipleRegisters(values, X_OFS_USR, 3);
+  if( returnError != IMU_SUCCESS )
+    return false;
+
+  uint8_t regVal = readShadow(CTRL6_C);
+
+  regVal &= USER_OFFSET_MASK;
+  regVal |= (weight & ~USER_OFFSET_MASK);
+
+  returnError = writeRegister(CTRL6_C, regVal);
+  if( returnError != IMU_SUCCESS )
+    return false;
+  else
+    return true;
+}
+
+// Address: 0x73 - 0x75, CTRL6_C bit[3]
+// Reads back the user offset and its weight.
+bool LSM6DSO::getAccelUserOffset(int8_t offset[], uint8_t &weight){
+
+  uint8_t values[3];
+
+  status_t returnError = readMultipleRegisters(values, X_OFS_USR, 3);
+  if( returnError != IMU_SUCCESS )
+    return false;
+
+  for( uint8_t i = 0; i < 3; i++ )
+    offset[i] = static_cast<int8_t>(values[i]);
+  weight = readShadow(CTRL6_C) & ~USER_OFFSET_MASK;
+
+  return true;
+}
+
+// Address: 0x16, bit[1]: default value is: 0x00
+// Applies the user offset to the output registers and the FIFO.
+bool LSM6DSO::enableAccelUserOffset(bool enable){
+
+  uint8_t regVal = readShadow(CTRL7_G);
+
+  regVal &= USR_OFF_ON_OUT_MASK;
+  if( enable )
+    regVal |= USR_OFF_ON_OUT_ENABLED;
+
+  status_t returnError = writeRegister(CTRL7_G, regVal);
+  if( returnError != IMU_SUCCESS )
+    return false;
+  else
+    return true;
+}
+
+//****************************************************************************//
+//
+//  Interrupt section
+//
+//****************************************************************************//
+
+// Address: 0x0D: default value is: 0x00
+// Routes interrupt sources to the INT1 pin. Pass the LSM6DSO_INT1_*_t values
+// OR'd together, e.g. INT1_FIFO_TH_ENABLED | INT1_FIFO_OVR_ENABLED. Replaces
+// the current routing.
+bool LSM6DSO::setInterruptOne(uint8_t setting) {
 
-  uint8_t regVal;
-  status_t returnError = readRegister(&regVal, CTRL6_C);
+  status_t returnError = writeRegister(INT1_CTRL, setting);
   if( returnError != IMU_SUCCESS )
-    return false; 
-
-  if( enable )
-    regVal |=  HIGH_PERF_ACC_ENABLE; 
+    return false;
   else
-    regVal |=  HIGH_PERF_ACC_DISABLE; 
+    return true;
+}
 
-  returnError = writeRegister(CTRL6_C, regVal);
+// Address: 0x0E: default value is: 0x00
+// Routes interrupt sources to the INT2 pin, see LSM6DSO_INT2_*_t.
+bool LSM6DSO::setInterruptTwo(uint8_t setting) {
+
+  status_t returnError = writeRegister(INT2_CTRL, setting);
   if( returnError != IMU_SUCCESS )
-    return false; 
+    return false;
   else
     return true;
 }
 
-// Address:0x16 , bit[7]: default value is: 0x00
-// Sets whether high performance mode is on for the gyroscope, by default it is ON.
-bool LSM6DSO::setHighPerfGyro(bool enable){
+// Address: 0x0B, bit[5] and bit[2:0], 0x0C, bit[7:0]: default value is: 0x00
+// Sets how many batched samples raise the INT1_CNT_BDR/INT2_CNT_BDR interrupt.
+// The counter follows the gyroscope batch rate when gyroTrigger is set and
+// the accelerometer batch rate otherwise.
+bool LSM6DSO::setBatchCounterThreshold(uint16_t threshold, bool gyroTrigger) {
 
-  uint8_t regVal;
-  status_t returnError = readRegister(&regVal, CTRL7_G);
-  if( returnError != IMU_SUCCESS )
-    return false; 
+  if( threshold > 0x07FF )
+    return false;
 
-  if( enable )
-    regVal |=  HIGH_PERF_GYRO_ENABLE; 
-  else
-    regVal |=  HIGH_PERF_GYRO_DISABLE; 
+  uint8_t regVal[2];
+  // Keeps the pulsed mode bit, never RST_COUNTER_BDR.
+  regVal[0] = readShadow(COUNTER_BDR_REG1) & 0x98;
+  regVal[0] |= (threshold >> 8) & 0x07;
+  if( gyroTrigger )
+    regVal[0] |= 0x20;
+  regVal[1] = threshold & 0xFF;
 
-  returnError = writeRegister(CTRL7_G, regVal);
+  status_t returnError = writeMultipleRegisters(regVal, COUNTER_BDR_REG1, 2);
   if( returnError != IMU_SUCCESS )
-    return false; 
+    return false;
   else
     return true;
 }
@@ -476,13 +1557,8 @@ bool LSM6DSO::setAccelRange(uint8_t range) {
   if( range < 0  | range > 16)
     return false; 
 
-  uint8_t regVal;
-  uint8_t fullScale; 
-  status_t returnError = readRegister(&regVal, CTRL1_XL);
-  if( returnError != IMU_SUCCESS )
-      return false;
-
-  fullScale = getAccelFullScale();
+  uint8_t regVal = readShadow(CTRL1_XL);
+  uint8_t fullScale = getAccelFullScale();
 
   // Can't have 16g with XL_FS_MODE == 1
   if( fullScale == 1 && range == 16 )
@@ -507,7 +1583,7 @@ bool LSM6DSO::setAccelRange(uint8_t range) {
       break;
   }
 
-  returnError = writeRegister(CTRL1_XL, regVal);
+  status_t returnError = writeRegister(CTRL1_XL, regVal);
   if( returnError != IMU_SUCCESS )
       return false;
   else
@@ -523,13 +1599,8 @@ bool LSM6DSO::setAccelDataRate(uint16_t rate) {
   if( rate < 16  | rate > 6660) 
     return false; 
 
-  uint8_t regVal;
-  uint8_t highPerf;
-  status_t returnError = readRegister(&regVal, CTRL1_XL);
-  if( returnError != IMU_SUCCESS )
-      return false;
-
-  highPerf = getAccelHighPerf();
+  uint8_t regVal = readShadow(CTRL1_XL);
+  uint8_t highPerf = getAccelHighPerf();
 
   // Can't have 1.6Hz and have high performance mode enabled.
   if( highPerf == 0 && rate == 16 ) 
@@ -578,7 +1649,7 @@ bool LSM6DSO::setAccelDataRate(uint16_t rate) {
       break;
   }
 
-  returnError = writeRegister(CTRL1_XL, regVal);
+  status_t returnError = writeRegister(CTRL1_XL, regVal);
   if( returnError != IMU_SUCCESS )
       return false;
   else
@@ -587,356 +1658,1155 @@ bool LSM6DSO::setAccelDataRate(uint16_t rate) {
 
 
 
+// Address: 0x1E, bit[2:0]
+// Returns the data ready flags, ACCEL_DATA_READY, GYRO_DATA_READY and
+// TEMP_DATA_READY, or 0 if the read failed. pollAll() gets the flags and
+// the data together.
+uint8_t LSM6DSO::listenDataReady(){
+
+  uint8_t regVal;
+  status_t returnError = readRegister(&regVal, STATUS_REG);
+  if( returnError != IMU_SUCCESS ){
+    nonSuccessCounter++;
+    return 0;
+  }
+
+  return regVal & ALL_DATA_READY;
+}
+
 // Address: 0x15, bit[4]: default value is: 0x00 (Enabled)
 // Checks wheter high performance is enabled or disabled. 
 uint8_t LSM6DSO::getAccelHighPerf(){
 
-  uint8_t regVal;
-  status_t returnError = readRegister(&regVal, CTRL6_C);
+  uint8_t regVal = readShadow(CTRL6_C);
+  return ((regVal & 0x10) >> 4); 
+
+}
+
+// Address: 0x17, bit[2]: default value is: 0x00 
+// Checks whether the acclerometer is using "old" full scale or "new", see
+// datasheet for more information.
+uint8_t LSM6DSO::getAccelFullScale(){
+
+  uint8_t regVal = readShadow(CTRL8_XL);
+  return ((regVal & 0x02) >> 1); 
+}
+
+// Address: 0x10, bit[3:2]
+// Returns the accelerometer's range in g, answered from the register shadow.
+uint8_t LSM6DSO::getAccelRange(){
+
+  uint8_t regVal = readShadow(CTRL1_XL);
+
+  switch( (regVal >> 2) & 0x03 ){
+    case 0:
+      return 2;
+    case 1:
+      return getAccelFullScale() ? 2 : 16;
+    case 2:
+      return 4;
+    case 3:
+    default:
+      return 8;
+  }
+}
+
+// Address: 0x10, bit[7:4]
+// Returns the accelerometer's output data rate in Hz, answered from the
+// register shadow. Zero means the accelerometer is powered down. The 1.6Hz
+// code only runs at 1.6Hz in low power mode (CTRL6_C XL_HM_MODE set); in
+// high performance mode the part runs it at 12.5Hz.
+float LSM6DSO::getAccelDataRate(){
+
+  uint8_t regVal = readShadow(CTRL1_XL);
+
+  switch( regVal & ~ODR_XL_MASK ){
+    case ODR_XL_1_6Hz:
+      return (readShadow(CTRL6_C) & HIGH_PERF_ACC_DISABLE) ? 1.6 : 12.5;
+    case ODR_XL_12_5Hz:
+      return 12.5;
+    case ODR_XL_26Hz:
+      return 26;
+    case ODR_XL_52Hz:
+      return 52;
+    case ODR_XL_104Hz:
+      return 104;
+    case ODR_XL_208Hz:
+      return 208;
+    case ODR_XL_416Hz:
+      return 416;
+    case ODR_XL_833Hz:
+      return 833;
+    case ODR_XL_1660Hz:
+      return 1660;
+    case ODR_XL_3330Hz:
+      return 3330;
+    case ODR_XL_6660Hz:
+      return 6660;
+    default:
+      return 0;
+  }
+}
+
+int16_t LSM6DSO::readRawAccelX() {
+
+	int16_t output;
+	status_t errorLevel = readRegisterInt16( &output, OUTX_L_A );
+	if( errorLevel != IMU_SUCCESS )
+	{
+		if( errorLevel == IMU_ALL_ONES_WARNING )
+			allOnesCounter++;
+		else
+			nonSuccessCounter++;
+	}
+	return output;
+}
+
+float LSM6DSO::readFloatAccelX() {
+	float output = calcAccel(readRawAccelX());
+	return output;
+}
+
+int16_t LSM6DSO::readRawAccelY()
+{
+	int16_t output;
+	status_t errorLevel = readRegisterInt16( &output, OUTY_L_A );
+	if( errorLevel != IMU_SUCCESS )
+	{
+		if( errorLevel == IMU_ALL_ONES_WARNING )
+			allOnesCounter++;
+		else
+			nonSuccessCounter++;
+	}
+	return output;
+}
+
+float LSM6DSO::readFloatAccelY()
+{
+	float output = calcAccel(readRawAccelY());
+	return output;
+}
+
+int16_t LSM6DSO::readRawAccelZ()
+{
+	int16_t output;
+	status_t errorLevel = readRegisterInt16( &output, OUTZ_L_A );
+	if( errorLevel != IMU_SUCCESS )
+	{
+		if( errorLevel == IMU_ALL_ONES_WARNING )
+			allOnesCounter++;
+		else
+			nonSuccessCounter++;
+	}
+	return output;
+}
+
+float LSM6DSO::readFloatAccelZ()
+{
+	float output = calcAccel(readRawAccelZ());
+	return output;
+}
+
+float LSM6DSO::calcAccel( int16_t input )
+{
+  if( scaleChanged )
+    updateScale();
+
+	return static_cast<float>(input) * accelSensitivity;
+}
+
+// g per LSB at the current full scale.
+float LSM6DSO::getAccelSensitivity()
+{
+  if( scaleChanged )
+    updateScale();
+
+  return accelSensitivity;
+}
+
+// Address: 0x10, bit[3:2] and 0x17, bit[1]
+// Returns the accelerometer sensitivity in g per LSB for the given CTRL1_XL
+// and CTRL8_XL values.
+float LSM6DSO::accelScale( uint8_t ctrl1, uint8_t ctrl8 )
+{
+  uint8_t accelRange; 
+  uint8_t scale;
+  float output;
+
+  scale = (ctrl8 >> 1) & 0x01;
+  accelRange = (ctrl1 >> 2) & (0x03);  
+  
+  if( scale == 0 ) {
+    switch( accelRange ){
+      case 0:// Register value 0: 2g
+        output = 0.061 / 1000;
+        break;
+      case 1: //Register value 1 : 16g
+        output = 0.488 / 1000;
+        break;
+      case 2: //Register value 2 : 4g
+        output = 0.122 / 1000;
+        break;
+      case 3://Register value 3: 8g
+      default:
+        output = 0.244 / 1000;
+        break;
+    }
+  }
+  else {
+    switch( accelRange ){
+      case 0: //Register value 0: 2g
+      case 1://Register value 1: 2g
+        output = 0.061 / 1000;
+        break;
+      case 2://Register value 2: 4g
+        output = 0.122 / 1000;
+        break;
+      case 3://Register value 3: 8g
+      default:
+        output = 0.244 / 1000;
+        break;
+    }
+  }
+
+	return output;
+}
+
+//****************************************************************************//
+//
+//  Gyroscope section
+//
+//****************************************************************************//
+
+// Address:CTRL2_G , bit[7:4]: default value is: 0x00.
+// Sets the gyro's output data rate thereby enabling it.  
+bool LSM6DSO::setGyroDataRate(uint16_t rate) {
+
+  if( rate < 0 | rate > 6660 ) 
+    return false; 
+
+  uint8_t regVal = readShadow(CTRL2_G);
+
+  regVal &= ODR_GYRO_MASK;
+
+  switch( rate ) {
+    case 0:
+      regVal |= ODR_GYRO_DISABLE;
+      break;
+    case 125:
+      regVal |= ODR_GYRO_12_5Hz;
+      break;
+    case 26:
+      regVal |= ODR_GYRO_26Hz;
+      break;
+    case 52:
+      regVal |= ODR_GYRO_52Hz;
+      break;
+    case 104:
+      regVal |= ODR_GYRO_104Hz;
+      break;
+    case 208:
+      regVal |= ODR_GYRO_208Hz;
+      break;
+    case 416:
+      regVal |= ODR_GYRO_416Hz;
+      break;
+    case 833:
+      regVal |= ODR_GYRO_833Hz;
+      break;
+    case 1660:
+      regVal |= ODR_GYRO_1660Hz;
+      break;
+    case 3330:
+      regVal |= ODR_GYRO_3330Hz;
+      break;
+    case 6660:
+      regVal |= ODR_GYRO_6660Hz;
+      break;
+    default:
+      break;
+  }
+
+  status_t returnError = writeRegister(CTRL2_G, regVal);
+  if( returnError != IMU_SUCCESS )
+      return false;
+  else
+      return true;
+}
+
+
+
+// Address: 0x11, bit[3:0]: default value is: 0x00
+// Sets the gyroscope's range.
+bool LSM6DSO::setGyroRange(uint16_t range) {
+
+  if( range < 250 | range > 2000)
+    return false;
+
+  uint8_t regVal = readShadow(CTRL2_G);
+
+  regVal &= FS_G_MASK;
+
+  switch( range ){
+    case 125:
+      regVal |= FS_G_125dps;
+      break;
+    case 250:
+      regVal |= FS_G_250dps;
+      break;
+    case 500:
+      regVal |= FS_G_500dps;
+      break;
+    case 1000:
+      regVal |= FS_G_1000dps;
+      break;
+    case 2000:
+      regVal |= FS_G_2000dps;
+      break;
+  }
 
+  status_t returnError = writeRegister(CTRL2_G, regVal);
   if( returnError != IMU_SUCCESS )
-    return IMU_GENERIC_ERROR;
+      return false;
   else
-    return ((regVal & 0x10) >> 4); 
+      return true;
+}
+
+
 
+// Address: 0x11, bit[7:4]
+// Returns the gyroscope's output data rate in Hz, answered from the register
+// shadow. Zero means the gyroscope is powered down.
+float LSM6DSO::getGyroDataRate(){
+
+  uint8_t regVal = readShadow(CTRL2_G);
+
+  switch( regVal & ~ODR_GYRO_MASK ){
+    case ODR_GYRO_12_5Hz:
+      return 12.5;
+    case ODR_GYRO_26Hz:
+      return 26;
+    case ODR_GYRO_52Hz:
+      return 52;
+    case ODR_GYRO_104Hz:
+      return 104;
+    case ODR_GYRO_208Hz:
+      return 208;
+    case ODR_GYRO_416Hz:
+      return 416;
+    case ODR_GYRO_833Hz:
+      return 833;
+    case ODR_GYRO_1660Hz:
+      return 1660;
+    case ODR_GYRO_3330Hz:
+      return 3330;
+    case ODR_GYRO_6660Hz:
+      return 6660;
+    default:
+      return 0;
+  }
 }
 
-// Address: 0x17, bit[2]: default value is: 0x00 
-// Checks whether the acclerometer is using "old" full scale or "new", see
-// datasheet for more information.
-uint8_t LSM6DSO::getAccelFullScale(){
+// Address: 0x11, bit[3:1]
+// Returns the gyroscope's range in dps, answered from the register shadow.
+uint16_t LSM6DSO::getGyroRange(){
 
-  uint8_t regVal;
-  status_t returnError = readRegister(&regVal, CTRL8_XL);
+  uint8_t regVal = readShadow(CTRL2_G);
 
-  if( returnError != IMU_SUCCESS )
-    return IMU_GENERIC_ERROR;
-  else
-    return ((regVal & 0x02) >> 1); 
+  if( regVal & FS_G_125dps )
+    return 125;
+
+  switch( regVal & ~FS_G_MASK ){
+    case FS_G_250dps:
+      return 250;
+    case FS_G_500dps:
+      return 500;
+    case FS_G_1000dps:
+      return 1000;
+    case FS_G_2000dps:
+    default:
+      return 2000;
+  }
 }
 
-int16_t LSM6DSO::readRawAccelX() {
+int16_t LSM6DSO::readRawGyroX() {
 
 	int16_t output;
-	status_t errorLevel = readRegisterInt16( &output, OUTX_L_A );
-	if( errorLevel != IMU_SUCCESS )
-	{
+	status_t errorLevel = readRegisterInt16( &output, OUTX_L_G );
+
+	if( errorLevel != IMU_SUCCESS ) {
 		if( errorLevel == IMU_ALL_ONES_WARNING )
 			allOnesCounter++;
 		else
 			nonSuccessCounter++;
 	}
+
 	return output;
 }
 
-float LSM6DSO::readFloatAccelX() {
-	float output = calcAccel(readRawAccelX());
+float LSM6DSO::readFloatGyroX() {
+
+	float output = calcGyro(readRawGyroX());
 	return output;
 }
 
-int16_t LSM6DSO::readRawAccelY()
-{
+int16_t LSM6DSO::readRawGyroY() {
+
 	int16_t output;
-	status_t errorLevel = readRegisterInt16( &output, OUTY_L_A );
-	if( errorLevel != IMU_SUCCESS )
-	{
+	status_t errorLevel = readRegisterInt16( &output, OUTY_L_G );
+
+	if( errorLevel != IMU_SUCCESS ) {
 		if( errorLevel == IMU_ALL_ONES_WARNING )
 			allOnesCounter++;
 		else
 			nonSuccessCounter++;
 	}
+
 	return output;
 }
 
-float LSM6DSO::readFloatAccelY()
-{
-	float output = calcAccel(readRawAccelY());
+float LSM6DSO::readFloatGyroY() {
+  
+	float output = calcGyro(readRawGyroY());
 	return output;
 }
 
-int16_t LSM6DSO::readRawAccelZ()
-{
+int16_t LSM6DSO::readRawGyroZ() {
+
 	int16_t output;
-	status_t errorLevel = readRegisterInt16( &output, OUTZ_L_A );
-	if( errorLevel != IMU_SUCCESS )
-	{
+	status_t errorLevel = readRegisterInt16( &output, OUTZ_L_G );
+
+	if( errorLevel != IMU_SUCCESS ) {
 		if( errorLevel == IMU_ALL_ONES_WARNING )
 			allOnesCounter++;
 		else
 			nonSuccessCounter++;
 	}
+
 	return output;
 }
 
-float LSM6DSO::readFloatAccelZ()
-{
-	float output = calcAccel(readRawAccelZ());
+float LSM6DSO::readFloatGyroZ() {
+
+	float output = calcGyro(readRawGyroZ());
 	return output;
+
 }
 
-float LSM6DSO::calcAccel( int16_t input )
-{
-  uint8_t accelRange; 
-  uint8_t scale;
-  float output;
+float LSM6DSO::calcGyro( int16_t input ) {
 
-  readRegister(&accelRange, CTRL1_XL);
-  scale = (accelRange >> 1) & 0x01;
-  accelRange = (accelRange >> 2) & (0x03);  
-  
-  if( scale == 0 ) {
-    switch( accelRange ){
-      case 0:// Register value 0: 2g
-        output = (static_cast<float>(input) * (.061)) / 1000;
+  if( scaleChanged )
+    updateScale();
+
+  return static_cast<float>(input) * gyroSensitivity;
+}
+
+// dps per LSB at the current full scale.
+float LSM6DSO::getGyroSensitivity() {
+
+  if( scaleChanged )
+    updateScale();
+
+  return gyroSensitivity;
+}
+
+// Recomputes the sensitivity factors from the register shadow. Called lazily
+// whenever CTRL1_XL, CTRL2_G or CTRL8_XL has changed.
+void LSM6DSO::updateScale() {
+
+  accelSensitivity = accelScale(readShadow(CTRL1_XL), readShadow(CTRL8_XL));
+  gyroSensitivity = gyroScale(readShadow(CTRL2_G));
+  accelMilliMultiplier = accelMilliScale(readShadow(CTRL1_XL), readShadow(CTRL8_XL));
+  gyroMilliMultiplier = gyroMilliScale(readShadow(CTRL2_G));
+  scaleChanged = false;
+}
+
+// Address: 0x11, bit[3:1]
+// Returns the gyroscope sensitivity in dps per LSB for the given CTRL2_G
+// value.
+float LSM6DSO::gyroScale( uint8_t regVal ) {
+
+	uint8_t gyroRange;  
+  uint8_t fullScale;
+  float output; 
+
+  fullScale = (regVal >> 1) & 0x01; 
+  gyroRange = (regVal >> 2) & 0x03; 
+
+  if( fullScale )
+    output = 4.375 / 1000;
+  else {
+    switch( gyroRange ){
+      case 0:
+        output = 8.75 / 1000;
         break;
-      case 1: //Register value 1 : 16g
-        output = (static_cast<float>(input) * (.488)) / 1000;
+      case 1:
+        output = 17.50 / 1000;
         break;
-      case 2: //Register value 2 : 4g
-        output = (static_cast<float>(input) * (.122)) / 1000;
+      case 2:
+        output = 35.0 / 1000;
         break;
-      case 3://Register value 3: 8g
-        output = (static_cast<float>(input) * (.244)) / 1000;
+      case 3:
+      default:
+        output = 70.0 / 1000;
         break;
     }
   }
 
-  if( scale == 1 ){
-    switch( accelRange ){
-      case 0: //Register value 0: 2g
-        output = (static_cast<float>(input) * (0.061)) / 1000;
-        break;
-      case 1://Register value 1: 2g
-        output = (static_cast<float>(input) * (0.061)) / 1000;
-        break;
-      case 2://Register value 2: 4g
-        output = (static_cast<float>(input) * (.122)) / 1000;
-        break;
-      case 3://Register value 3: 8g
-        output = (static_cast<float>(input) * (.244)) / 1000;
-        break;
-    }
+  return output;
+}
+
+//****************************************************************************//
+//
+//  Temperature section
+//
+//****************************************************************************//
+
+// Temperature sensitivity is 256 LSB/C with zero output at 25C.
+float LSM6DSO::calcTemp( int16_t input ) {
+
+  return (static_cast<float>(input) / 256.0) + 25.0;
+}
+
+//****************************************************************************//
+//
+//  Burst read section
+//
+//****************************************************************************//
+
+// Address: 0x20 - 0x2D
+// Reads temperature, gyroscope and accelerometer output registers in a single
+// transaction. With BDU set all axes come from the same output sample.
+bool LSM6DSO::readAllRaw(imuRawData &output) {
+
+  uint8_t buffer[14];
+  status_t errorLevel = readMultipleRegisters(buffer, OUT_TEMP_L, 14);
+  if( errorLevel != IMU_SUCCESS ) {
+    if( errorLevel == IMU_ALL_ONES_WARNING )
+      allOnesCounter++;
+    else
+      nonSuccessCounter++;
+    return false;
   }
 
-	return output;
+  unpackAllRaw(buffer, output);
+
+  return true;
+}
+
+// Splits the 14 bytes from OUT_TEMP_L through OUTZ_H_A into an imuRawData.
+// Shared with LSM6DSOFixed::readAllRaw().
+void LSM6DSO::unpackAllRaw(const uint8_t *buffer, imuRawData &output) {
+
+  output.temperature = buffer[0]  | static_cast<uint16_t>(buffer[1] << 8);
+  output.xGyro       = buffer[2]  | static_cast<uint16_t>(buffer[3] << 8);
+  output.yGyro       = buffer[4]  | static_cast<uint16_t>(buffer[5] << 8);
+  output.zGyro       = buffer[6]  | static_cast<uint16_t>(buffer[7] << 8);
+  output.xAccel      = buffer[8]  | static_cast<uint16_t>(buffer[9] << 8);
+  output.yAccel      = buffer[10] | static_cast<uint16_t>(buffer[11] << 8);
+  output.zAccel      = buffer[12] | static_cast<uint16_t>(buffer[13] << 8);
+}
+
+// Same as readAllRaw() but also scales every axis. Scaling comes from the
+// register shadow so this is still a single transaction.
+bool LSM6DSO::readAll(imuData &output) {
+
+  if( !readAllRaw(output.raw) )
+    return false;
+
+  if( scaleChanged )
+    updateScale();
+
+  output.xAccel = static_cast<float>(output.raw.xAccel) * accelSensitivity;
+  output.yAccel = static_cast<float>(output.raw.yAccel) * accelSensitivity;
+  output.zAccel = static_cast<float>(output.raw.zAccel) * accelSensitivity;
+
+  output.xGyro = static_cast<float>(output.raw.xGyro) * gyroSensitivity;
+  output.yGyro = static_cast<float>(output.raw.yGyro) * gyroSensitivity;
+  output.zGyro = static_cast<float>(output.raw.zGyro) * gyroSensitivity;
+
+  output.temperatureC = calcTemp(output.raw.temperature);
+
+  return true;
+}
+
+// Address: 0x1E - 0x2D
+// Reads STATUS_REG and every output register in a single transaction, so a
+// poll that finds new data costs no more than one that doesn't. Only the
+// fields of the sensors flagged ready are updated; the others keep what the
+// caller had. Returns the ready flags as listenDataReady() does, 0 if
+// nothing was new or the read failed. Reading the outputs clears the flags.
+uint8_t LSM6DSO::pollAllRaw(imuRawData &output) {
+
+  uint8_t buffer[16];
+  status_t errorLevel = readMultipleRegisters(buffer, STATUS_REG, 16);
+  if( errorLevel != IMU_SUCCESS ) {
+    if( errorLevel == IMU_ALL_ONES_WARNING )
+      allOnesCounter++;
+    else
+      nonSuccessCounter++;
+    return 0;
+  }
+
+  // buffer[1] is 0x1F, which is reserved.
+  uint8_t ready = buffer[0] & ALL_DATA_READY;
+
+  pollStats.polls++;
+  if( ready == 0 )
+    pollStats.emptyPolls++;
+
+  if( ready & TEMP_DATA_READY ){
+    output.temperature = buffer[2] | static_cast<uint16_t>(buffer[3] << 8);
+    pollStats.temperatureSamples++;
+  }
+  if( ready & GYRO_DATA_READY ){
+    output.xGyro = buffer[4] | static_cast<uint16_t>(buffer[5] << 8);
+    output.yGyro = buffer[6] | static_cast<uint16_t>(buffer[7] << 8);
+    output.zGyro = buffer[8] | static_cast<uint16_t>(buffer[9] << 8);
+    pollStats.gyroSamples++;
+  }
+  if( ready & ACCEL_DATA_READY ){
+    output.xAccel = buffer[10] | static_cast<uint16_t>(buffer[11] << 8);
+    output.yAccel = buffer[12] | static_cast<uint16_t>(buffer[13] << 8);
+    output.zAccel = buffer[14] | static_cast<uint16_t>(buffer[15] << 8);
+    pollStats.accelSamples++;
+  }
+
+  return ready;
+}
+
+// Same as pollAllRaw() but also scales the fresh axes.
+uint8_t LSM6DSO::pollAll(imuData &output) {
+
+  uint8_t ready = pollAllRaw(output.raw);
+  if( ready == 0 )
+    return 0;
+
+  if( scaleChanged )
+    updateScale();
+
+  if( ready & ACCEL_DATA_READY ){
+    output.xAccel = static_cast<float>(output.raw.xAccel) * accelSensitivity;
+    output.yAccel = static_cast<float>(output.raw.yAccel) * accelSensitivity;
+    output.zAccel = static_cast<float>(output.raw.zAccel) * accelSensitivity;
+  }
+  if( ready & GYRO_DATA_READY ){
+    output.xGyro = static_cast<float>(output.raw.xGyro) * gyroSensitivity;
+    output.yGyro = static_cast<float>(output.raw.yGyro) * gyroSensitivity;
+    output.zGyro = static_cast<float>(output.raw.zGyro) * gyroSensitivity;
+  }
+  if( ready & TEMP_DATA_READY )
+    output.temperatureC = calcTemp(output.raw.temperature);
+
+  return ready;
+}
+
+const pollStatistics &LSM6DSO::getPollStatistics() const {
+
+  return pollStats;
+}
+
+void LSM6DSO::resetPollStatistics() {
+
+  pollStats.polls = 0;
+  pollStats.emptyPolls = 0;
+  pollStats.accelSamples = 0;
+  pollStats.gyroSamples = 0;
+  pollStats.temperatureSamples = 0;
 }
 
 //****************************************************************************//
 //
-//  Gyroscope section
+//  FIFO section
 //
 //****************************************************************************//
 
-// Address:CTRL2_G , bit[7:4]: default value is: 0x00.
-// Sets the gyro's output data rate thereby enabling it.  
-bool LSM6DSO::setGyroDataRate(uint16_t rate) {
+// Applies the FIFO portion of imuSettings: watermark, batch data rates for
+// the enabled sensors and the FIFO mode.
+status_t LSM6DSO::beginFifoSettings() {
 
-  if( rate < 0 | rate > 6660 ) 
-    return false; 
+  uint16_t accelRate = 0;
+  uint16_t gyroRate = 0;
 
-  uint8_t regVal;
-  status_t returnError = readRegister(&regVal, CTRL2_G);
+  if( imuSettings.fifoEnabled ){
+    if( imuSettings.accelFifoEnabled )
+      accelRate = imuSettings.fifoSampleRate;
+    if( imuSettings.gyroFifoEnabled )
+      gyroRate = imuSettings.fifoSampleRate;
+  }
+
+  // FIFO_CTRL1..FIFO_CTRL4 in one burst.
+  beginConfig();
+
+  if( !setFifoDepth(imuSettings.fifoThreshold) || !setAccelBatchDataRate(accelRate) ||
+      !setGyroBatchDataRate(gyroRate) ||
+      !setFifoMode(imuSettings.fifoEnabled ? imuSettings.fifoModeWord : static_cast<uint8_t>(FIFO_MODE_DISABLED)) ){
+    abortConfig();
+    return IMU_GENERIC_ERROR;
+  }
+
+  return commitConfig();
+}
+
+// Address: 0x07, bit[7:0] and 0x08, bit[0]: default value is: 0x00
+// Sets the FIFO watermark threshold, counted in 7 byte FIFO words.
+bool LSM6DSO::setFifoDepth(uint16_t depth) {
+
+  if( depth > FIFO_MAX_WORDS )
+    return false;
+
+  uint8_t regVal[2];
+  regVal[0] = depth & 0xFF;
+  regVal[1] = (readShadow(FIFO_CTRL2) & 0xFE) | ((depth >> 8) & 0x01);
+
+  status_t returnError = writeMultipleRegisters(regVal, FIFO_CTRL1, 2);
   if( returnError != IMU_SUCCESS )
+    return false;
+  else
+    return true;
+}
+
+// Returns the FIFO watermark threshold, answered from the register shadow.
+uint16_t LSM6DSO::getFifoDepth() {
+
+  return readShadow(FIFO_CTRL1) | ((readShadow(FIFO_CTRL2) & 0x01) << 8);
+}
+
+// Address: 0x09, bit[3:0]: default value is: 0x00 (Not batched)
+// Sets the rate at which accelerometer samples are written to the FIFO.
+bool LSM6DSO::setAccelBatchDataRate(uint16_t rate) {
+
+  if( rate > 6660 )
+    return false;
+
+  uint8_t regVal = readShadow(FIFO_CTRL3);
+
+  regVal &= FIFO_BDR_ACC_MASK;
+
+  switch( rate ) {
+    case 0:
+      regVal |= FIFO_BDR_ACC_NOT_BATCHED;
+      break;
+    case 16:
+      regVal |= FIFO_BDR_ACC_1_6Hz;
+      break;
+    case 125:
+      regVal |= FIFO_BDR_ACC_12_5Hz;
+      break;
+    case 26:
+      regVal |= FIFO_BDR_ACC_26Hz;
+      break;
+    case 52:
+      regVal |= FIFO_BDR_ACC_52Hz;
+      break;
+    case 104:
+      regVal |= FIFO_BDR_ACC_104Hz;
+      break;
+    case 208:
+      regVal |= FIFO_BDR_ACC_208Hz;
+      break;
+    case 416:
+      regVal |= FIFO_BDR_ACC_417Hz;
+      break;
+    case 833:
+      regVal |= FIFO_BDR_ACC_833Hz;
+      break;
+    case 1660:
+      regVal |= FIFO_BDR_ACC_1667Hz;
+      break;
+    case 3330:
+      regVal |= FIFO_BDR_ACC_3333Hz;
+      break;
+    case 6660:
+      regVal |= FIFO_BDR_ACC_6667Hz;
+      break;
+    default:
       return false;
+  }
 
-  regVal &= ODR_GYRO_MASK;
+  status_t returnError = writeRegister(FIFO_CTRL3, regVal);
+  if( returnError != IMU_SUCCESS )
+    return false;
+  else
+    return true;
+}
+
+// Address: 0x09, bit[7:4]: default value is: 0x00 (Not batched)
+// Sets the rate at which gyroscope samples are written to the FIFO.
+bool LSM6DSO::setGyroBatchDataRate(uint16_t rate) {
+
+  if( rate > 6660 )
+    return false;
+
+  uint8_t regVal = readShadow(FIFO_CTRL3);
+
+  regVal &= FIFO_BDR_GYRO_MASK;
 
   switch( rate ) {
     case 0:
-      regVal |= ODR_GYRO_DISABLE;
+      regVal |= FIFO_BDR_GYRO_NOT_BATCHED;
+      break;
+    case 65:
+      regVal |= FIFO_BDR_GYRO_6_5Hz;
       break;
     case 125:
-      regVal |= ODR_GYRO_12_5Hz;
+      regVal |= FIFO_BDR_GYRO_12_5Hz;
       break;
     case 26:
-      regVal |= ODR_GYRO_26Hz;
+      regVal |= FIFO_BDR_GYRO_26Hz;
       break;
     case 52:
-      regVal |= ODR_GYRO_52Hz;
+      regVal |= FIFO_BDR_GYRO_52Hz;
       break;
     case 104:
-      regVal |= ODR_GYRO_104Hz;
+      regVal |= FIFO_BDR_GYRO_104Hz;
       break;
     case 208:
-      regVal |= ODR_GYRO_208Hz;
+      regVal |= FIFO_BDR_GYRO_208Hz;
       break;
     case 416:
-      regVal |= ODR_GYRO_416Hz;
+      regVal |= FIFO_BDR_GYRO_417Hz;
       break;
     case 833:
-      regVal |= ODR_GYRO_833Hz;
+      regVal |= FIFO_BDR_GYRO_833Hz;
       break;
     case 1660:
-      regVal |= ODR_GYRO_1660Hz;
+      regVal |= FIFO_BDR_GYRO_1667Hz;
       break;
     case 3330:
-      regVal |= ODR_GYRO_3330Hz;
+      regVal |= FIFO_BDR_GYRO_3333Hz;
       break;
     case 6660:
-      regVal |= ODR_GYRO_6660Hz;
+      regVal |= FIFO_BDR_GYRO_6667Hz;
       break;
     default:
-      break;
+      return false;
   }
 
-  returnError = writeRegister(CTRL2_G, regVal);
+  status_t returnError = writeRegister(FIFO_CTRL3, regVal);
   if( returnError != IMU_SUCCESS )
-      return false;
+    return false;
   else
-      return true;
+    return true;
 }
 
+// Address: 0x0A, bit[2:0]: default value is: 0x00 (Bypass)
+// Sets the FIFO mode, see LSM6DSO_FIFO_MODE_t.
+bool LSM6DSO::setFifoMode(uint8_t mode) {
 
+  if( mode > FIFO_MODE_BYPASS_TO_FIFO )
+    return false;
 
-// Address: 0x11, bit[3:0]: default value is: 0x00
-// Sets the gyroscope's range.
-bool LSM6DSO::setGyroRange(uint16_t range) {
+  uint8_t regVal = readShadow(FIFO_CTRL4);
 
-  if( range < 250 | range > 2000)
-    return false;
+  regVal &= 0xF8;
+  regVal |= mode;
 
-  uint8_t regVal;
-  status_t returnError = readRegister(&regVal, CTRL2_G);
+  status_t returnError = writeRegister(FIFO_CTRL4, regVal);
   if( returnError != IMU_SUCCESS )
-      return false;
+    return false;
 
-  regVal &= FS_G_MASK;
+  resetFifoDecoder();
+  return true;
+}
 
-  switch( range ){
-    case 125:
-      regVal |= FS_G_125dps;
-      break;
-    case 250:
-      regVal |= FS_G_250dps;
-      break;
-    case 500:
-      regVal |= FS_G_500dps;
-      break;
-    case 1000:
-      regVal |= FS_G_1000dps;
-      break;
-    case 2000:
-      regVal |= FS_G_2000dps;
-      break;
+// Address: 0x08, bit[6] and bit[2:1], embedded 0x05, bit[3]
+// Enables FIFO compression. uncompressedRate forces an uncompressed word
+// every 8, 16 or 32 batch periods (see LSM6DSO_FIFO_UNCOPTR_RATE_t) so the
+// decoder can resynchronise.
+bool LSM6DSO::setFifoCompression(bool enable, uint8_t uncompressedRate) {
+
+  uint8_t regVal;
+  status_t returnError;
+  {
+    LSM6DSOEmbeddedBank bank(*this);
+
+    returnError = readEmbedded(&regVal, EMB_FUNC_EN_B, 1);
+    if( returnError == IMU_SUCCESS ){
+      regVal &= 0xF7;
+      if( enable )
+        regVal |= 0x08;
+      returnError = writeEmbedded(&regVal, EMB_FUNC_EN_B, 1);
+    }
   }
+  if( returnError != IMU_SUCCESS )
+    return false;
+
+  regVal = readShadow(FIFO_CTRL2);
+  regVal &= FIFO_COMPR_RT_MASK & FIFO_UNCOPTR_RATE_MASK;
+  if( enable )
+    regVal |= FIFO_COMPR_RT_ENABLE | (uncompressedRate & ~FIFO_UNCOPTR_RATE_MASK);
 
-  returnError = writeRegister(CTRL2_G, regVal);
+  returnError = writeRegister(FIFO_CTRL2, regVal);
   if( returnError != IMU_SUCCESS )
-      return false;
-  else
-      return true;
-}
+    return false;
 
+  resetFifoDecoder();
+  return true;
+}
 
+// Forgets the compression reference samples and the current slot time.
+// Compressed words that arrive before the next uncompressed word of the
+// same sensor are dropped, and samples carry no timestamp until the next
+// timestamp word.
+void LSM6DSO::resetFifoDecoder() {
 
-int16_t LSM6DSO::readRawGyroX() {
+  accelReferenceValid = false;
+  gyroReferenceValid = false;
+  fifoTimeValid = false;
+}
 
-	int16_t output;
-	status_t errorLevel = readRegisterInt16( &output, OUTX_L_G );
+// Address: 0x3A - 0x3B
+// Returns FIFO_STATUS2 in the upper byte and FIFO_STATUS1 in the lower byte.
+// Bits [9:0] hold the number of unread FIFO words.
+uint16_t LSM6DSO::getFifoStatus() {
 
-	if( errorLevel != IMU_SUCCESS ) {
-		if( errorLevel == IMU_ALL_ONES_WARNING )
-			allOnesCounter++;
-		else
-			nonSuccessCounter++;
-	}
+  uint8_t regVal[2];
+  status_t returnError = readMultipleRegisters(regVal, FIFO_STATUS1, 2);
+  if( returnError != IMU_SUCCESS ) {
+    nonSuccessCounter++;
+    return 0;
+  }
 
-	return output;
+  return regVal[0] | (static_cast<uint16_t>(regVal[1]) << 8);
 }
 
-float LSM6DSO::readFloatGyroX() {
+uint16_t LSM6DSO::getUnreadFifoWords() {
 
-	float output = calcGyro(readRawGyroX());
-	return output;
+  return getFifoStatus() & 0x03FF;
 }
 
-int16_t LSM6DSO::readRawGyroY() {
+// Address: 0x78 - 0x7E
+// Copies numWords raw tagged FIFO words into buffer, which must hold
+// numWords * FIFO_WORD_LENGTH bytes. The whole drain is one readBulk(), so it
+// goes out in as few transactions as the interface allows. Returns the
+// number of words read, zero if a transfer failed.
+uint16_t LSM6DSO::fifoReadWords(uint8_t buffer[], uint16_t numWords) {
 
-	int16_t output;
-	status_t errorLevel = readRegisterInt16( &output, OUTY_L_G );
+  if( numWords > FIFO_MAX_WORDS + 1 )
+    numWords = FIFO_MAX_WORDS + 1;
 
-	if( errorLevel != IMU_SUCCESS ) {
-		if( errorLevel == IMU_ALL_ONES_WARNING )
-			allOnesCounter++;
-		else
-			nonSuccessCounter++;
-	}
+  status_t returnError = readBulk(buffer, FIFO_DATA_OUT_TAG, numWords * FIFO_WORD_LENGTH);
+  if( returnError != IMU_SUCCESS ){
+    nonSuccessCounter++;
+    return 0;
+  }
 
-	return output;
+  return numWords;
 }
 
-float LSM6DSO::readFloatGyroY() {
-  
-	float output = calcGyro(readRawGyroY());
-	return output;
-}
+// Drains up to maxSamples words from the FIFO and decodes them into output.
+// Words that don't carry accelerometer, gyroscope or temperature data are
+// consumed but not returned. Returns the number of entries written.
+uint16_t LSM6DSO::fifoRead(fifoData output[], uint16_t maxSamples) {
 
-int16_t LSM6DSO::readRawGyroZ() {
+  uint8_t buffer[FIFO_WORDS_PER_BURST * FIFO_WORD_LENGTH];
+  uint16_t count = 0;
 
-	int16_t output;
-	status_t errorLevel = readRegisterInt16( &output, OUTZ_L_G );
+  // With compression on, a single word may expand to three samples.
+  uint8_t samplesPerWord = 1;
+  if( readShadow(FIFO_CTRL2) & FIFO_COMPR_RT_ENABLE )
+    samplesPerWord = FIFO_MAX_SAMPLES_PER_WORD;
 
-	if( errorLevel != IMU_SUCCESS ) {
-		if( errorLevel == IMU_ALL_ONES_WARNING )
-			allOnesCounter++;
-		else
-			nonSuccessCounter++;
-	}
+  uint16_t unread = getUnreadFifoWords();
 
-	return output;
+  while( unread > 0 ){
+
+    uint16_t burst = (maxSamples - count) / samplesPerWord;
+    if( burst > unread )
+      burst = unread;
+    if( burst > FIFO_WORDS_PER_BURST )
+      burst = FIFO_WORDS_PER_BURST;
+    if( burst == 0 )
+      break;
+
+    if( fifoReadWords(buffer, burst) != burst )
+      break;
+
+    for( uint16_t i = 0; i < burst; i++ )
+      count += decodeFifoWord(&buffer[i * FIFO_WORD_LENGTH], &output[count]);
+
+    unread -= burst;
+  }
+
+  return count;
 }
 
-float LSM6DSO::readFloatGyroZ() {
+// Decodes a single tagged FIFO word into output, which must have room for
+// FIFO_MAX_SAMPLES_PER_WORD entries. Samples rebuilt from compressed words
+// are reported with the plain GYROSCOPE_DATA or ACCELEROMETER_DATA tag, oldest
+// first. Returns the number of entries written; tags that don't map onto
+// fifoData write none.
+uint8_t LSM6DSO::decodeFifoWord(const uint8_t word[], fifoData output[]) {
 
-	float output = calcGyro(readRawGyroZ());
-	return output;
+  int16_t raw[FIFO_MAX_SAMPLES_PER_WORD][3];
+  uint8_t slotsBack[FIFO_MAX_SAMPLES_PER_WORD];
+  uint8_t sensorTag;
 
+  uint8_t count = decodeFifoWordRaw(word, raw, slotsBack, sensorTag);
+
+  for( uint8_t i = 0; i < count; i++ ){
+    fillFifoSample(output[i], sensorTag, raw[i]);
+    if( fifoTimeValid )
+      output[i].timestampNs = ticksToNs(getFifoSampleTicks(slotsBack[i]));
+  }
+
+  return count;
 }
 
-float LSM6DSO::calcGyro( int16_t input ) {
+// Decodes a tagged FIFO word into raw register counts without scaling.
+// sensorTag is set to GYROSCOPE_DATA, ACCELEROMETER_DATA or TEMPERATURE_DATA
+// (only raw[0][0] is used for temperature), and slotsBack to how many
+// batching slots before the word's own slot each sample was taken. Returns
+// the number of samples, zero for words that carry none.
+uint8_t LSM6DSO::decodeFifoWordRaw(const uint8_t word[], int16_t raw[][3], uint8_t slotsBack[], uint8_t &sensorTag) {
+
+  uint8_t tag = word[0] >> 3;
+  uint8_t tagCount = (word[0] >> 1) & 0x03;
+  int16_t diff[9];
+  int16_t *reference;
+  bool *referenceValid;
+  uint8_t numDiffs;
+
+  // TAG_CNT steps once per batching slot; follow it to date the samples
+  // between timestamp words.
+  if( fifoTimeValid && tagCount != fifoTagCount )
+    fifoSlotTime += static_cast<uint64_t>((tagCount - fifoTagCount) & 0x03) * fifoSlotTicks();
+  fifoTagCount = tagCount;
+
+  switch( tag ){
+    case TIMESTAMP_DATA:
+      fifoSlotTime = extendTimestamp(word[1] | static_cast<uint32_t>(word[2]) << 8 |
+                                     static_cast<uint32_t>(word[3]) << 16 | static_cast<uint32_t>(word[4]) << 24,
+                                     lastFifoTimestampLow, fifoTimestampHigh);
+      fifoTimeValid = true;
+      return 0;
+    case GYROSCOPE_DATA:
+    case GYRO_DATA_T_1:
+    case GYRO_DATA_T_2:
+    case GYRO_DATA_2xC:
+    case GYRO_DATA_3xC:
+      sensorTag = GYROSCOPE_DATA;
+      reference = lastGyroRaw;
+      referenceValid = &gyroReferenceValid;
+      break;
+    case ACCELEROMETER_DATA:
+    case ACCELERTOMETER_DATA_T_1:
+    case ACCELERTOMETER_DATA_T_2:
+    case ACCELERTOMETER_DATA_2xC:
+    case ACCELERTOMETER_DATA_3xC:
+      sensorTag = ACCELEROMETER_DATA;
+      reference = lastAccelRaw;
+      referenceValid = &accelReferenceValid;
+      break;
+    case TEMPERATURE_DATA:
+      sensorTag = TEMPERATURE_DATA;
+      raw[0][0] = word[1] | static_cast<uint16_t>(word[2] << 8);
+      raw[0][1] = 0;
+      raw[0][2] = 0;
+      slotsBack[0] = 0;
+      return 1;
+    default:
+      return 0;
+  }
 
-	uint8_t gyroRange;  
-  uint8_t fullScale;
-  float output; 
+  switch( tag ){
+    case ACCELERTOMETER_DATA_2xC:
+    case GYRO_DATA_2xC:
+      // Two samples, 8 bit signed difference per axis.
+      for( uint8_t i = 0; i < 6; i++ )
+        diff[i] = static_cast<int8_t>(word[i + 1]);
+      numDiffs = 2;
+      break;
+    case ACCELERTOMETER_DATA_3xC:
+    case GYRO_DATA_3xC:
+      // Three samples, 5 bit signed difference per axis packed into a
+      // 16 bit little endian word per sample.
+      for( uint8_t i = 0; i < 3; i++ ){
+        uint16_t packed = word[2 * i + 1] | static_cast<uint16_t>(word[2 * i + 2] << 8);
+        for( uint8_t j = 0; j < 3; j++ ){
+          int16_t value = (packed >> (5 * j)) & 0x1F;
+          diff[3 * i + j] = value < 16 ? value : value - 32;
+        }
+      }
+      numDiffs = 3;
+      break;
+    default:
+      // Uncompressed sample at t, t-1 or t-2; becomes the new reference.
+      reference[0] = word[1] | static_cast<uint16_t>(word[2] << 8);
+      reference[1] = word[3] | static_cast<uint16_t>(word[4] << 8);
+      reference[2] = word[5] | static_cast<uint16_t>(word[6] << 8);
+      *referenceValid = true;
+
+      raw[0][0] = reference[0];
+      raw[0][1] = reference[1];
+      raw[0][2] = reference[2];
+
+      if( tag == ACCELERTOMETER_DATA_T_1 || tag == GYRO_DATA_T_1 )
+        slotsBack[0] = 1;
+      else if( tag == ACCELERTOMETER_DATA_T_2 || tag == GYRO_DATA_T_2 )
+        slotsBack[0] = 2;
+      else
+        slotsBack[0] = 0;
+      return 1;
+  }
 
-  readRegister(&gyroRange, CTRL2_G) ;
-  fullScale = (gyroRange >> 1) & 0x01; 
-  gyroRange = (gyroRange >> 2) & 0x03; 
+  if( !*referenceValid )
+    return 0;
 
-  if( fullScale )
-    output = (static_cast<float>(input) * 4.375)/1000;
-  else {
-    switch( gyroRange ){
-      case 0:
-        output = (static_cast<float>(input) * 8.75)/1000;
-        break;
-      case 1:
-        output = (static_cast<float>(input) * 17.50)/1000;
-        break;
-      case 2:
-        output = (static_cast<float>(input) * 35)/1000;
-        break;
-      case 3:
-        output = (static_cast<float>(input) * 70)/1000;
-        break;
+  // Compressed words carry the samples of t-2, t-1 (and t for 3xC).
+  for( uint8_t i = 0; i < numDiffs; i++ ){
+    for( uint8_t j = 0; j < 3; j++ ){
+      reference[j] += diff[3 * i + j];
+      raw[i][j] = reference[j];
     }
+    slotsBack[i] = 2 - i;
   }
 
-  return output;
+  return numDiffs;
 }
 
-//****************************************************************************//
-//
-//  Temperature section
-//
-//****************************************************************************//
-// Removed
-//****************************************************************************//
-//
-//  FIFO section
-//
-//****************************************************************************//
-//Removed 
+// Sensor time, in ticks, of a sample from the last decodeFifoWordRaw() call,
+// given its slotsBack. Zero until the FIFO has delivered a timestamp word.
+uint64_t LSM6DSO::getFifoSampleTicks(uint8_t slotsBack) {
+
+  if( !fifoTimeValid )
+    return 0;
+
+  return fifoSlotTime - slotsBack * fifoSlotTicks();
+}
+
+void LSM6DSO::fillFifoSample(fifoData &output, uint8_t tag, const int16_t raw[]) {
+
+  output.fifoTag = tag;
+
+  output.xAccel = 0;
+  output.yAccel = 0;
+  output.zAccel = 0;
+  output.xGyro = 0;
+  output.yGyro = 0;
+  output.zGyro = 0;
+  output.temperatureC = 0;
+  output.temperatureF = 0;
+  output.timestampNs = 0;
+
+  switch( tag ){
+    case GYROSCOPE_DATA:
+      output.xGyro = calcGyro(raw[0]);
+      output.yGyro = calcGyro(raw[1]);
+      output.zGyro = calcGyro(raw[2]);
+      break;
+    case ACCELEROMETER_DATA:
+      output.xAccel = calcAccel(raw[0]);
+      output.yAccel = calcAccel(raw[1]);
+      output.zAccel = calcAccel(raw[2]);
+      break;
+    case TEMPERATURE_DATA:
+      output.temperatureC = calcTemp(raw[0]);
+      output.temperatureF = (output.temperatureC * 9) / 5 + 32;
+      break;
+  }
+}
 
 // DO NOT TOUCH THE FOLLOWING FUNCTIONS BELOW , in initialize()
 
@@ -962,3 +2832,258 @@ bool LSM6DSO::setIncrement(bool enable) {
 
 // DO NOT TOUCH THE FOLLOWING FUNCTIONS ABOVE
 
+//****************************************************************************//
+//
+//  Timestamp section
+//
+//  The sensor counts 25us ticks in TIMESTAMP0..3. The driver extends the
+//  32 bit counter to 64 bits (it wraps after about 30 hours) and converts
+//  ticks to nanoseconds with the tick length trimmed by INTERNAL_FREQ_FINE.
+//
+//****************************************************************************//
+
+// Address: 0x19, bit[5] and 0x0A, bit[7:6]
+// Starts or stops the timestamp counter. fifoDecimation (see
+// LSM6DSO_FIFO_TS_DEC_t) also batches a timestamp word into the FIFO every
+// 1, 8 or 32 slots, which dates every sample fifoRead() returns.
+bool LSM6DSO::enableTimestamp(bool enable, uint8_t fifoDecimation) {
+
+  uint8_t trim;
+  status_t returnError = readRegister(&trim, INTERNAL_FREQ_FINE);
+  if( returnError != IMU_SUCCESS )
+    return false;
+
+  // 25us / (1 + 0.0015 * trim), in picoseconds.
+  tickPicoseconds = (static_cast<uint64_t>(TIMESTAMP_TICK_PS) * 10000) /
+                    (10000 + 15 * static_cast<int8_t>(trim));
+
+  beginConfig();
+
+  uint8_t regVal = readShadow(CTRL10_C) & TIMESTAMP_EN_MASK;
+  if( enable )
+    regVal |= TIMESTAMP_EN_ENABLED;
+  writeRegister(CTRL10_C, regVal);
+
+  regVal = readShadow(FIFO_CTRL4) & FIFO_TS_DEC_MASK;
+  if( enable )
+    regVal |= fifoDecimation & ~FIFO_TS_DEC_MASK;
+  writeRegister(FIFO_CTRL4, regVal);
+
+  if( commitConfig() != IMU_SUCCESS )
+    return false;
+
+  return true;
+}
+
+// Address: 0x42
+// Restarts the counter from zero.
+bool LSM6DSO::resetTimestamp() {
+
+  status_t returnError = writeRegister(TIMESTAMP2_REG, TIMESTAMP_RESET_VALUE);
+  if( returnError != IMU_SUCCESS )
+    return false;
+
+  lastTimestampLow = 0;
+  timestampHigh = 0;
+  lastFifoTimestampLow = 0;
+  fifoTimestampHigh = 0;
+  fifoTimeValid = false;
+  return true;
+}
+
+// Address: 0x40 - 0x43
+// Returns the current counter value in ticks, extended to 64 bits. Must be
+// called at least once per wrap (about 30 hours) to notice every rollover.
+uint64_t LSM6DSO::readTimestamp() {
+
+  uint8_t regVal[4];
+  status_t returnError = readMultipleRegisters(regVal, TIMESTAMP0_REG, 4);
+  if( returnError != IMU_SUCCESS ){
+    nonSuccessCounter++;
+    return 0;
+  }
+
+  uint32_t ticks = regVal[0] | static_cast<uint32_t>(regVal[1]) << 8 |
+                   static_cast<uint32_t>(regVal[2]) << 16 | static_cast<uint32_t>(regVal[3]) << 24;
+
+  return extendTimestamp(ticks, lastTimestampLow, timestampHigh);
+}
+
+// Ticks to nanoseconds, with the trim read by enableTimestamp(). Split so
+// the product doesn't overflow for any realistic uptime.
+uint64_t LSM6DSO::ticksToNs(uint64_t ticks) {
+
+  return (ticks / 1000) * tickPicoseconds + ((ticks % 1000) * tickPicoseconds) / 1000;
+}
+
+uint64_t LSM6DSO::extendTimestamp(uint32_t ticks, uint32_t &lastLow, uint32_t &high) {
+
+  if( ticks < lastLow )
+    high++;
+
+  lastLow = ticks;
+  return (static_cast<uint64_t>(high) << 32) | ticks;
+}
+
+// Length of one FIFO batching slot in ticks: the period of the faster of
+// the two batch data rates. ODR steps are powers of two below 6667Hz,
+// which is six ticks. Code 11 is 1.6Hz for the accelerometer and 6.5Hz for
+// the gyroscope.
+uint32_t LSM6DSO::fifoSlotTicks() {
+
+  uint8_t accelCode = readShadow(FIFO_CTRL3) & 0x0F;
+  uint8_t gyroCode = readShadow(FIFO_CTRL3) >> 4;
+  uint32_t slot = 0;
+
+  if( accelCode >= 1 && accelCode <= 10 )
+    slot = 6UL << (10 - accelCode);
+  else if( accelCode == 11 )
+    slot = 25000;
+
+  uint32_t gyroSlot = 0;
+  if( gyroCode >= 1 && gyroCode <= 10 )
+    gyroSlot = 6UL << (10 - gyroCode);
+  else if( gyroCode == 11 )
+    gyroSlot = 6144;
+
+  if( slot == 0 || (gyroSlot != 0 && gyroSlot < slot) )
+    slot = gyroSlot;
+
+  return slot;
+}
+
+//****************************************************************************//
+//
+//  Fixed point section
+//
+//  Integer counterparts of the calc/readFloat functions for cores without
+//  an FPU. Results are in milli-g and milli-dps, rounded the same way as
+//  lroundf() of the float path. A gyroscope conversion is one 32 bit
+//  multiply and a shift, an accelerometer conversion two.
+//
+//****************************************************************************//
+
+int32_t LSM6DSO::calcAccelMilli( int16_t input ) {
+
+  if( scaleChanged )
+    updateScale();
+
+  return lsm6dsoAccelMilli(input, accelMilliMultiplier);
+}
+
+int32_t LSM6DSO::calcGyroMilli( int16_t input ) {
+
+  if( scaleChanged )
+    updateScale();
+
+  return lsm6dsoGyroMilli(input, gyroMilliMultiplier);
+}
+
+// Multiplier for calcAccelMilli(), milli-g per LSB in Q32, for batch
+// conversions with lsm6dsoAccelToMilli().
+uint32_t LSM6DSO::getAccelMilliScale() {
+
+  if( scaleChanged )
+    updateScale();
+
+  return accelMilliMultiplier;
+}
+
+// Multiplier for calcGyroMilli(), milli-dps per LSB in Q8, for batch
+// conversions with lsm6dsoGyroToMilli().
+uint16_t LSM6DSO::getGyroMilliScale() {
+
+  if( scaleChanged )
+    updateScale();
+
+  return gyroMilliMultiplier;
+}
+
+int32_t LSM6DSO::readMilliAccelX() {
+  return calcAccelMilli(readRawAccelX());
+}
+
+int32_t LSM6DSO::readMilliAccelY() {
+  return calcAccelMilli(readRawAccelY());
+}
+
+int32_t LSM6DSO::readMilliAccelZ() {
+  return calcAccelMilli(readRawAccelZ());
+}
+
+int32_t LSM6DSO::readMilliGyroX() {
+  return calcGyroMilli(readRawGyroX());
+}
+
+int32_t LSM6DSO::readMilliGyroY() {
+  return calcGyroMilli(readRawGyroY());
+}
+
+int32_t LSM6DSO::readMilliGyroZ() {
+  return calcGyroMilli(readRawGyroZ());
+}
+
+// Address: 0x10, bit[3:2] and 0x17, bit[1]
+// Same decoding as accelScale(): 0.061, 0.122, 0.244 and 0.488 mg/LSB
+// times 2^32, rounded up.
+uint32_t LSM6DSO::accelMilliScale( uint8_t ctrl1, uint8_t ctrl8 ) {
+
+  uint8_t accelRange = (ctrl1 >> 2) & 0x03;
+  bool scale = (ctrl8 >> 1) & 0x01;
+
+  switch( accelRange ){
+    case 0:
+      return 261993006;
+    case 1:
+      return scale ? 261993006 : 2095944041;
+    case 2:
+      return 523986011;
+    case 3:
+    default:
+      return 1047972021;
+  }
+}
+
+// Address: 0x11, bit[3:1]
+// Same decoding as gyroScale(): 4.375, 8.75, 17.5, 35 and 70 mdps/LSB
+// times 256, all exact.
+uint16_t LSM6DSO::gyroMilliScale( uint8_t regVal ) {
+
+  if( (regVal >> 1) & 0x01 )
+    return 1120;
+
+  switch( (regVal >> 2) & 0x03 ){
+    case 0:
+      return 2240;
+    case 1:
+      return 4480;
+    case 2:
+      return 8960;
+    case 3:
+    default:
+      return 17920;
+  }
+}
+
+//****************************************************************************//
+//
+//  Binary format helpers
+//
+//****************************************************************************//
+
+// CRC-16/CCITT-FALSE, a byte at a time without a table. The bit by bit
+// loop took longer than building a stream frame itself.
+uint16_t lsm6dsoChecksum( const uint8_t data[], uint16_t length ) {
+
+  uint16_t crc = 0xFFFF;
+
+  for( uint16_t i = 0; i < length; i++ ){
+    crc = (crc >> 8) | (crc << 8);
+    crc ^= data[i];
+    crc ^= (crc & 0xFF) >> 4;
+    crc ^= crc << 12;
+    crc ^= (crc & 0xFF) << 5;
+  }
+
+  return crc;
+}
@@ -29,12 +29,133 @@ Distributed as-is; no warranty is given.
 
 #include <stdint.h>
 #include <Wire.h>
+#include <SPI.h>
 #include <Arduino.h>
 
 #define I2C_MODE 0
+#define SPI_MODE 1
+#define LINUX_I2C_MODE 2
+#define SPI_READ_COMMAND 0x80
 #define DEFAULT_ADDRESS 0x6B
 #define ALT_ADDRESS 0x6A
 
+// Linux builds outside the Arduino environment can also talk to the sensor
+// through the kernel's i2c-dev interface (/dev/i2c-N).
+#if defined(__linux__) && !defined(ARDUINO)
+  #define LSM6DSO_LINUX_I2C
+#endif
+
+// Registers FIFO_CTRL1 (0x07) through CTRL10_C (0x19) and TAP_CFG0 (0x56)
+// through TAP_CFG2 (0x58) are mirrored by the driver so that configuration
+// can be inspected without touching the bus.
+#define SHADOW_FIRST_REG 0x07
+#define SHADOW_LAST_REG 0x19
+#define SHADOW_TAP_FIRST_REG 0x56
+#define SHADOW_TAP_LAST_REG 0x58
+#define SHADOW_MAIN_LENGTH (SHADOW_LAST_REG - SHADOW_FIRST_REG + 1)
+#define SHADOW_TAP_LENGTH (SHADOW_TAP_LAST_REG - SHADOW_TAP_FIRST_REG + 1)
+#define SHADOW_LENGTH (SHADOW_MAIN_LENGTH + SHADOW_TAP_LENGTH)
+#define SHADOW_NONE 0xFF
+
+// Unchanged registers a configuration burst may rewrite to avoid splitting
+// into two transfers.
+#define CONFIG_MERGE_GAP 2
+
+// Largest single read the Wire library can return in one requestFrom().
+#ifndef LSM6DSO_I2C_BUFFER_LENGTH
+  #if defined(I2C_BUFFER_LENGTH)
+    #define LSM6DSO_I2C_BUFFER_LENGTH I2C_BUFFER_LENGTH
+  #elif defined(BUFFER_LENGTH)
+    #define LSM6DSO_I2C_BUFFER_LENGTH BUFFER_LENGTH
+  #else
+    #define LSM6DSO_I2C_BUFFER_LENGTH 32
+  #endif
+#endif
+
+// Register write scripts for writeScript(), as extras/host/lsm6dso_ucf
+// compiles them from ST's .ucf files. Records follow each other, each
+// starting with a code byte:
+//   1 to SCRIPT_MAX_BURST  a burst of that many bytes: register, then data
+//   SCRIPT_INC_OFF/_ON     clear or set IF_INC, only in the main bank
+//   SCRIPT_WAIT            a pause, milliseconds as 16 bits little endian
+//   SCRIPT_END
+#define SCRIPT_END 0x00
+#define SCRIPT_MAX_BURST 0xFC
+#define SCRIPT_INC_OFF 0xFD
+#define SCRIPT_INC_ON 0xFE
+#define SCRIPT_WAIT 0xFF
+
+// Script bytes copied out of program memory per write.
+#ifndef LSM6DSO_SCRIPT_CHUNK
+  #if defined(__AVR__)
+    #define LSM6DSO_SCRIPT_CHUNK 16
+  #else
+    #define LSM6DSO_SCRIPT_CHUNK 64
+  #endif
+#endif
+
+// Each FIFO entry is a tag byte followed by six data bytes. A compressed
+// word can expand to as many as three samples.
+#define FIFO_WORD_LENGTH 7
+#define FIFO_MAX_SAMPLES_PER_WORD 3
+#define FIFO_MAX_WORDS 511
+// Integer sensitivities: milli-g = raw * multiplier / 2^ACCEL_MILLI_SHIFT,
+// milli-dps = raw * multiplier / 2^GYRO_MILLI_SHIFT. Every integer
+// conversion goes through lsm6dsoAccelMilli()/lsm6dsoGyroMilli(), which
+// round half away from zero like lroundf() on the float path.
+#define ACCEL_MILLI_SHIFT 32
+#define GYRO_MILLI_SHIFT 8
+
+// The accelerometer multiplier is ug per LSB * 2^32 / 1000 rounded up,
+// close enough that every int16 count converts exactly. The 47 bit product
+// is built from the multiplier's two 16 bit halves, so it stays a pair of
+// 32 bit multiplies. The gyroscope's Q8 multiplier is exact.
+inline int32_t lsm6dsoAccelMilli( int16_t input, uint32_t milliScale )
+{
+  uint32_t magnitude = input < 0 ? -static_cast<int32_t>(input) : input;
+  int32_t milli = (magnitude * (milliScale >> 16) + ((magnitude * (milliScale & 0xFFFF)) >> 16) + 0x8000) >> 16;
+  return input < 0 ? -milli : milli;
+}
+
+inline int32_t lsm6dsoGyroMilli( int16_t input, uint16_t milliScale )
+{
+  const int32_t half = 1L << (GYRO_MILLI_SHIFT - 1);
+  int32_t product = static_cast<int32_t>(input) * milliScale;
+  return product < 0 ? -((half - product) >> GYRO_MILLI_SHIFT) : (product + half) >> GYRO_MILLI_SHIFT;
+}
+
+// Little endian fields and the CRC-16/CCITT-FALSE shared by the binary
+// formats: stream frames, log blocks and calibration blobs.
+inline void lsm6dsoPutUint16( uint8_t buffer[], uint16_t value )
+{
+  buffer[0] = value & 0xFF;
+  buffer[1] = value >> 8;
+}
+
+inline uint16_t lsm6dsoGetUint16( const uint8_t buffer[] )
+{
+  return buffer[0] | static_cast<uint16_t>(buffer[1] << 8);
+}
+
+inline void lsm6dsoPutUint32( uint8_t buffer[], uint32_t value )
+{
+  lsm6dsoPutUint16(buffer, value & 0xFFFF);
+  lsm6dsoPutUint16(&buffer[2], value >> 16);
+}
+
+inline uint32_t lsm6dsoGetUint32( const uint8_t buffer[] )
+{
+  return lsm6dsoGetUint16(buffer) | static_cast<uint32_t>(lsm6dsoGetUint16(&buffer[2])) << 16;
+}
+
+uint16_t lsm6dsoChecksum( const uint8_t data[], uint16_t length );
+
+// Timestamp resolution is 25us, trimmed by 0.15% per INTERNAL_FREQ_FINE LSB.
+#define TIMESTAMP_TICK_PS 25000000UL
+#define TIMESTAMP_RESET_VALUE 0xAA
+
+#define FIFO_WORDS_PER_BURST ((LSM6DSO_I2C_BUFFER_LENGTH > 255 ? 255 : LSM6DSO_I2C_BUFFER_LENGTH) / FIFO_WORD_LENGTH)
+
 // Return values 
 typedef enum
 {
@@ -57,12 +178,68 @@ public:
 
 	LSM6DSOCore();
 	status_t beginCore(uint8_t, TwoWire &i2cPort );
+	status_t beginCoreSPI(uint8_t, uint32_t, SPIClass &spiPort );
+#ifdef LSM6DSO_LINUX_I2C
+	// Closes the i2c-dev node, if one is open.
+	~LSM6DSOCore();
+	status_t beginCoreLinux(const char*, uint8_t);
+	void endCoreLinux();
+#endif
 	status_t readMultipleRegisters(uint8_t*, uint8_t, uint8_t );
+	status_t readBulk(uint8_t*, uint8_t, uint16_t);
 	status_t readRegister(uint8_t*, uint8_t);
 	status_t readRegisterInt16(int16_t*, uint8_t);
 	status_t writeRegister(uint8_t, uint8_t);
 	status_t writeMultipleRegisters(uint8_t*, uint8_t, uint8_t);
   status_t enableEmbeddedFunctions(bool = true);
+
+  status_t openEmbeddedBank(bool pageBursts = false);
+  status_t closeEmbeddedBank();
+  status_t readEmbedded(uint8_t*, uint8_t, uint8_t);
+  status_t writeEmbedded(uint8_t*, uint8_t, uint8_t);
+  status_t readPage(uint8_t*, uint16_t, uint16_t);
+  status_t writePage(const uint8_t*, uint16_t, uint16_t);
+
+  status_t writeScript(const uint8_t*);
+
+  status_t resyncShadow();
+  uint8_t  readShadow(uint8_t);
+
+  const void *getBus();
+
+  void     beginConfig();
+  status_t commitConfig();
+  // Fails the whole transaction; the outermost commitConfig() then drops
+  // every staged write and returns IMU_GENERIC_ERROR.
+  void     abortConfig();
+
+protected:
+
+  void updateShadow(const uint8_t*, uint8_t, uint8_t);
+  uint8_t maxReadLength();
+  uint8_t advanceAddress(uint8_t, uint16_t);
+  uint8_t shadowIndex(uint8_t);
+  uint8_t shadowAddress(uint8_t);
+  bool stageWrite(const uint8_t*, uint8_t, uint8_t);
+  bool bankBlocks(uint8_t);
+  status_t pageTransfer(uint8_t*, uint16_t, uint16_t, uint8_t);
+
+  uint8_t shadowRegs[SHADOW_LENGTH];
+  uint8_t stagedRegs[SHADOW_LENGTH];
+  uint8_t configDepth;
+  // Set by abortConfig() inside a nested transaction until the outermost
+  // level ends.
+  bool configAborted;
+  bool embeddedBankActive;
+  bool scaleChanged;
+
+  // Nesting depth of openEmbeddedBank(), whether the outermost call
+  // switched the bank and cleared IF_INC, and whether the access in
+  // progress is meant for the embedded bank.
+  uint8_t embeddedDepth;
+  bool embeddedOpened;
+  bool pageIncCleared;
+  bool embeddedAccess;
 	
 private:
 
@@ -71,9 +248,51 @@ private:
 	uint8_t chipSelectPin;
 
   TwoWire *_i2cPort;
+  SPIClass *_spiPort;
+  SPISettings commSettings;
+
+#ifdef LSM6DSO_LINUX_I2C
+  status_t linuxRead(uint8_t*, uint8_t, uint16_t);
+  status_t linuxWrite(const uint8_t*, uint8_t, uint8_t);
+
+  int _i2cFile;
+  bool _i2cPlainTransfers;
+#endif
 	
 };
 
+// Keeps the embedded function bank selected for its lifetime. Guards nest,
+// and only the outermost one switches banks, so a run of embedded accesses
+// costs one switch there and one back. While a guard is held, plain
+// register calls are refused rather than landing in the embedded bank; go
+// through readEmbedded()/writeEmbedded()/readPage()/writePage() instead.
+// With pageBursts, IF_INC is cleared for the guard's lifetime so page
+// transfers move in bursts; it can't be changed while a guard is held.
+//
+//   {
+//     LSM6DSOEmbeddedBank bank(myIMU);
+//     myIMU.writeEmbedded(&value, EMB_FUNC_EN_B, 1);
+//     myIMU.readPage(buffer, 0x017A, length);
+//   }
+class LSM6DSOEmbeddedBank
+{
+  public:
+
+    LSM6DSOEmbeddedBank(LSM6DSOCore &imu, bool pageBursts = false) :
+      imu(imu), status(imu.openEmbeddedBank(pageBursts)) {}
+    ~LSM6DSOEmbeddedBank() { if( status == IMU_SUCCESS ) imu.closeEmbeddedBank(); }
+
+    status_t getStatus() const { return status; }
+
+  private:
+
+    LSM6DSOEmbeddedBank(const LSM6DSOEmbeddedBank &);
+    LSM6DSOEmbeddedBank &operator=(const LSM6DSOEmbeddedBank &);
+
+    LSM6DSOCore &imu;
+    status_t status;
+};
+
 //This struct holds the settings the driver uses to do calculations
 struct SensorSettings {
 public:
@@ -122,6 +341,53 @@ public:
 
   float temperatureC; 
   float temperatureF; 
+
+  // Sensor time of the sample in nanoseconds, zero until the FIFO has
+  // delivered a timestamp word. See enableTimestamp().
+  uint64_t timestampNs;
+};
+
+// One snapshot of the output registers, OUT_TEMP_L (0x20) through OUTZ_H_A
+// (0x2D), in register order.
+struct imuRawData {
+public:
+  int16_t temperature;
+
+  int16_t xGyro;
+  int16_t yGyro;
+  int16_t zGyro;
+
+  int16_t xAccel;
+  int16_t yAccel;
+  int16_t zAccel;
+};
+
+// The same snapshot with every axis scaled to g, dps and degrees C.
+struct imuData {
+public:
+  imuRawData raw;
+
+  float xAccel;
+  float yAccel;
+  float zAccel;
+
+  float xGyro;
+  float yGyro;
+  float zGyro;
+
+  float temperatureC;
+};
+
+// What pollAll() has found so far: polls made, polls that found nothing
+// new, and fresh samples per sensor. The wasted share shows whether the
+// loop polls faster than the data rates need.
+struct pollStatistics {
+public:
+  uint32_t polls;
+  uint32_t emptyPolls;
+  uint32_t accelSamples;
+  uint32_t gyroSamples;
+  uint32_t temperatureSamples;
 };
 
 
@@ -156,6 +422,10 @@ class LSM6DSO : public LSM6DSOCore
 
     LSM6DSO();
     bool begin(uint8_t deviceAddress = DEFAULT_ADDRESS, TwoWire &i2cPort = Wire);
+    bool beginSPI(uint8_t, uint32_t spiPortSpeed = 10000000, SPIClass &spiPort = SPI);
+#ifdef LSM6DSO_LINUX_I2C
+    bool beginLinux(const char*, uint8_t deviceAddress = DEFAULT_ADDRESS);
+#endif
     bool initialize(uint8_t settings = BASIC_SETTINGS);
     status_t beginSettings();
 
@@ -167,6 +437,12 @@ class LSM6DSO : public LSM6DSOCore
     bool setBlockDataUpdate(bool);
     bool setHighPerfAccel(bool);
     bool setHighPerfGyro(bool);
+    bool setAccelUserOffset(const int8_t*, uint8_t weight = 0x00);  // USER_OFFSET_2_10
+    bool getAccelUserOffset(int8_t*, uint8_t &);
+    bool enableAccelUserOffset(bool enable = true);
+    bool setInterruptOne(uint8_t);
+    bool setInterruptTwo(uint8_t);
+    bool setBatchCounterThreshold(uint16_t, bool gyroTrigger = false);
 
     uint8_t  getAccelRange();
     float    getAccelDataRate();
@@ -190,13 +466,96 @@ class LSM6DSO : public LSM6DSOCore
     float readFloatGyroY();
     float readFloatGyroZ();
 
+    bool readAllRaw(imuRawData &);
+    bool readAll(imuData &);
+    static void unpackAllRaw(const uint8_t *, imuRawData &);
+
+    uint8_t pollAllRaw(imuRawData &);
+    uint8_t pollAll(imuData &);
+    const pollStatistics &getPollStatistics() const;
+    void resetPollStatistics();
+
     float calcGyro( int16_t );
     float calcAccel( int16_t );
+    float calcTemp( int16_t );
+    float getAccelSensitivity();
+    float getGyroSensitivity();
+
+    int32_t readMilliAccelX();
+    int32_t readMilliAccelY();
+    int32_t readMilliAccelZ();
+    int32_t readMilliGyroX();
+    int32_t readMilliGyroY();
+    int32_t readMilliGyroZ();
+
+    int32_t calcAccelMilli( int16_t );
+    int32_t calcGyroMilli( int16_t );
+    uint32_t getAccelMilliScale();
+    uint16_t getGyroMilliScale();
 
     bool setIncrement(bool enable = true) ;
 
+    status_t beginFifoSettings();
+    bool setFifoDepth(uint16_t);
+    bool setAccelBatchDataRate(uint16_t);
+    bool setGyroBatchDataRate(uint16_t);
+    bool setFifoMode(uint8_t);
+    uint16_t getFifoDepth();
+    uint16_t getFifoStatus();
+    uint16_t getUnreadFifoWords();
+    uint16_t fifoReadWords(uint8_t*, uint16_t);
+    uint16_t fifoRead(fifoData*, uint16_t);
+    uint8_t  decodeFifoWord(const uint8_t*, fifoData*);
+    uint8_t  decodeFifoWordRaw(const uint8_t*, int16_t[][3], uint8_t*, uint8_t &);
+    uint64_t getFifoSampleTicks(uint8_t slotsBack = 0);
+    bool setFifoCompression(bool, uint8_t uncompressedRate = 0);
+    void resetFifoDecoder();
+
+    bool enableTimestamp(bool enable = true, uint8_t fifoDecimation = 0x40);  // FIFO_TS_DEC_BY_1
+    bool resetTimestamp();
+    uint64_t readTimestamp();
+    uint64_t ticksToNs(uint64_t);
+
   private:
 
+    void  updateScale();
+    float accelScale(uint8_t, uint8_t);
+    float gyroScale(uint8_t);
+    uint32_t accelMilliScale(uint8_t, uint8_t);
+    uint16_t gyroMilliScale(uint8_t);
+
+    void fillFifoSample(fifoData &, uint8_t, const int16_t*);
+    uint64_t extendTimestamp(uint32_t, uint32_t &, uint32_t &);
+    uint32_t fifoSlotTicks();
+
+    float accelSensitivity;
+    float gyroSensitivity;
+    uint32_t accelMilliMultiplier;
+    uint16_t gyroMilliMultiplier;
+
+    pollStatistics pollStats;
+
+    // Last reconstructed sample per sensor, used as the reference for
+    // compressed FIFO words.
+    int16_t lastAccelRaw[3];
+    int16_t lastGyroRaw[3];
+    bool accelReferenceValid;
+    bool gyroReferenceValid;
+
+    // Timestamp tick length from INTERNAL_FREQ_FINE, and the 32 bit counter
+    // extended to 64 bits, separately for direct reads and the FIFO stream
+    // since FIFO timestamps lag behind the live counter.
+    uint32_t tickPicoseconds;
+    uint32_t lastTimestampLow;
+    uint32_t timestampHigh;
+    uint32_t lastFifoTimestampLow;
+    uint32_t fifoTimestampHigh;
+
+    // Time of the FIFO batching slot being decoded and its TAG_CNT.
+    uint64_t fifoSlotTime;
+    uint8_t fifoTagCount;
+    bool fifoTimeValid;
+
 };
 
 enum LSM6DSO_REGISTERS {
@@ -344,6 +703,28 @@ enum EMBEDDED_REGISTERS {
 
 };
 
+// Advanced feature pages. readPage() and writePage() take the page number
+// in the high byte of the address and the address within it in the low
+// byte; a transfer may run on into the next page.
+#define PAGE_SEL_SHIFT 4
+// PAGE_SEL bit 0 must always be written as 1.
+#define PAGE_SEL_RESERVED 0x01
+#define PAGE_LAST 0x0F
+
+/*******************************************************************************
+* Register      : PAGE_RW (embedded bank)
+* Address       : 0x17
+* Bit Group Name: PAGE_READ, PAGE_WRITE, EMB_FUNC_LIR
+* Permission    : RW
+*******************************************************************************/
+typedef enum {
+	PAGE_RW_DISABLED     = 0x00,
+	PAGE_READ_ENABLED    = 0x20,
+	PAGE_WRITE_ENABLED   = 0x40,
+	EMB_FUNC_LIR_ENABLED = 0x80,
+	PAGE_RW_MASK         = 0x9F
+} LSM6DSO_PAGE_RW_t;
+
 // Fifo Tags - not a complete list. 
 typedef enum {
 
@@ -371,7 +752,7 @@ typedef enum {
 *******************************************************************************/
 typedef enum {
 	FIFO_STOP_ON_WTM_DISABLED = 0x00,
-	FIFO_STOP_ON_WTM_ENABLED = 0x01,
+	FIFO_STOP_ON_WTM_ENABLED = 0x80,
 	FIFO_STOP_ON_WTM_MASK     = 0x7F
 } LSM6DSO_STOP_ON_WTM_t;
 
@@ -383,7 +764,7 @@ typedef enum {
 *******************************************************************************/
 typedef enum {
 	FIFO_COMPR_RT_DISABLED = 0x00,
-	FIFO_COMPR_RT_ENABLE   = 0x01,
+	FIFO_COMPR_RT_ENABLE   = 0x40,
 	FIFO_COMPR_RT_MASK     = 0xBF
 } LSM6DSO_FIFO_COMPR_RT_t;
 
@@ -396,7 +777,7 @@ typedef enum {
 *******************************************************************************/
 typedef enum {
 	FIFO_ODRCHG_DISABLED = 0x00,
-	FIFO_ODRCHG_ENABLE   = 0x01,
+	FIFO_ODRCHG_ENABLE   = 0x10,
 	FIFO_ODRCHG_MASK     = 0xEF
 } LSM6DSO_FIFO_ODRCHG_t;
 
@@ -468,9 +849,10 @@ typedef enum {
 *******************************************************************************/
 typedef enum {
 	FIFO_TS_DEC_DISABLED = 0x00,
-	FIFO_TS_DEC_BY_1 		 = 0x04,
-	FIFO_TS_DEC_BY_8 		 = 0x08,
-	FIFO_TS_DEC_BY_32 	 = 0x0C
+	FIFO_TS_DEC_BY_1 		 = 0x40,
+	FIFO_TS_DEC_BY_8 		 = 0x80,
+	FIFO_TS_DEC_BY_32 	 = 0xC0,
+	FIFO_TS_DEC_MASK 	   = 0x3F
 } LSM6DSO_FIFO_TS_DEC_t;
 
 /*******************************************************************************
@@ -502,6 +884,28 @@ typedef enum {
   FIFO_MODE_MASK           = 0xF0 
 } LSM6DSO_FIFO_MODE_t;
 
+/*******************************************************************************
+* Register      : COUNTER_BDR_REG1
+* Address       : 0x0B
+* Bit Group Name: DATAREADY_PULSED
+* Permission    : RW
+*******************************************************************************/
+typedef enum {
+	DATAREADY_PULSED_DISABLED = 0x00,
+	DATAREADY_PULSED_ENABLED  = 0x80
+} LSM6DSO_DATAREADY_PULSED_t;
+
+/*******************************************************************************
+* Register      : COUNTER_BDR_REG1
+* Address       : 0x0B
+* Bit Group Name: RST_COUNTER_BDR
+* Permission    : RW
+*******************************************************************************/
+typedef enum {
+	RST_COUNTER_BDR_DISABLED = 0x00,
+	RST_COUNTER_BDR_ENABLED  = 0x40
+} LSM6DSO_RST_COUNTER_BDR_t;
+
 /*******************************************************************************
 * Register      : ORIENT_CFG_G
 * Address       : 0x0B
@@ -1033,6 +1437,7 @@ typedef enum {
 typedef enum {
 	USER_OFFSET_2_10 = 0x00,
 	USER_OFFSET_2_6  = 0x08,
+	USER_OFFSET_MASK = 0xF7,
 } LSM6DSO_USER_OFFSET_t;
 
 /*******************************************************************************
@@ -1095,6 +1500,18 @@ typedef enum {
 	HPM_G_1_04Hz = 0x40,
 } LSM6DSO_HPM_G_t;
 
+/*******************************************************************************
+* Register      : CTRL7_G
+* Address       : 0x16
+* Bit Group Name: USR_OFF_ON_OUT
+* Permission    : RW
+*******************************************************************************/
+typedef enum {
+	USR_OFF_ON_OUT_DISABLED = 0x00,
+	USR_OFF_ON_OUT_ENABLED  = 0x02,
+	USR_OFF_ON_OUT_MASK     = 0xFD,
+} LSM6DSO_USR_OFF_ON_OUT_t;
+
 /*******************************************************************************
 * Register      : CTRL8_XL
 * Address       : 0x17
@@ -1183,6 +1600,18 @@ typedef enum {
 	FUNC_EN_ENABLED 		 = 0x04,
 } LSM6DSO_FUNC_EN_t;
 
+/*******************************************************************************
+* Register      : CTRL10_C
+* Address       : 0x19
+* Bit Group Name: TIMESTAMP_EN
+* Permission    : RW
+*******************************************************************************/
+typedef enum {
+	TIMESTAMP_EN_DISABLED 		 = 0x00,
+	TIMESTAMP_EN_ENABLED 		 = 0x20,
+	TIMESTAMP_EN_MASK 		     = 0xDF
+} LSM6DSO_TIMESTAMP_EN_t;
+
 /*******************************************************************************
 * Register      : ALL_INT_SRC
 * Address       : 0x1A
@@ -0,0 +1,451 @@
+#include "SparkFunLSM6DSO_AHRS.h"
+
+#include <math.h>
+#include <string.h>
+
+#define AHRS_DEG_TO_RAD 0.0174532925f
+#define AHRS_RAD_TO_DEG 57.2957795f
+
+// 2^30 in 2.30 fixed point.
+#define Q30_ONE 0x40000000L
+
+void lsm6dsoQuaternionToEuler(float w, float x, float y, float z, float &roll, float &pitch, float &yaw)
+{
+  roll = atan2f(w * x + y * z, 0.5f - x * x - y * y) * AHRS_RAD_TO_DEG;
+
+  float sinPitch = 2.0f * (w * y - x * z);
+  if( sinPitch > 1.0f )
+    sinPitch = 1.0f;
+  else if( sinPitch < -1.0f )
+    sinPitch = -1.0f;
+  pitch = asinf(sinPitch) * AHRS_RAD_TO_DEG;
+
+  yaw = atan2f(x * y + w * z, 0.5f - y * y - z * z) * AHRS_RAD_TO_DEG;
+}
+
+//****************************************************************************//
+//
+//  LSM6DSOAhrs
+//
+//****************************************************************************//
+
+LSM6DSOAhrs::LSM6DSOAhrs(LSM6DSO_AHRS_ALGORITHM_t algorithm) :
+  algorithm(algorithm),
+  beta(AHRS_MADGWICK_BETA),
+  kp(AHRS_MAHONY_KP),
+  ki(AHRS_MAHONY_KI),
+  samplePeriod(1.0f / 104)
+{
+  reset();
+}
+
+void LSM6DSOAhrs::setAlgorithm(LSM6DSO_AHRS_ALGORITHM_t newAlgorithm)
+{
+  algorithm = newAlgorithm;
+}
+
+void LSM6DSOAhrs::setMadgwickBeta(float newBeta)
+{
+  beta = newBeta;
+}
+
+void LSM6DSOAhrs::setMahonyGains(float newKp, float newKi)
+{
+  kp = newKp;
+  ki = newKi;
+  integralX = 0;
+  integralY = 0;
+  integralZ = 0;
+}
+
+void LSM6DSOAhrs::setSamplePeriod(float seconds)
+{
+  samplePeriod = seconds;
+}
+
+void LSM6DSOAhrs::reset()
+{
+  q0 = 1;
+  q1 = 0;
+  q2 = 0;
+  q3 = 0;
+
+  integralX = 0;
+  integralY = 0;
+  integralZ = 0;
+
+  accelValid = false;
+  lastGyroNs = 0;
+}
+
+void LSM6DSOAhrs::update(float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+  step(gx, gy, gz, ax, ay, az, dt);
+  normalize();
+}
+
+// Gyroscope entries are the clock of the filter. Within a batching slot the
+// FIFO holds the gyroscope and accelerometer samples next to each other, so
+// the latest accelerometer entry is at most one slot away from the gyroscope
+// sample it's paired with.
+uint16_t LSM6DSOAhrs::updateFifo(const fifoData samples[], uint16_t count)
+{
+  uint16_t steps = 0;
+
+  for( uint16_t i = 0; i < count; i++ ){
+
+    const fifoData &sample = samples[i];
+
+    if( sample.fifoTag == ACCELEROMETER_DATA ){
+      accelX = sample.xAccel;
+      accelY = sample.yAccel;
+      accelZ = sample.zAccel;
+      accelValid = true;
+      continue;
+    }
+
+    if( sample.fifoTag != GYROSCOPE_DATA )
+      continue;
+
+    float dt = samplePeriod;
+    if( sample.timestampNs != 0 ){
+      if( lastGyroNs != 0 && sample.timestampNs > lastGyroNs &&
+          sample.timestampNs - lastGyroNs < AHRS_MAX_STEP_NS )
+        dt = static_cast<float>(sample.timestampNs - lastGyroNs) * 1e-9f;
+      lastGyroNs = sample.timestampNs;
+    }
+
+    if( accelValid )
+      step(sample.xGyro, sample.yGyro, sample.zGyro, accelX, accelY, accelZ, dt);
+    else
+      step(sample.xGyro, sample.yGyro, sample.zGyro, 0, 0, 0, dt);
+
+    renormalize();
+    steps++;
+  }
+
+  if( steps > 0 )
+    normalize();
+
+  return steps;
+}
+
+void LSM6DSOAhrs::getQuaternion(float &w, float &x, float &y, float &z) const
+{
+  w = q0;
+  x = q1;
+  y = q2;
+  z = q3;
+}
+
+void LSM6DSOAhrs::getEuler(float &roll, float &pitch, float &yaw) const
+{
+  lsm6dsoQuaternionToEuler(q0, q1, q2, q3, roll, pitch, yaw);
+}
+
+void LSM6DSOAhrs::step(float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+  gx *= AHRS_DEG_TO_RAD;
+  gy *= AHRS_DEG_TO_RAD;
+  gz *= AHRS_DEG_TO_RAD;
+
+  if( algorithm == AHRS_MAHONY )
+    stepMahony(gx, gy, gz, ax, ay, az, dt);
+  else
+    stepMadgwick(gx, gy, gz, ax, ay, az, dt);
+}
+
+// Gyroscope integration plus a gradient descent step towards the attitude
+// that puts gravity along the measured acceleration, weighted by beta.
+void LSM6DSOAhrs::stepMadgwick(float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+  float qDot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+  float qDot1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+  float qDot2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+  float qDot3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+  if( ax != 0 || ay != 0 || az != 0 ){
+
+    float recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+    ax *= recipNorm;
+    ay *= recipNorm;
+    az *= recipNorm;
+
+    float _2q0 = 2.0f * q0;
+    float _2q1 = 2.0f * q1;
+    float _2q2 = 2.0f * q2;
+    float _2q3 = 2.0f * q3;
+    float _4q0 = 4.0f * q0;
+    float _4q1 = 4.0f * q1;
+    float _4q2 = 4.0f * q2;
+    float _8q1 = 8.0f * q1;
+    float _8q2 = 8.0f * q2;
+    float q0q0 = q0 * q0;
+    float q1q1 = q1 * q1;
+    float q2q2 = q2 * q2;
+    float q3q3 = q3 * q3;
+
+    float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+    float s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+    float s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+    float s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+
+    float sNorm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+    if( sNorm > 0 ){
+      recipNorm = beta * invSqrt(sNorm);
+      qDot0 -= recipNorm * s0;
+      qDot1 -= recipNorm * s1;
+      qDot2 -= recipNorm * s2;
+      qDot3 -= recipNorm * s3;
+    }
+  }
+
+  q0 += qDot0 * dt;
+  q1 += qDot1 * dt;
+  q2 += qDot2 * dt;
+  q3 += qDot3 * dt;
+}
+
+// Gyroscope integration with a PI controller on the angle between measured
+// and estimated gravity.
+void LSM6DSOAhrs::stepMahony(float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+  if( ax != 0 || ay != 0 || az != 0 ){
+
+    float recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+    ax *= recipNorm;
+    ay *= recipNorm;
+    az *= recipNorm;
+
+    // Half of the estimated gravity direction, and half the error.
+    float halfVx = q1 * q3 - q0 * q2;
+    float halfVy = q0 * q1 + q2 * q3;
+    float halfVz = q0 * q0 - 0.5f + q3 * q3;
+
+    float halfEx = ay * halfVz - az * halfVy;
+    float halfEy = az * halfVx - ax * halfVz;
+    float halfEz = ax * halfVy - ay * halfVx;
+
+    if( ki > 0 ){
+      integralX += 2.0f * ki * halfEx * dt;
+      integralY += 2.0f * ki * halfEy * dt;
+      integralZ += 2.0f * ki * halfEz * dt;
+      gx += integralX;
+      gy += integralY;
+      gz += integralZ;
+    }
+
+    gx += 2.0f * kp * halfEx;
+    gy += 2.0f * kp * halfEy;
+    gz += 2.0f * kp * halfEz;
+  }
+
+  gx *= 0.5f * dt;
+  gy *= 0.5f * dt;
+  gz *= 0.5f * dt;
+
+  float qa = q0;
+  float qb = q1;
+  float qc = q2;
+  q0 += -qb * gx - qc * gy - q3 * gz;
+  q1 += qa * gx + qc * gz - q3 * gy;
+  q2 += qa * gy - qb * gz + q3 * gx;
+  q3 += qa * gz + qb * gy - qc * gx;
+}
+
+void LSM6DSOAhrs::normalize()
+{
+  float recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+  q0 *= recipNorm;
+  q1 *= recipNorm;
+  q2 *= recipNorm;
+  q3 *= recipNorm;
+}
+
+// One step drifts the norm by far less than a percent, close enough to 1
+// that a single Newton iteration of 1/sqrt(n) from 1 is as good as the
+// real thing.
+void LSM6DSOAhrs::renormalize()
+{
+  float scale = 1.5f - 0.5f * (q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+  q0 *= scale;
+  q1 *= scale;
+  q2 *= scale;
+  q3 *= scale;
+}
+
+float LSM6DSOAhrs::invSqrt(float x)
+{
+#if LSM6DSO_AHRS_FAST_INVSQRT
+  uint32_t bits;
+  float y;
+  memcpy(&bits, &x, sizeof(bits));
+  bits = 0x5F3759DF - (bits >> 1);
+  memcpy(&y, &bits, sizeof(y));
+  // The first iteration leaves up to 0.2% error, too much for the quaternion
+  // norm; the second brings it down to a few ppm.
+  y *= 1.5f - 0.5f * x * y * y;
+  return y * (1.5f - 0.5f * x * y * y);
+#else
+  return 1.0f / sqrtf(x);
+#endif
+}
+
+//****************************************************************************//
+//
+//  LSM6DSOMahonyQ30
+//
+//****************************************************************************//
+
+LSM6DSOMahonyQ30::LSM6DSOMahonyQ30() :
+  gyroScaleQ32(0),
+  kpQ16(32768),   // AHRS_MAHONY_KP
+  kiQ16(0)
+{
+  reset();
+}
+
+// milliScale / 2^GYRO_MILLI_SHIFT is mdps per count; times pi/180000 and
+// 2^32 that is milliScale * 292.82 in 0.32 fixed point.
+void LSM6DSOMahonyQ30::setGyroMilliScale(uint16_t milliScale)
+{
+  gyroScaleQ32 = static_cast<uint32_t>(milliScale) * 29282 / 100;
+}
+
+void LSM6DSOMahonyQ30::setGains(int32_t newKpQ16, int32_t newKiQ16)
+{
+  kpQ16 = newKpQ16;
+  kiQ16 = newKiQ16;
+  integral[0] = 0;
+  integral[1] = 0;
+  integral[2] = 0;
+}
+
+void LSM6DSOMahonyQ30::reset()
+{
+  q[0] = Q30_ONE;
+  q[1] = 0;
+  q[2] = 0;
+  q[3] = 0;
+
+  integral[0] = 0;
+  integral[1] = 0;
+  integral[2] = 0;
+}
+
+void LSM6DSOMahonyQ30::update(const int16_t gyro[3], const int16_t accel[3], uint32_t dtNs)
+{
+  if( dtNs > AHRS_MAX_STEP_NS )
+    dtNs = AHRS_MAX_STEP_NS;
+
+  // Seconds in 0.32 fixed point; 2^32 / 10^9 is 17592 / 2^12.
+  uint32_t dtQ32 = static_cast<uint32_t>((static_cast<uint64_t>(dtNs) * 17592) >> 12);
+
+  // Angular rate in rad/s, 16.16 fixed point.
+  int32_t rate[3];
+  for( uint8_t i = 0; i < 3; i++ )
+    rate[i] = static_cast<int32_t>((static_cast<int64_t>(gyro[i]) * gyroScaleQ32) >> 16);
+
+  uint32_t normSquared = static_cast<uint32_t>(static_cast<int32_t>(accel[0]) * accel[0]) +
+                         static_cast<uint32_t>(static_cast<int32_t>(accel[1]) * accel[1]) +
+                         static_cast<uint32_t>(static_cast<int32_t>(accel[2]) * accel[2]);
+  uint16_t norm = isqrt(normSquared);
+
+  if( norm > 0 ){
+
+    // Measured gravity direction, 2.30.
+    int32_t a[3];
+    for( uint8_t i = 0; i < 3; i++ )
+      a[i] = (static_cast<int32_t>(accel[i]) * 32768 / norm) * 32768;
+
+    int32_t halfV[3];
+    halfV[0] = mulQ30(q[1], q[3]) - mulQ30(q[0], q[2]);
+    halfV[1] = mulQ30(q[0], q[1]) + mulQ30(q[2], q[3]);
+    halfV[2] = mulQ30(q[0], q[0]) - Q30_ONE / 2 + mulQ30(q[3], q[3]);
+
+    int32_t halfE[3];
+    halfE[0] = mulQ30(a[1], halfV[2]) - mulQ30(a[2], halfV[1]);
+    halfE[1] = mulQ30(a[2], halfV[0]) - mulQ30(a[0], halfV[2]);
+    halfE[2] = mulQ30(a[0], halfV[1]) - mulQ30(a[1], halfV[0]);
+
+    for( uint8_t i = 0; i < 3; i++ ){
+      if( kiQ16 > 0 ){
+        int64_t increment = (static_cast<int64_t>(kiQ16) * halfE[i]) >> 21;
+        integral[i] += static_cast<int32_t>((increment * dtQ32) >> 32);
+        rate[i] += integral[i] >> 8;
+      }
+      rate[i] += static_cast<int32_t>((static_cast<int64_t>(kpQ16) * halfE[i]) >> 29);
+    }
+  }
+
+  // Half the rotation over dt, 2.30.
+  int32_t half[3];
+  for( uint8_t i = 0; i < 3; i++ )
+    half[i] = static_cast<int32_t>((static_cast<int64_t>(rate[i]) * dtQ32) >> 19);
+
+  int32_t qa = q[0];
+  int32_t qb = q[1];
+  int32_t qc = q[2];
+  q[0] += -mulQ30(qb, half[0]) - mulQ30(qc, half[1]) - mulQ30(q[3], half[2]);
+  q[1] += mulQ30(qa, half[0]) + mulQ30(qc, half[2]) - mulQ30(q[3], half[1]);
+  q[2] += mulQ30(qa, half[1]) - mulQ30(qb, half[2]) + mulQ30(q[3], half[0]);
+  q[3] += mulQ30(qa, half[2]) + mulQ30(qb, half[1]) - mulQ30(qc, half[0]);
+
+  renormalize();
+}
+
+void LSM6DSOMahonyQ30::getQuaternionQ30(int32_t output[4]) const
+{
+  output[0] = q[0];
+  output[1] = q[1];
+  output[2] = q[2];
+  output[3] = q[3];
+}
+
+void LSM6DSOMahonyQ30::getQuaternion(float &w, float &x, float &y, float &z) const
+{
+  const float scale = 1.0f / Q30_ONE;
+  w = q[0] * scale;
+  x = q[1] * scale;
+  y = q[2] * scale;
+  z = q[3] * scale;
+}
+
+// Same Newton step as LSM6DSOAhrs::renormalize(), which holds as long as
+// each step turns the sensor by a small fraction of a radian.
+void LSM6DSOMahonyQ30::renormalize()
+{
+  int64_t normSquared = static_cast<int64_t>(mulQ30(q[0], q[0])) + mulQ30(q[1], q[1]) +
+                        mulQ30(q[2], q[2]) + mulQ30(q[3], q[3]);
+  int32_t scale = static_cast<int32_t>((3 * static_cast<int64_t>(Q30_ONE) - normSquared) >> 1);
+
+  for( uint8_t i = 0; i < 4; i++ )
+    q[i] = mulQ30(q[i], scale);
+}
+
+int32_t LSM6DSOMahonyQ30::mulQ30(int32_t a, int32_t b)
+{
+  return static_cast<int32_t>((static_cast<int64_t>(a) * b) >> 30);
+}
+
+// Bit by bit integer square root, floor(sqrt(x)).
+uint16_t LSM6DSOMahonyQ30::isqrt(uint32_t x)
+{
+  uint32_t result = 0;
+  uint32_t bit = 1UL << 30;
+
+  while( bit > x )
+    bit >>= 2;
+
+  while( bit != 0 ){
+    if( x >= result + bit ){
+      x -= result + bit;
+      result = (result >> 1) + bit;
+    }
+    else
+      result >>= 1;
+    bit >>= 2;
+  }
+
+  return static_cast<uint16_t>(result);
+}
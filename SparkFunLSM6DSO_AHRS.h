@@ -0,0 +1,158 @@
+/******************************************************************************
+SparkFunLSM6DSO_AHRS.h
+Attitude estimation from LSM6DSO FIFO data
+
+LSM6DSOAhrs runs a Madgwick or Mahony filter over the accelerometer and
+gyroscope and keeps the orientation as a quaternion. updateFifo() takes the
+entries straight from LSM6DSO::fifoRead(): every gyroscope sample is one
+filter step, paired with the most recent accelerometer sample, and the step
+length comes from the sensor's own timestamps rather than the nominal data
+rate. Between steps the quaternion is renormalized with a single Newton step,
+which needs no square root; the exact normalization runs once per batch.
+
+  myIMU.enableTimestamp();
+  ...
+  uint16_t count = myIMU.fifoRead(samples, 64);
+  ahrs.updateFifo(samples, count);
+  ahrs.getEuler(roll, pitch, yaw);
+
+LSM6DSOMahonyQ30 is the same Mahony filter in integer arithmetic for cores
+without an FPU. It takes raw register counts and a step length in
+nanoseconds, and uses no floating point outside the getQuaternion()
+convenience call.
+
+The quaternion rotates the sensor frame into the earth frame; yaw drifts,
+since there is no magnetometer to anchor it.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_AHRS_H__
+#define __LSM6DSO_AHRS_H__
+
+#include "SparkFunLSM6DSO.h"
+
+// Approximate 1/sqrt() with the bit level initial guess and Newton steps
+// instead of calling sqrtf(). Worth it where there is no hardware square
+// root; define it to 0 or 1 to override.
+#ifndef LSM6DSO_AHRS_FAST_INVSQRT
+  #if defined(__AVR__)
+    #define LSM6DSO_AHRS_FAST_INVSQRT 1
+  #else
+    #define LSM6DSO_AHRS_FAST_INVSQRT 0
+  #endif
+#endif
+
+// Defaults from the reference implementations of both filters.
+#define AHRS_MADGWICK_BETA 0.1f
+#define AHRS_MAHONY_KP 0.5f
+#define AHRS_MAHONY_KI 0.0f
+
+// Gaps between gyroscope timestamps longer than this are treated as a
+// restart (FIFO flushed, timestamp reset) and stepped with the nominal
+// sample period instead. Also the longest step LSM6DSOMahonyQ30 takes.
+#define AHRS_MAX_STEP_NS 100000000ULL
+
+// Quaternion (w, x, y, z) to roll, pitch and yaw in degrees, Z-Y-X order.
+void lsm6dsoQuaternionToEuler(float w, float x, float y, float z, float &roll, float &pitch, float &yaw);
+
+typedef enum {
+  AHRS_MADGWICK = 0,
+  AHRS_MAHONY
+} LSM6DSO_AHRS_ALGORITHM_t;
+
+class LSM6DSOAhrs
+{
+  public:
+
+    LSM6DSOAhrs(LSM6DSO_AHRS_ALGORITHM_t algorithm = AHRS_MADGWICK);
+
+    void setAlgorithm(LSM6DSO_AHRS_ALGORITHM_t);
+    void setMadgwickBeta(float);
+    void setMahonyGains(float kp, float ki);
+    // Step length, in seconds, for samples without a usable timestamp.
+    void setSamplePeriod(float);
+
+    // Back to the identity orientation; forgets the last timestamp.
+    void reset();
+
+    // One filter step: angular rate in dps, acceleration in g (any scale,
+    // only the direction is used; all zero skips the correction), dt in
+    // seconds.
+    void update(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+
+    // Runs a batch of fifoRead() entries through the filter. Returns the
+    // number of filter steps taken.
+    uint16_t updateFifo(const fifoData samples[], uint16_t count);
+
+    void getQuaternion(float &w, float &x, float &y, float &z) const;
+    // Roll, pitch and yaw in degrees.
+    void getEuler(float &roll, float &pitch, float &yaw) const;
+
+  private:
+
+    void step(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+    void stepMadgwick(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+    void stepMahony(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+    void normalize();
+    void renormalize();
+
+    static float invSqrt(float);
+
+    LSM6DSO_AHRS_ALGORITHM_t algorithm;
+    float beta;
+    float kp;
+    float ki;
+    float samplePeriod;
+
+    float q0, q1, q2, q3;
+    float integralX, integralY, integralZ;
+
+    // Latest accelerometer sample seen by updateFifo().
+    float accelX, accelY, accelZ;
+    bool accelValid;
+    uint64_t lastGyroNs;
+};
+
+class LSM6DSOMahonyQ30
+{
+  public:
+
+    LSM6DSOMahonyQ30();
+
+    // From LSM6DSO::getGyroMilliScale(), so the gyroscope counts can be
+    // turned into rad/s without floating point.
+    void setGyroMilliScale(uint16_t);
+    // Gains as 16.16 fixed point: 0.5 is 32768.
+    void setGains(int32_t kpQ16, int32_t kiQ16);
+
+    void reset();
+
+    // One filter step from raw register counts (x, y, z). dtNs is clamped
+    // to AHRS_MAX_STEP_NS.
+    void update(const int16_t gyro[3], const int16_t accel[3], uint32_t dtNs);
+
+    // Quaternion w, x, y, z in 2.30 fixed point: 1.0 is 1 << 30.
+    void getQuaternionQ30(int32_t output[4]) const;
+    void getQuaternion(float &w, float &x, float &y, float &z) const;
+
+  private:
+
+    void renormalize();
+
+    static int32_t mulQ30(int32_t, int32_t);
+    static uint16_t isqrt(uint32_t);
+
+    // rad/s per count in 0.32 fixed point.
+    uint32_t gyroScaleQ32;
+    int32_t kpQ16;
+    int32_t kiQ16;
+
+    int32_t q[4];
+    // Integral feedback in rad/s, 8.24 fixed point.
+    int32_t integral[3];
+};
+
+#endif  // End of __LSM6DSO_AHRS_H__ definition check
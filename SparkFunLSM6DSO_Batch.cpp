@@ -0,0 +1,70 @@
+#include "SparkFunLSM6DSO_Batch.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+  #include <immintrin.h>
+#elif defined(__ARM_NEON)
+  #include <arm_neon.h>
+#endif
+
+// Raw counts to floats. The vector paths take unaligned pointers, so any
+// column slice can be converted; the aligned LSM6DSOBatch columns just make
+// the loads cheaper.
+void lsm6dsoRawToFloat(const int16_t *input, float *output, uint16_t count, float scale, float offset)
+{
+  uint16_t i = 0;
+
+#if defined(__AVX2__)
+
+  __m256 vScale = _mm256_set1_ps(scale);
+  __m256 vOffset = _mm256_set1_ps(offset);
+
+  for( ; i + 8 <= count; i += 8 ){
+    __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&input[i]));
+    __m256 value = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(raw));
+    _mm256_storeu_ps(&output[i], _mm256_sub_ps(_mm256_mul_ps(value, vScale), vOffset));
+  }
+
+#elif defined(__SSE2__)
+
+  __m128 vScale = _mm_set1_ps(scale);
+  __m128 vOffset = _mm_set1_ps(offset);
+
+  for( ; i + 8 <= count; i += 8 ){
+    __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&input[i]));
+    // Sign extend by unpacking into the high halves and shifting back down.
+    __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16);
+    __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16);
+    _mm_storeu_ps(&output[i], _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(low), vScale), vOffset));
+    _mm_storeu_ps(&output[i + 4], _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(high), vScale), vOffset));
+  }
+
+#elif defined(__ARM_NEON)
+
+  float32x4_t vScale = vdupq_n_f32(scale);
+  float32x4_t vOffset = vdupq_n_f32(offset);
+
+  for( ; i + 8 <= count; i += 8 ){
+    int16x8_t raw = vld1q_s16(&input[i]);
+    float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(raw)));
+    float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(raw)));
+    vst1q_f32(&output[i], vsubq_f32(vmulq_f32(low, vScale), vOffset));
+    vst1q_f32(&output[i + 4], vsubq_f32(vmulq_f32(high, vScale), vOffset));
+  }
+
+#endif
+
+  for( ; i < count; i++ )
+    output[i] = static_cast<float>(input[i]) * scale - offset;
+}
+
+void lsm6dsoAccelToMilli(const int16_t *input, int32_t *output, uint16_t count, uint32_t milliScale)
+{
+  for( uint16_t i = 0; i < count; i++ )
+    output[i] = lsm6dsoAccelMilli(input[i], milliScale);
+}
+
+void lsm6dsoGyroToMilli(const int16_t *input, int32_t *output, uint16_t count, uint16_t milliScale)
+{
+  for( uint16_t i = 0; i < count; i++ )
+    output[i] = lsm6dsoGyroMilli(input[i], milliScale);
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+SparkFunLSM6DSO_Batch.h
+Structure-of-arrays sample storage for large FIFO drains
+
+LSM6DSOBatch keeps decoded FIFO samples as raw register counts, one aligned
+int16_t column per axis, instead of one fifoData struct of floats per
+sample. Columns are converted to physical units in bulk with
+lsm6dsoRawToFloat(), which uses SSE2/AVX2 on x86 and NEON on Cortex-A.
+Everything else, Cortex-M4/M7 included, runs the scalar loop; those FPUs
+convert one sample per instruction whichever way it is loaded.
+
+  LSM6DSOBatch<1024> batch;
+  batch.append(myIMU, words, numWords);
+  batch.convertAccel(x, y, z, myIMU.getAccelSensitivity());
+  batch.convertGyroMilli(gx, gy, gz, myIMU.getGyroMilliScale());
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_BATCH_H__
+#define __LSM6DSO_BATCH_H__
+
+#include "SparkFunLSM6DSO.h"
+
+// Columns start on this boundary, wide enough for one AVX register.
+#define LSM6DSO_BATCH_ALIGN 32
+
+// output[i] = input[i] * scale - offset, for count samples.
+void lsm6dsoRawToFloat(const int16_t *input, float *output, uint16_t count, float scale, float offset = 0);
+
+// Raw counts to milli-g and milli-dps, integer only, with the multipliers
+// from LSM6DSO::getAccelMilliScale()/getGyroMilliScale(). Each sample gives
+// the same result as calcAccelMilli()/calcGyroMilli().
+void lsm6dsoAccelToMilli(const int16_t *input, int32_t *output, uint16_t count, uint32_t milliScale);
+void lsm6dsoGyroToMilli(const int16_t *input, int32_t *output, uint16_t count, uint16_t milliScale);
+
+template <uint16_t CAPACITY>
+class LSM6DSOBatch
+{
+  public:
+
+    // Column length rounded up so every column stays aligned.
+    static const uint16_t STRIDE = (CAPACITY + 15) & ~15;
+
+    // x, y and z columns of raw counts, in FIFO order.
+    alignas(LSM6DSO_BATCH_ALIGN) int16_t accel[3][STRIDE];
+    alignas(LSM6DSO_BATCH_ALIGN) int16_t gyro[3][STRIDE];
+
+    uint16_t accelCount;
+    uint16_t gyroCount;
+
+    LSM6DSOBatch() { clear(); }
+
+    void clear()
+    {
+      accelCount = 0;
+      gyroCount = 0;
+    }
+
+    uint16_t capacity() const { return CAPACITY; }
+
+    // Decodes raw FIFO words (see LSM6DSO::fifoReadWords()) into the
+    // columns. Stops early once either column might overflow. Returns the
+    // number of words consumed.
+    uint16_t append(LSM6DSO &imu, const uint8_t words[], uint16_t numWords)
+    {
+      int16_t raw[FIFO_MAX_SAMPLES_PER_WORD][3];
+      uint8_t slotsBack[FIFO_MAX_SAMPLES_PER_WORD];
+      uint8_t sensorTag;
+      uint16_t word;
+
+      for( word = 0; word < numWords; word++ ){
+
+        if( accelCount + FIFO_MAX_SAMPLES_PER_WORD > CAPACITY ||
+            gyroCount + FIFO_MAX_SAMPLES_PER_WORD > CAPACITY )
+          break;
+
+        uint8_t count = imu.decodeFifoWordRaw(&words[word * FIFO_WORD_LENGTH], raw, slotsBack, sensorTag);
+
+        for( uint8_t i = 0; i < count; i++ ){
+          if( sensorTag == ACCELEROMETER_DATA ){
+            accel[0][accelCount] = raw[i][0];
+            accel[1][accelCount] = raw[i][1];
+            accel[2][accelCount] = raw[i][2];
+            accelCount++;
+          }
+          else if( sensorTag == GYROSCOPE_DATA ){
+            gyro[0][gyroCount] = raw[i][0];
+            gyro[1][gyroCount] = raw[i][1];
+            gyro[2][gyroCount] = raw[i][2];
+            gyroCount++;
+          }
+        }
+      }
+
+      return word;
+    }
+
+    // Converts the accelerometer columns to g (or, with sensitivity in
+    // other units, to anything linear in the raw counts). offset, if given,
+    // is subtracted per axis after scaling.
+    void convertAccel(float *x, float *y, float *z, float sensitivity, const float *offset = 0) const
+    {
+      convert(accel, accelCount, x, y, z, sensitivity, offset);
+    }
+
+    void convertGyro(float *x, float *y, float *z, float sensitivity, const float *offset = 0) const
+    {
+      convert(gyro, gyroCount, x, y, z, sensitivity, offset);
+    }
+
+    // Integer conversions to milli-g and milli-dps, no floating point.
+    void convertAccelMilli(int32_t *x, int32_t *y, int32_t *z, uint32_t milliScale) const
+    {
+      lsm6dsoAccelToMilli(accel[0], x, accelCount, milliScale);
+      lsm6dsoAccelToMilli(accel[1], y, accelCount, milliScale);
+      lsm6dsoAccelToMilli(accel[2], z, accelCount, milliScale);
+    }
+
+    void convertGyroMilli(int32_t *x, int32_t *y, int32_t *z, uint16_t milliScale) const
+    {
+      lsm6dsoGyroToMilli(gyro[0], x, gyroCount, milliScale);
+      lsm6dsoGyroToMilli(gyro[1], y, gyroCount, milliScale);
+      lsm6dsoGyroToMilli(gyro[2], z, gyroCount, milliScale);
+    }
+
+  private:
+
+    static void convert(const int16_t columns[3][STRIDE], uint16_t count,
+                        float *x, float *y, float *z, float sensitivity, const float *offset)
+    {
+      lsm6dsoRawToFloat(columns[0], x, count, sensitivity, offset ? offset[0] : 0);
+      lsm6dsoRawToFloat(columns[1], y, count, sensitivity, offset ? offset[1] : 0);
+      lsm6dsoRawToFloat(columns[2], z, count, sensitivity, offset ? offset[2] : 0);
+    }
+};
+
+#endif  // End of __LSM6DSO_BATCH_H__ definition check
@@ -0,0 +1,240 @@
+#include "SparkFunLSM6DSO_Calibration.h"
+
+#include <math.h>
+#include <string.h>
+
+// Largest offset the fine USR_OFF_W weight can hold, in g.
+#define CALIBRATION_FINE_RANGE (127.0f / 1024)
+
+void LSM6DSOCalibrator::Accumulator::clear()
+{
+  for( uint8_t i = 0; i < 3; i++ ){
+    reference[i] = 0;
+    sum[i] = 0;
+    sumSquares[i] = 0;
+  }
+  count = 0;
+}
+
+void LSM6DSOCalibrator::Accumulator::add(float x, float y, float z)
+{
+  float value[3] = { x, y, z };
+
+  if( count == 0 )
+    for( uint8_t i = 0; i < 3; i++ )
+      reference[i] = value[i];
+
+  for( uint8_t i = 0; i < 3; i++ ){
+    float delta = value[i] - reference[i];
+    sum[i] += delta;
+    sumSquares[i] += delta * delta;
+  }
+  count++;
+}
+
+float LSM6DSOCalibrator::Accumulator::mean(uint8_t axis) const
+{
+  return reference[axis] + sum[axis] / count;
+}
+
+float LSM6DSOCalibrator::Accumulator::variance(uint8_t axis) const
+{
+  float meanDelta = sum[axis] / count;
+  return sumSquares[axis] / count - meanDelta * meanDelta;
+}
+
+LSM6DSOCalibrator::LSM6DSOCalibrator(LSM6DSO &imu) : imu(imu)
+{
+  reset();
+}
+
+bool LSM6DSOCalibrator::begin()
+{
+  reset();
+  return imu.enableAccelUserOffset(false);
+}
+
+void LSM6DSOCalibrator::reset()
+{
+  for( uint8_t i = 0; i < 3; i++ )
+    gyroBiasSum[i] = 0;
+  gyroCaptures = 0;
+  positions = 0;
+  startCapture();
+}
+
+void LSM6DSOCalibrator::startCapture()
+{
+  accel.clear();
+  gyro.clear();
+}
+
+void LSM6DSOCalibrator::addSamples(const fifoData samples[], uint16_t count)
+{
+  for( uint16_t i = 0; i < count; i++ ){
+    if( samples[i].fifoTag == ACCELEROMETER_DATA )
+      accel.add(samples[i].xAccel, samples[i].yAccel, samples[i].zAccel);
+    else if( samples[i].fifoTag == GYROSCOPE_DATA )
+      gyro.add(samples[i].xGyro, samples[i].yGyro, samples[i].zGyro);
+  }
+}
+
+int8_t LSM6DSOCalibrator::finishCapture()
+{
+  const float gyroLimit = CALIBRATION_STILL_GYRO * CALIBRATION_STILL_GYRO;
+  const float accelLimit = CALIBRATION_STILL_ACCEL * CALIBRATION_STILL_ACCEL;
+
+  if( gyro.count >= CALIBRATION_MIN_SAMPLES ){
+    bool still = true;
+    for( uint8_t i = 0; i < 3; i++ )
+      if( gyro.variance(i) > gyroLimit )
+        still = false;
+
+    if( still ){
+      for( uint8_t i = 0; i < 3; i++ )
+        gyroBiasSum[i] += gyro.mean(i);
+      gyroCaptures++;
+    }
+  }
+
+  if( accel.count < CALIBRATION_MIN_SAMPLES )
+    return CALIBRATION_NO_POSITION;
+
+  int8_t vertical = CALIBRATION_NO_POSITION;
+  for( uint8_t i = 0; i < 3; i++ ){
+    if( accel.variance(i) > accelLimit )
+      return CALIBRATION_NO_POSITION;
+
+    float mean = fabsf(accel.mean(i));
+    if( mean > CALIBRATION_AXIS_ON )
+      vertical = i;
+    else if( mean > CALIBRATION_AXIS_OFF )
+      return CALIBRATION_NO_POSITION;
+  }
+
+  if( vertical == CALIBRATION_NO_POSITION )
+    return CALIBRATION_NO_POSITION;
+
+  float mean = accel.mean(vertical);
+  int8_t position = vertical * 2 + (mean < 0 ? 1 : 0);
+  positionMean[position] = mean;
+  positions |= 1 << position;
+
+  return position;
+}
+
+uint8_t LSM6DSOCalibrator::getPositions() const
+{
+  return positions;
+}
+
+// Per axis, up = scale + offset and down = -scale + offset.
+bool LSM6DSOCalibrator::solve(imuCalibration &output) const
+{
+  output.flags = 0;
+
+  for( uint8_t i = 0; i < 3; i++ ){
+    output.gyroBias[i] = 0;
+    output.accelScale[i] = 1;
+    output.accelOffset[i] = 0;
+  }
+  output.accelOffsetWeight = USER_OFFSET_2_10;
+
+  if( gyroCaptures > 0 ){
+    for( uint8_t i = 0; i < 3; i++ )
+      output.gyroBias[i] = gyroBiasSum[i] / gyroCaptures;
+    output.flags |= CALIBRATION_GYRO_VALID;
+  }
+
+  if( positions == CALIBRATION_ALL_POSITIONS ){
+
+    float offset[3];
+    bool coarse = false;
+    for( uint8_t i = 0; i < 3; i++ ){
+      offset[i] = 0.5f * (positionMean[2 * i] + positionMean[2 * i + 1]);
+      output.accelScale[i] = 0.5f * (positionMean[2 * i] - positionMean[2 * i + 1]);
+      if( fabsf(offset[i]) > CALIBRATION_FINE_RANGE )
+        coarse = true;
+    }
+
+    float steps = coarse ? 64.0f : 1024.0f;
+    output.accelOffsetWeight = coarse ? USER_OFFSET_2_6 : USER_OFFSET_2_10;
+    for( uint8_t i = 0; i < 3; i++ ){
+      float value = floorf(offset[i] * steps + 0.5f);
+      if( value > 127 )
+        value = 127;
+      else if( value < -127 )
+        value = -127;
+      output.accelOffset[i] = static_cast<int8_t>(value);
+    }
+    output.flags |= CALIBRATION_ACCEL_VALID;
+  }
+
+  return output.flags != 0;
+}
+
+bool lsm6dsoApplyCalibration(LSM6DSO &imu, const imuCalibration &calibration)
+{
+  if( !(calibration.flags & CALIBRATION_ACCEL_VALID) )
+    return imu.enableAccelUserOffset(false);
+
+  if( !imu.setAccelUserOffset(calibration.accelOffset, calibration.accelOffsetWeight) )
+    return false;
+
+  return imu.enableAccelUserOffset(true);
+}
+
+void lsm6dsoCorrectSample(const imuCalibration &calibration, fifoData &sample)
+{
+  if( sample.fifoTag == GYROSCOPE_DATA && (calibration.flags & CALIBRATION_GYRO_VALID) ){
+    sample.xGyro -= calibration.gyroBias[0];
+    sample.yGyro -= calibration.gyroBias[1];
+    sample.zGyro -= calibration.gyroBias[2];
+  }
+  else if( sample.fifoTag == ACCELEROMETER_DATA && (calibration.flags & CALIBRATION_ACCEL_VALID) ){
+    sample.xAccel /= calibration.accelScale[0];
+    sample.yAccel /= calibration.accelScale[1];
+    sample.zAccel /= calibration.accelScale[2];
+  }
+}
+
+// Little endian throughout; floats are copied as their IEEE 754 bits, which
+// every supported core shares.
+uint8_t lsm6dsoPackCalibration(const imuCalibration &calibration, uint8_t blob[])
+{
+  lsm6dsoPutUint16(blob, CALIBRATION_MAGIC);
+  blob[2] = CALIBRATION_VERSION;
+  blob[3] = calibration.flags;
+  blob[4] = static_cast<uint8_t>(calibration.accelOffset[0]);
+  blob[5] = static_cast<uint8_t>(calibration.accelOffset[1]);
+  blob[6] = static_cast<uint8_t>(calibration.accelOffset[2]);
+  blob[7] = calibration.accelOffsetWeight;
+  memcpy(&blob[8], calibration.accelScale, 3 * sizeof(float));
+  memcpy(&blob[20], calibration.gyroBias, 3 * sizeof(float));
+
+  lsm6dsoPutUint16(&blob[32], lsm6dsoChecksum(blob, CALIBRATION_BLOB_LENGTH - 2));
+
+  return CALIBRATION_BLOB_LENGTH;
+}
+
+bool lsm6dsoUnpackCalibration(const uint8_t blob[], uint8_t length, imuCalibration &calibration)
+{
+  if( length != CALIBRATION_BLOB_LENGTH )
+    return false;
+  if( lsm6dsoGetUint16(blob) != CALIBRATION_MAGIC )
+    return false;
+  if( blob[2] != CALIBRATION_VERSION )
+    return false;
+  if( lsm6dsoGetUint16(&blob[32]) != lsm6dsoChecksum(blob, CALIBRATION_BLOB_LENGTH - 2) )
+    return false;
+
+  calibration.flags = blob[3];
+  calibration.accelOffset[0] = static_cast<int8_t>(blob[4]);
+  calibration.accelOffset[1] = static_cast<int8_t>(blob[5]);
+  calibration.accelOffset[2] = static_cast<int8_t>(blob[6]);
+  calibration.accelOffsetWeight = blob[7];
+  memcpy(calibration.accelScale, &blob[8], 3 * sizeof(float));
+  memcpy(calibration.gyroBias, &blob[20], 3 * sizeof(float));
+
+  return true;
+}
@@ -0,0 +1,145 @@
+/******************************************************************************
+SparkFunLSM6DSO_Calibration.h
+Gyroscope bias and accelerometer offset/scale calibration
+
+LSM6DSOCalibrator estimates the gyroscope zero rate bias and the
+accelerometer offset and scale from still captures of FIFO data. Hold the
+board still in each of the six positions (each axis pointing up, then down)
+and run one capture per position; every still capture also contributes to
+the gyroscope bias.
+
+  LSM6DSOCalibrator cal(myIMU);
+  cal.begin();
+  for each position:
+    cal.startCapture();
+    ... cal.addSamples(samples, myIMU.fifoRead(samples, 64)); ...
+    cal.finishCapture();
+  imuCalibration result;
+  cal.solve(result);
+  lsm6dsoApplyCalibration(myIMU, result);
+
+The accelerometer offset goes into the X/Y/Z_OFS_USR registers, so the
+sensor removes it from the output registers and the FIFO at no cost to the
+host. The LSM6DSO has no gyroscope or scale equivalent; lsm6dsoCorrectSample()
+applies those two in software.
+
+lsm6dsoPackCalibration() turns a result into a CALIBRATION_BLOB_LENGTH byte,
+checksummed blob for EEPROM or flash, and lsm6dsoUnpackCalibration() checks
+and restores it at the next start.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_CALIBRATION_H__
+#define __LSM6DSO_CALIBRATION_H__
+
+#include "SparkFunLSM6DSO.h"
+
+// Samples per capture below which finishCapture() refuses the capture.
+#define CALIBRATION_MIN_SAMPLES 64
+// Standard deviations above which a capture doesn't count as still.
+#define CALIBRATION_STILL_GYRO 1.0f     // dps
+#define CALIBRATION_STILL_ACCEL 0.02f   // g
+// A position needs one axis beyond this and the others below
+// CALIBRATION_AXIS_OFF.
+#define CALIBRATION_AXIS_ON 0.8f        // g
+#define CALIBRATION_AXIS_OFF 0.3f       // g
+
+#define CALIBRATION_NO_POSITION -1
+#define CALIBRATION_ALL_POSITIONS 0x3F
+
+// imuCalibration::flags
+#define CALIBRATION_GYRO_VALID 0x01
+#define CALIBRATION_ACCEL_VALID 0x02
+
+#define CALIBRATION_MAGIC 0x4C36
+#define CALIBRATION_VERSION 1
+#define CALIBRATION_BLOB_LENGTH 34
+
+struct imuCalibration {
+public:
+  uint8_t flags;
+
+  // User offset register values and their USR_OFF_W weight.
+  int8_t accelOffset[3];
+  uint8_t accelOffsetWeight;
+
+  // Measured g per true g, to divide out after the offset.
+  float accelScale[3];
+
+  // dps
+  float gyroBias[3];
+};
+
+class LSM6DSOCalibrator
+{
+  public:
+
+    LSM6DSOCalibrator(LSM6DSO &);
+
+    // Turns the hardware user offset off, so captures see the uncorrected
+    // output, and forgets all earlier captures.
+    bool begin();
+
+    void startCapture();
+    void addSamples(const fifoData samples[], uint16_t count);
+    // Ends the capture. Returns the position it filled, axis * 2 for +1g and
+    // axis * 2 + 1 for -1g, or CALIBRATION_NO_POSITION if the board wasn't
+    // still or no axis was vertical.
+    int8_t finishCapture();
+
+    // Bit per position filled, CALIBRATION_ALL_POSITIONS when done.
+    uint8_t getPositions() const;
+
+    // Fills output from what has been captured so far; the flags say which
+    // parts are valid. Returns false if neither is.
+    bool solve(imuCalibration &output) const;
+
+  private:
+
+    // Running sums relative to the first sample, for variance without
+    // losing precision in float.
+    struct Accumulator {
+      float reference[3];
+      float sum[3];
+      float sumSquares[3];
+      uint16_t count;
+
+      void clear();
+      void add(float x, float y, float z);
+      float mean(uint8_t axis) const;
+      float variance(uint8_t axis) const;
+    };
+
+    // Forgets all captures; shared by the constructor and begin().
+    void reset();
+
+    LSM6DSO &imu;
+
+    Accumulator accel;
+    Accumulator gyro;
+
+    float gyroBiasSum[3];
+    uint8_t gyroCaptures;
+
+    // Mean reading of each axis when pointing up and down, in g.
+    float positionMean[6];
+    uint8_t positions;
+};
+
+// Loads the accelerometer offset into the sensor and enables it, or disables
+// it when the calibration has no valid accelerometer part.
+bool lsm6dsoApplyCalibration(LSM6DSO &imu, const imuCalibration &calibration);
+
+// Removes the gyroscope bias and accelerometer scale from a fifoRead()
+// entry; the offset is already gone if the calibration was applied.
+void lsm6dsoCorrectSample(const imuCalibration &calibration, fifoData &sample);
+
+// Returns CALIBRATION_BLOB_LENGTH.
+uint8_t lsm6dsoPackCalibration(const imuCalibration &calibration, uint8_t blob[]);
+// Returns false on a wrong length, magic, version or checksum.
+bool lsm6dsoUnpackCalibration(const uint8_t blob[], uint8_t length, imuCalibration &calibration);
+
+#endif  // End of __LSM6DSO_CALIBRATION_H__ definition check
@@ -0,0 +1,305 @@
+#include "SparkFunLSM6DSO_EKF.h"
+
+#include <math.h>
+
+#define EKF_DEG_TO_RAD 0.0174532925f
+#define EKF_RAD_TO_DEG 57.2957795f
+
+LSM6DSOEkf::LSM6DSOEkf() :
+  gyroNoise(EKF_GYRO_NOISE),
+  gyroBiasWalk(EKF_GYRO_BIAS_WALK),
+  accelNoise(EKF_ACCEL_NOISE),
+  accelGate(EKF_ACCEL_GATE),
+  samplePeriod(1.0f / 104)
+{
+  reset();
+}
+
+void LSM6DSOEkf::setNoise(float newGyroNoise, float newGyroBiasWalk, float newAccelNoise)
+{
+  gyroNoise = newGyroNoise;
+  gyroBiasWalk = newGyroBiasWalk;
+  accelNoise = newAccelNoise;
+}
+
+void LSM6DSOEkf::setAccelGate(float gate)
+{
+  accelGate = gate;
+}
+
+void LSM6DSOEkf::setSamplePeriod(float seconds)
+{
+  samplePeriod = seconds;
+}
+
+void LSM6DSOEkf::reset()
+{
+  q0 = 1;
+  q1 = 0;
+  q2 = 0;
+  q3 = 0;
+
+  bias[0] = 0;
+  bias[1] = 0;
+  bias[2] = 0;
+
+  covariance.zero();
+  for( uint8_t i = 0; i < 3; i++ ){
+    covariance(i, i) = EKF_INITIAL_ANGLE_VARIANCE;
+    covariance(i + 3, i + 3) = EKF_INITIAL_BIAS_VARIANCE;
+  }
+
+  levelled = false;
+  lastGyroNs = 0;
+}
+
+// Error state dynamics over dt, with w the bias corrected rate:
+//   angle' = (I - [w x] dt) angle - dt bias
+//   bias'  = bias
+void LSM6DSOEkf::predict(float gx, float gy, float gz, float dt)
+{
+  float wx = gx * EKF_DEG_TO_RAD - bias[0];
+  float wy = gy * EKF_DEG_TO_RAD - bias[1];
+  float wz = gz * EKF_DEG_TO_RAD - bias[2];
+
+  float hx = 0.5f * wx * dt;
+  float hy = 0.5f * wy * dt;
+  float hz = 0.5f * wz * dt;
+
+  float qa = q0;
+  float qb = q1;
+  float qc = q2;
+  q0 += -qb * hx - qc * hy - q3 * hz;
+  q1 += qa * hx + qc * hz - q3 * hy;
+  q2 += qa * hy - qb * hz + q3 * hx;
+  q3 += qa * hz + qb * hy - qc * hx;
+
+  // One Newton step is enough for the norm drift of a single step.
+  float scale = 1.5f - 0.5f * (q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+  q0 *= scale;
+  q1 *= scale;
+  q2 *= scale;
+  q3 *= scale;
+
+  LSM6DSOMatrix<EKF_STATES, EKF_STATES> transition;
+  transition.zero();
+  transition.m[0][0] = 1;
+  transition.m[0][1] = wz * dt;
+  transition.m[0][2] = -wy * dt;
+  transition.m[1][0] = -wz * dt;
+  transition.m[1][1] = 1;
+  transition.m[1][2] = wx * dt;
+  transition.m[2][0] = wy * dt;
+  transition.m[2][1] = -wx * dt;
+  transition.m[2][2] = 1;
+  for( uint8_t i = 0; i < 3; i++ ){
+    transition.m[i][i + 3] = -dt;
+    transition.m[i + 3][i + 3] = 1;
+  }
+
+  LSM6DSOSymMatrix<EKF_STATES> predicted;
+  lsm6dsoCongruence(transition, covariance, predicted);
+
+  float angleNoise = gyroNoise * gyroNoise * dt;
+  float biasNoise = gyroBiasWalk * gyroBiasWalk * dt;
+  for( uint8_t i = 0; i < 3; i++ ){
+    predicted(i, i) += angleNoise;
+    predicted(i + 3, i + 3) += biasNoise;
+  }
+
+  covariance = predicted;
+}
+
+// The measurement is the gravity direction in the body frame. For a small
+// body frame rotation e it changes by [h x] e, h being the current estimate,
+// so only the three angle columns of H are non zero.
+bool LSM6DSOEkf::correct(float ax, float ay, float az)
+{
+  float norm = sqrtf(ax * ax + ay * ay + az * az);
+  if( fabsf(norm - 1.0f) > accelGate )
+    return false;
+
+  if( !levelled ){
+    level(ax, ay, az);
+    return true;
+  }
+
+  float measured[3] = { ax / norm, ay / norm, az / norm };
+  float h[3];
+  h[0] = 2.0f * (q1 * q3 - q0 * q2);
+  h[1] = 2.0f * (q2 * q3 + q0 * q1);
+  h[2] = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+
+  LSM6DSOMatrix<3, EKF_STATES> jacobian;
+  jacobian.zero();
+  jacobian.m[0][1] = -h[2];
+  jacobian.m[0][2] = h[1];
+  jacobian.m[1][0] = h[2];
+  jacobian.m[1][2] = -h[0];
+  jacobian.m[2][0] = -h[1];
+  jacobian.m[2][1] = h[0];
+
+  LSM6DSOSymMatrix<3> innovation;
+  lsm6dsoCongruence(jacobian, covariance, innovation);
+  float measurementNoise = accelNoise * accelNoise;
+  for( uint8_t i = 0; i < 3; i++ )
+    innovation(i, i) += measurementNoise;
+
+  // Inverse of the 3 x 3 innovation covariance by cofactors.
+  float c00 = innovation(1, 1) * innovation(2, 2) - innovation(1, 2) * innovation(1, 2);
+  float c01 = innovation(0, 2) * innovation(1, 2) - innovation(0, 1) * innovation(2, 2);
+  float c02 = innovation(0, 1) * innovation(1, 2) - innovation(0, 2) * innovation(1, 1);
+  float determinant = innovation(0, 0) * c00 + innovation(0, 1) * c01 + innovation(0, 2) * c02;
+  if( !(determinant > 0) )
+    return false;
+
+  float recipDeterminant = 1.0f / determinant;
+  LSM6DSOMatrix<3, 3> inverse;
+  inverse.m[0][0] = c00 * recipDeterminant;
+  inverse.m[0][1] = c01 * recipDeterminant;
+  inverse.m[0][2] = c02 * recipDeterminant;
+  inverse.m[1][1] = (innovation(0, 0) * innovation(2, 2) - innovation(0, 2) * innovation(0, 2)) * recipDeterminant;
+  inverse.m[1][2] = (innovation(0, 1) * innovation(0, 2) - innovation(0, 0) * innovation(1, 2)) * recipDeterminant;
+  inverse.m[2][2] = (innovation(0, 0) * innovation(1, 1) - innovation(0, 1) * innovation(0, 1)) * recipDeterminant;
+  inverse.m[1][0] = inverse.m[0][1];
+  inverse.m[2][0] = inverse.m[0][2];
+  inverse.m[2][1] = inverse.m[1][2];
+
+  // P H^T, then the gain K = P H^T S^-1.
+  LSM6DSOMatrix<EKF_STATES, EKF_STATES> full;
+  LSM6DSOMatrix<3, EKF_STATES> hp;
+  covariance.toMatrix(full);
+  lsm6dsoMultiply(jacobian, full, hp);
+
+  LSM6DSOMatrix<EKF_STATES, 3> pht;
+  for( uint8_t r = 0; r < EKF_STATES; r++ )
+    for( uint8_t c = 0; c < 3; c++ )
+      pht.m[r][c] = hp.m[c][r];
+
+  LSM6DSOMatrix<EKF_STATES, 3> gain;
+  lsm6dsoMultiply(pht, inverse, gain);
+
+  float residual[3];
+  for( uint8_t i = 0; i < 3; i++ )
+    residual[i] = measured[i] - h[i];
+
+  float correction[EKF_STATES];
+  for( uint8_t r = 0; r < EKF_STATES; r++ )
+    correction[r] = gain.m[r][0] * residual[0] + gain.m[r][1] * residual[1] + gain.m[r][2] * residual[2];
+
+  // P -= K S K^T, written as K (P H^T)^T so it stays exactly symmetric.
+  for( uint8_t r = 0; r < EKF_STATES; r++ )
+    for( uint8_t c = 0; c <= r; c++ )
+      covariance(r, c) -= gain.m[r][0] * pht.m[c][0] + gain.m[r][1] * pht.m[c][1] + gain.m[r][2] * pht.m[c][2];
+
+  float hx = 0.5f * correction[0];
+  float hy = 0.5f * correction[1];
+  float hz = 0.5f * correction[2];
+
+  float qa = q0;
+  float qb = q1;
+  float qc = q2;
+  q0 += -qb * hx - qc * hy - q3 * hz;
+  q1 += qa * hx + qc * hz - q3 * hy;
+  q2 += qa * hy - qb * hz + q3 * hx;
+  q3 += qa * hz + qb * hy - qc * hx;
+  normalize();
+
+  bias[0] += correction[3];
+  bias[1] += correction[4];
+  bias[2] += correction[5];
+
+  return true;
+}
+
+void LSM6DSOEkf::update(float gx, float gy, float gz, float ax, float ay, float az, float dt)
+{
+  predict(gx, gy, gz, dt);
+  correct(ax, ay, az);
+}
+
+uint16_t LSM6DSOEkf::updateFifo(const fifoData samples[], uint16_t count)
+{
+  uint16_t steps = 0;
+
+  for( uint16_t i = 0; i < count; i++ ){
+
+    const fifoData &sample = samples[i];
+
+    if( sample.fifoTag == ACCELEROMETER_DATA ){
+      correct(sample.xAccel, sample.yAccel, sample.zAccel);
+      continue;
+    }
+
+    if( sample.fifoTag != GYROSCOPE_DATA )
+      continue;
+
+    float dt = samplePeriod;
+    if( sample.timestampNs != 0 ){
+      if( lastGyroNs != 0 && sample.timestampNs > lastGyroNs &&
+          sample.timestampNs - lastGyroNs < AHRS_MAX_STEP_NS )
+        dt = static_cast<float>(sample.timestampNs - lastGyroNs) * 1e-9f;
+      lastGyroNs = sample.timestampNs;
+    }
+
+    predict(sample.xGyro, sample.yGyro, sample.zGyro, dt);
+    steps++;
+  }
+
+  return steps;
+}
+
+void LSM6DSOEkf::getQuaternion(float &w, float &x, float &y, float &z) const
+{
+  w = q0;
+  x = q1;
+  y = q2;
+  z = q3;
+}
+
+void LSM6DSOEkf::getEuler(float &roll, float &pitch, float &yaw) const
+{
+  lsm6dsoQuaternionToEuler(q0, q1, q2, q3, roll, pitch, yaw);
+}
+
+void LSM6DSOEkf::getGyroBias(float &x, float &y, float &z) const
+{
+  x = bias[0] * EKF_RAD_TO_DEG;
+  y = bias[1] * EKF_RAD_TO_DEG;
+  z = bias[2] * EKF_RAD_TO_DEG;
+}
+
+void LSM6DSOEkf::getAttitudeSigma(float &x, float &y, float &z) const
+{
+  x = sqrtf(covariance(0, 0)) * EKF_RAD_TO_DEG;
+  y = sqrtf(covariance(1, 1)) * EKF_RAD_TO_DEG;
+  z = sqrtf(covariance(2, 2)) * EKF_RAD_TO_DEG;
+}
+
+// Roll and pitch straight from gravity, yaw zero.
+void LSM6DSOEkf::level(float ax, float ay, float az)
+{
+  float roll = atan2f(ay, az);
+  float pitch = atan2f(-ax, sqrtf(ay * ay + az * az));
+
+  float cr = cosf(0.5f * roll);
+  float sr = sinf(0.5f * roll);
+  float cp = cosf(0.5f * pitch);
+  float sp = sinf(0.5f * pitch);
+
+  q0 = cr * cp;
+  q1 = sr * cp;
+  q2 = cr * sp;
+  q3 = -sr * sp;
+
+  levelled = true;
+}
+
+void LSM6DSOEkf::normalize()
+{
+  float recipNorm = 1.0f / sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+  q0 *= recipNorm;
+  q1 *= recipNorm;
+  q2 *= recipNorm;
+  q3 *= recipNorm;
+}
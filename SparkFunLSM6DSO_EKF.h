@@ -0,0 +1,208 @@
+/******************************************************************************
+SparkFunLSM6DSO_EKF.h
+Attitude and gyroscope bias Kalman filter
+
+LSM6DSOEkf is a multiplicative extended Kalman filter: the attitude is kept
+as a quaternion, and the filter itself estimates a six element error state,
+three small rotation angles and the three gyroscope biases. The gyroscope
+drives the prediction; every accelerometer sample close enough to 1g is a
+measurement of the gravity direction. Yaw is not observable without a
+magnetometer, so its uncertainty simply grows.
+
+All storage is fixed size. The matrices are the LSM6DSOMatrix and
+LSM6DSOSymMatrix templates below, with dimensions known at compile time so
+the loops unroll, and the covariance keeps only its lower triangle (21
+floats instead of 36).
+
+  LSM6DSOEkf ekf;
+  uint16_t count = myIMU.fifoRead(samples, 64);
+  ekf.updateFifo(samples, count);
+  ekf.getQuaternion(w, x, y, z);
+  ekf.getGyroBias(bx, by, bz);
+
+A predict plus update step is roughly 1000 floating point operations, well
+inside the 1660Hz gyroscope rate on a Cortex-M4F. lsm6dso_bench in
+extras/host reports the cost per step on the build machine; on the target,
+count DWT->CYCCNT around update() the same way.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_EKF_H__
+#define __LSM6DSO_EKF_H__
+
+#include "SparkFunLSM6DSO_AHRS.h"
+
+// Ask the compiler to fully unroll the fixed size loops below, which -Os
+// (the Arduino default) otherwise leaves as loops.
+#if defined(__clang__)
+  #define LSM6DSO_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__) && __GNUC__ >= 8
+  #define LSM6DSO_UNROLL _Pragma("GCC unroll 8")
+#else
+  #define LSM6DSO_UNROLL
+#endif
+
+// Noise defaults. Gyroscope noise is generous compared to the 3.8mdps/rtHz
+// of the datasheet to absorb integration and timing error; the bias walk
+// lets the bias estimate follow temperature drift.
+#define EKF_GYRO_NOISE 0.001f           // rad/s/rtHz
+#define EKF_GYRO_BIAS_WALK 0.00005f     // rad/s^2/rtHz
+#define EKF_ACCEL_NOISE 0.02f           // unit gravity direction, per axis
+// Accelerometer samples further than this from 1g are linear acceleration
+// as much as gravity and are skipped.
+#define EKF_ACCEL_GATE 0.1f             // g
+#define EKF_INITIAL_ANGLE_VARIANCE 0.1f // rad^2
+#define EKF_INITIAL_BIAS_VARIANCE 0.0003f // (rad/s)^2, about 1dps sigma
+
+template <uint8_t ROWS, uint8_t COLS>
+struct LSM6DSOMatrix {
+  float m[ROWS][COLS];
+
+  void zero()
+  {
+    LSM6DSO_UNROLL
+    for( uint8_t r = 0; r < ROWS; r++ ){
+      LSM6DSO_UNROLL
+      for( uint8_t c = 0; c < COLS; c++ )
+        m[r][c] = 0;
+    }
+  }
+};
+
+// output = a * b
+template <uint8_t ROWS, uint8_t INNER, uint8_t COLS>
+inline void lsm6dsoMultiply(const LSM6DSOMatrix<ROWS, INNER> &a, const LSM6DSOMatrix<INNER, COLS> &b,
+                            LSM6DSOMatrix<ROWS, COLS> &output)
+{
+  LSM6DSO_UNROLL
+  for( uint8_t r = 0; r < ROWS; r++ ){
+    LSM6DSO_UNROLL
+    for( uint8_t c = 0; c < COLS; c++ ){
+      float sum = 0;
+      LSM6DSO_UNROLL
+      for( uint8_t k = 0; k < INNER; k++ )
+        sum += a.m[r][k] * b.m[k][c];
+      output.m[r][c] = sum;
+    }
+  }
+}
+
+// Symmetric N x N matrix, lower triangle packed row by row.
+template <uint8_t N>
+struct LSM6DSOSymMatrix {
+  static const uint8_t SIZE = N * (N + 1) / 2;
+
+  float v[SIZE];
+
+  static uint8_t index(uint8_t r, uint8_t c)
+  {
+    return r >= c ? r * (r + 1) / 2 + c : c * (c + 1) / 2 + r;
+  }
+
+  float operator()(uint8_t r, uint8_t c) const { return v[index(r, c)]; }
+  float &operator()(uint8_t r, uint8_t c) { return v[index(r, c)]; }
+
+  void zero()
+  {
+    LSM6DSO_UNROLL
+    for( uint8_t i = 0; i < SIZE; i++ )
+      v[i] = 0;
+  }
+
+  void toMatrix(LSM6DSOMatrix<N, N> &output) const
+  {
+    LSM6DSO_UNROLL
+    for( uint8_t r = 0; r < N; r++ ){
+      LSM6DSO_UNROLL
+      for( uint8_t c = 0; c < N; c++ )
+        output.m[r][c] = (*this)(r, c);
+    }
+  }
+};
+
+// output = a * s * a^T, lower triangle only.
+template <uint8_t ROWS, uint8_t N>
+inline void lsm6dsoCongruence(const LSM6DSOMatrix<ROWS, N> &a, const LSM6DSOSymMatrix<N> &s,
+                              LSM6DSOSymMatrix<ROWS> &output)
+{
+  LSM6DSOMatrix<N, N> full;
+  LSM6DSOMatrix<ROWS, N> as;
+  s.toMatrix(full);
+  lsm6dsoMultiply(a, full, as);
+
+  LSM6DSO_UNROLL
+  for( uint8_t r = 0; r < ROWS; r++ ){
+    LSM6DSO_UNROLL
+    for( uint8_t c = 0; c <= r; c++ ){
+      float sum = 0;
+      LSM6DSO_UNROLL
+      for( uint8_t k = 0; k < N; k++ )
+        sum += as.m[r][k] * a.m[c][k];
+      output(r, c) = sum;
+    }
+  }
+}
+
+#define EKF_STATES 6
+
+class LSM6DSOEkf
+{
+  public:
+
+    LSM6DSOEkf();
+
+    // Noise densities, see the EKF_* defaults.
+    void setNoise(float gyroNoise, float gyroBiasWalk, float accelNoise);
+    void setAccelGate(float);
+    // Step length, in seconds, for samples without a usable timestamp.
+    void setSamplePeriod(float);
+
+    // Forgets attitude, bias and covariance. The next accelerometer sample
+    // levels the attitude before the filter starts.
+    void reset();
+
+    // Propagates the attitude over dt seconds at the given rates (dps).
+    void predict(float gx, float gy, float gz, float dt);
+    // Corrects with an accelerometer sample (g). Returns false when it was
+    // outside the gate and skipped.
+    bool correct(float ax, float ay, float az);
+    // predict() then correct().
+    void update(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+
+    // Same pairing and timing as LSM6DSOAhrs::updateFifo(): one prediction
+    // per gyroscope entry, one correction per accelerometer entry. Returns
+    // the number of predictions.
+    uint16_t updateFifo(const fifoData samples[], uint16_t count);
+
+    void getQuaternion(float &w, float &x, float &y, float &z) const;
+    void getEuler(float &roll, float &pitch, float &yaw) const;
+    // Estimated gyroscope bias in dps, already removed from the prediction.
+    void getGyroBias(float &x, float &y, float &z) const;
+    // One sigma attitude uncertainty about each body axis, in degrees.
+    void getAttitudeSigma(float &x, float &y, float &z) const;
+
+  private:
+
+    void level(float ax, float ay, float az);
+    void normalize();
+
+    float gyroNoise;
+    float gyroBiasWalk;
+    float accelNoise;
+    float accelGate;
+    float samplePeriod;
+
+    // Body to earth rotation.
+    float q0, q1, q2, q3;
+    // rad/s
+    float bias[3];
+    LSM6DSOSymMatrix<EKF_STATES> covariance;
+
+    bool levelled;
+    uint64_t lastGyroNs;
+};
+
+#endif  // End of __LSM6DSO_EKF_H__ definition check
@@ -0,0 +1,161 @@
+#include "SparkFunLSM6DSO_FSM.h"
+
+// Single register accesses only: the loader holds the bank with IF_INC
+// cleared, where a longer burst would keep rewriting the first register.
+static bool writeEmbeddedRegister(LSM6DSO &imu, uint8_t address, uint8_t value)
+{
+  return imu.writeEmbedded(&value, address, 1) == IMU_SUCCESS;
+}
+
+static bool updateEmbeddedRegister(LSM6DSO &imu, uint8_t address, uint8_t keepMask, uint8_t bits)
+{
+  uint8_t regVal;
+  if( imu.readEmbedded(&regVal, address, 1) != IMU_SUCCESS )
+    return false;
+
+  return writeEmbeddedRegister(imu, address, (regVal & keepMask) | bits);
+}
+
+uint8_t lsm6dsoCheckFsmImage(const uint8_t image[], uint16_t length)
+{
+  if( length < FSM_IMAGE_HEADER_LENGTH )
+    return 0;
+
+  uint8_t programs = pgm_read_byte(&image[0]);
+  if( programs == 0 || programs > FSM_MAX_PROGRAMS )
+    return 0;
+  if( pgm_read_byte(&image[1]) > FSM_ODR_104Hz )
+    return 0;
+
+  uint16_t offset = FSM_IMAGE_HEADER_LENGTH;
+  for( uint8_t i = 0; i < programs; i++ ){
+    if( length - offset < FSM_PROGRAM_HEADER_LENGTH )
+      return 0;
+
+    uint8_t size = pgm_read_byte(&image[offset + FSM_PROGRAM_SIZE_OFFSET]);
+    if( size < FSM_PROGRAM_HEADER_LENGTH || size > length - offset )
+      return 0;
+
+    offset += size;
+  }
+
+  return offset == length ? programs : 0;
+}
+
+// Follows the application note's sequence, with the machines stopped while
+// their memory is rewritten and FSM_INIT set so they start from their reset
+// pointers.
+bool lsm6dsoLoadFsm(LSM6DSO &imu, const uint8_t image[], uint16_t length)
+{
+  uint8_t programs = lsm6dsoCheckFsmImage(image, length);
+  if( programs == 0 )
+    return false;
+
+  uint16_t programBytes = length - FSM_IMAGE_HEADER_LENGTH;
+  uint16_t enableMask = programs == FSM_MAX_PROGRAMS ? 0xFFFF : (static_cast<uint16_t>(1) << programs) - 1;
+
+  LSM6DSOEmbeddedBank bank(imu, true);
+  if( bank.getStatus() != IMU_SUCCESS )
+    return false;
+
+  uint8_t functions;
+  if( imu.readEmbedded(&functions, EMB_FUNC_EN_B, 1) != IMU_SUCCESS )
+    return false;
+
+  bool success = writeEmbeddedRegister(imu, EMB_FUNC_EN_B, functions & ~FSM_EN);
+  success = success && writeEmbeddedRegister(imu, FSM_ENABLE_A, 0x00);
+  success = success && writeEmbeddedRegister(imu, FSM_ENABLE_B, 0x00);
+  success = success && updateEmbeddedRegister(imu, EMB_FUNC_ODR_CFG_B, FSM_ODR_MASK,
+                                              FSM_ODR_RESERVED | (pgm_read_byte(&image[1]) << FSM_ODR_SHIFT));
+  if( !success )
+    return false;
+
+  uint8_t settings[3] = { pgm_read_byte(&image[2]), pgm_read_byte(&image[3]), programs };
+  uint8_t start[2] = { FSM_START_ADDRESS & 0xFF, FSM_START_ADDRESS >> 8 };
+  if( imu.writePage(settings, FSM_LC_TIMEOUT_L, 3) != IMU_SUCCESS ||
+      imu.writePage(start, FSM_START_ADD_L, 2) != IMU_SUCCESS )
+    return false;
+
+  uint8_t chunk[LSM6DSO_FSM_CHUNK];
+  for( uint16_t written = 0; written < programBytes; ){
+
+    uint16_t count = programBytes - written;
+    if( count > LSM6DSO_FSM_CHUNK )
+      count = LSM6DSO_FSM_CHUNK;
+
+    for( uint16_t i = 0; i < count; i++ )
+      chunk[i] = pgm_read_byte(&image[FSM_IMAGE_HEADER_LENGTH + written + i]);
+
+    if( imu.writePage(chunk, FSM_START_ADDRESS + written, count) != IMU_SUCCESS )
+      return false;
+
+    written += count;
+  }
+
+  success = writeEmbeddedRegister(imu, FSM_ENABLE_A, enableMask & 0xFF);
+  success = success && writeEmbeddedRegister(imu, FSM_ENABLE_B, enableMask >> 8);
+  success = success && updateEmbeddedRegister(imu, EMB_FUNC_INIT_B, ~FSM_INIT, FSM_INIT);
+  success = success && writeEmbeddedRegister(imu, EMB_FUNC_EN_B, functions | FSM_EN);
+
+  return success;
+}
+
+bool lsm6dsoDisableFsm(LSM6DSO &imu)
+{
+  LSM6DSOEmbeddedBank bank(imu);
+  if( bank.getStatus() != IMU_SUCCESS )
+    return false;
+
+  uint8_t enables[2] = { 0x00, 0x00 };
+  if( imu.writeEmbedded(enables, FSM_ENABLE_A, 2) != IMU_SUCCESS )
+    return false;
+
+  return updateEmbeddedRegister(imu, EMB_FUNC_EN_B, ~FSM_EN, 0x00);
+}
+
+// Address: embedded 0x0B - 0x0C or 0x0F - 0x10, main 0x5E or 0x5F, bit[1]
+// The MD1_CFG/MD2_CFG embedded function bit is shared with the pedometer
+// and tilt events, so a zero mask leaves it alone.
+bool lsm6dsoRouteFsmInterrupt(LSM6DSO &imu, uint16_t programMask, uint8_t pin)
+{
+  if( pin != 1 && pin != 2 )
+    return false;
+
+  uint8_t routes[2] = { static_cast<uint8_t>(programMask & 0xFF), static_cast<uint8_t>(programMask >> 8) };
+  if( imu.writeEmbedded(routes, pin == 1 ? FSM_INT1_A : FSM_INT2_A, 2) != IMU_SUCCESS )
+    return false;
+
+  if( programMask == 0 )
+    return true;
+
+  uint8_t address = pin == 1 ? MD1_CFG : MD2_CFG;
+  uint8_t regVal;
+  if( imu.readRegister(&regVal, address) != IMU_SUCCESS )
+    return false;
+
+  // Bit 1 in MD1_CFG and MD2_CFG alike.
+  regVal |= INT1_EMB_FUNC_ENABLED;
+  return imu.writeRegister(address, regVal) == IMU_SUCCESS;
+}
+
+// Address: main 0x35 - 0x37, embedded 0x48 - 0x5B
+// FSM_LONG_COUNTER_CLEAR and a reserved byte sit between the long counter
+// and FSM_OUTS1; reading them over is cheaper than a second transfer.
+bool lsm6dsoReadFsmOutputs(LSM6DSO &imu, fsmOutputs &outputs)
+{
+  uint8_t status[3];
+  if( imu.readMultipleRegisters(status, EMB_FUNC_STATUS_MP, 3) != IMU_SUCCESS )
+    return false;
+
+  uint8_t buffer[4 + FSM_MAX_PROGRAMS];
+  if( imu.readEmbedded(buffer, FSM_LONG_COUNTER_L, sizeof(buffer)) != IMU_SUCCESS )
+    return false;
+
+  outputs.embeddedStatus = status[0];
+  outputs.status = status[1] | (static_cast<uint16_t>(status[2]) << 8);
+  outputs.longCounter = buffer[0] | (static_cast<uint16_t>(buffer[1]) << 8);
+  for( uint8_t i = 0; i < FSM_MAX_PROGRAMS; i++ )
+    outputs.outs[i] = buffer[4 + i];
+
+  return true;
+}
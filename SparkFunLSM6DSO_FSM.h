@@ -0,0 +1,116 @@
+/******************************************************************************
+SparkFunLSM6DSO_FSM.h
+Finite state machine program loading and output reading
+
+The LSM6DSO runs up to 16 finite state machine programs on its own
+accelerometer and gyroscope data, so gesture and motion detection needs no
+host processing. lsm6dsoLoadFsm() uploads a compact image of programs from
+program memory into the advanced feature pages and starts them;
+lsm6dsoRouteFsmInterrupt() puts their events on INT1 or INT2 so the host
+can sleep until one fires, and lsm6dsoReadFsmOutputs() then fetches every
+status and output register in two bursts.
+
+An image is FSM_IMAGE_HEADER_LENGTH bytes followed by the programs back to
+back, each exactly as the FSM tools emit it:
+
+  [0]     number of programs, 1 to FSM_MAX_PROGRAMS
+  [1]     FSM ODR, LSM6DSO_FSM_ODR_t
+  [2..3]  long counter timeout, little endian, 0 if unused
+  [4..]   programs; byte 2 of each is its size in bytes
+
+  const uint8_t gestures[] PROGMEM = { 2, FSM_ODR_26Hz, 0, 0, ... };
+  lsm6dsoLoadFsm(myIMU, gestures, sizeof(gestures));
+  lsm6dsoRouteFsmInterrupt(myIMU, 0x0003, 1);
+  ... on INT1:
+  fsmOutputs outputs;
+  lsm6dsoReadFsmOutputs(myIMU, outputs);
+
+The accelerometer and gyroscope data rates must be at least the FSM ODR.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_FSM_H__
+#define __LSM6DSO_FSM_H__
+
+#include "SparkFunLSM6DSO.h"
+
+#define FSM_MAX_PROGRAMS 16
+#define FSM_IMAGE_HEADER_LENGTH 4
+// Each program starts with CONFIG_A, CONFIG_B, SIZE, SETTINGS, RP and PP.
+#define FSM_PROGRAM_HEADER_LENGTH 6
+#define FSM_PROGRAM_SIZE_OFFSET 2
+
+// Advanced feature page addresses, page in the high byte.
+#define FSM_LC_TIMEOUT_L 0x017A
+#define FSM_PROGRAMS 0x017C
+#define FSM_START_ADD_L 0x017E
+// Where the programs go; the usual value from the application note.
+#define FSM_START_ADDRESS 0x0400
+
+// Image bytes copied out of program memory per page write.
+#ifndef LSM6DSO_FSM_CHUNK
+  #if defined(__AVR__)
+    #define LSM6DSO_FSM_CHUNK 16
+  #else
+    #define LSM6DSO_FSM_CHUNK 64
+  #endif
+#endif
+
+/*******************************************************************************
+* Register      : EMB_FUNC_ODR_CFG_B (embedded bank)
+* Address       : 0x5F
+* Bit Group Name: FSM_ODR
+* Permission    : RW
+*******************************************************************************/
+typedef enum {
+	FSM_ODR_12_5Hz = 0x00,
+	FSM_ODR_26Hz   = 0x01,
+	FSM_ODR_52Hz   = 0x02,
+	FSM_ODR_104Hz  = 0x03,
+} LSM6DSO_FSM_ODR_t;
+
+#define FSM_ODR_SHIFT 3
+#define FSM_ODR_MASK 0xC7
+// Bits 0, 1 and 6 of EMB_FUNC_ODR_CFG_B must be written as 1.
+#define FSM_ODR_RESERVED 0x43
+
+// EMB_FUNC_EN_B, EMB_FUNC_INIT_B
+#define FSM_EN 0x01
+#define FSM_INIT 0x01
+
+struct fsmOutputs {
+public:
+  // One bit per program that has signalled, program 1 in bit 0, from
+  // FSM_FUNC_STATUS_A_MP and FSM_FUNC_STATUS_B_MP.
+  uint16_t status;
+  // EMB_FUNC_STATUS_MP, including the long counter flag.
+  uint8_t embeddedStatus;
+
+  uint16_t longCounter;
+  // FSM_OUTS1 to FSM_OUTS16.
+  uint8_t outs[FSM_MAX_PROGRAMS];
+};
+
+// Checks an image in program memory and returns the number of programs, or
+// 0 if the header or the program sizes don't add up to length.
+uint8_t lsm6dsoCheckFsmImage(const uint8_t image[], uint16_t length);
+
+// Stops the state machines, uploads the image and starts its programs from
+// their reset state. The embedded bank is switched once for the whole load.
+bool lsm6dsoLoadFsm(LSM6DSO &imu, const uint8_t image[], uint16_t length);
+
+// Turns every state machine off.
+bool lsm6dsoDisableFsm(LSM6DSO &imu);
+
+// Routes the programs in programMask (program 1 in bit 0) to INT1 or INT2.
+// A zero mask removes the routing.
+bool lsm6dsoRouteFsmInterrupt(LSM6DSO &imu, uint16_t programMask, uint8_t pin = 1);
+
+// Reads the main page status registers in one burst and the long counter
+// and all FSM_OUTS in another.
+bool lsm6dsoReadFsmOutputs(LSM6DSO &imu, fsmOutputs &outputs);
+
+#endif  // End of __LSM6DSO_FSM_H__ definition check
@@ -0,0 +1,210 @@
+/******************************************************************************
+SparkFunLSM6DSO_Fixed.h
+Compile time configured LSM6DSO front end
+
+For firmware whose full scale and data rates never change, LSM6DSOFixed
+takes them as template arguments. The control register bytes, the
+sensitivities and the init sequence are all constants, so begin() is one
+burst write of a constant array and every float conversion is a single
+multiply by a literal. Combinations the sensor doesn't support fail to
+compile.
+
+  LSM6DSOFixed<LSM6DSOAccelFS::g8, LSM6DSOOdr::Hz1660, LSM6DSOGyroFS::dps500> myIMU;
+  myIMU.begin();
+  float z = myIMU.readFloatAccelZ();
+
+The gyroscope data rate defaults to the accelerometer's. Everything else
+(FIFO, interrupts, timestamps) is left to the regular LSM6DSO class.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_FIXED_H__
+#define __LSM6DSO_FIXED_H__
+
+#include "SparkFunLSM6DSO.h"
+
+// CTRL1_XL FS_XL[3:2], with XL_FS_MODE left at 0.
+enum class LSM6DSOAccelFS : uint8_t {
+  g2  = 0x00,
+  g16 = 0x04,
+  g4  = 0x08,
+  g8  = 0x0C
+};
+
+// CTRL2_G FS_G[3:2] and FS_125.
+enum class LSM6DSOGyroFS : uint8_t {
+  dps125  = 0x02,
+  dps250  = 0x00,
+  dps500  = 0x04,
+  dps1000 = 0x08,
+  dps2000 = 0x0C
+};
+
+// ODR_XL[7:4] / ODR_G[7:4]. Hz1_6 exists for the accelerometer only, in
+// low power mode.
+enum class LSM6DSOOdr : uint8_t {
+  Off    = 0x00,
+  Hz1_6  = 0xB0,
+  Hz12_5 = 0x10,
+  Hz26   = 0x20,
+  Hz52   = 0x30,
+  Hz104  = 0x40,
+  Hz208  = 0x50,
+  Hz416  = 0x60,
+  Hz833  = 0x70,
+  Hz1660 = 0x80,
+  Hz3330 = 0x90,
+  Hz6660 = 0xA0
+};
+
+template <LSM6DSOAccelFS ACCEL_FS, LSM6DSOOdr ACCEL_ODR, LSM6DSOGyroFS GYRO_FS, LSM6DSOOdr GYRO_ODR = ACCEL_ODR>
+class LSM6DSOFixed : public LSM6DSOCore
+{
+  public:
+
+    static_assert(GYRO_ODR != LSM6DSOOdr::Hz1_6, "the gyroscope has no 1.6Hz data rate");
+    static_assert(ACCEL_ODR != LSM6DSOOdr::Off || GYRO_ODR != LSM6DSOOdr::Off, "both sensors are powered down");
+
+    // CTRL1_XL through CTRL6_C, written as one burst by begin(). CTRL3_C
+    // keeps IF_INC and adds BDU; CTRL6_C enables low power mode, which
+    // 1.6Hz requires. The sequence lives in flash on AVR.
+    static constexpr uint8_t CTRL1_XL_VALUE = static_cast<uint8_t>(ACCEL_ODR) | static_cast<uint8_t>(ACCEL_FS);
+    static constexpr uint8_t CTRL2_G_VALUE = static_cast<uint8_t>(GYRO_ODR) | static_cast<uint8_t>(GYRO_FS);
+    static constexpr uint8_t CTRL3_C_VALUE = BDU_BLOCK_UPDATE | IF_INC_ENABLED;
+    static constexpr uint8_t CTRL6_C_VALUE = ACCEL_ODR == LSM6DSOOdr::Hz1_6 ? 0x10 : 0x00;
+
+    static constexpr uint8_t INIT_LENGTH = CTRL6_C - CTRL1_XL + 1;
+    static constexpr uint8_t INIT_SEQUENCE[INIT_LENGTH] PROGMEM = {
+      CTRL1_XL_VALUE, CTRL2_G_VALUE, CTRL3_C_VALUE, 0x00, 0x00, CTRL6_C_VALUE
+    };
+
+    // g and dps per LSB.
+    static constexpr float accelSensitivity()
+    {
+      return ACCEL_FS == LSM6DSOAccelFS::g2  ? 0.061f / 1000 :
+             ACCEL_FS == LSM6DSOAccelFS::g4  ? 0.122f / 1000 :
+             ACCEL_FS == LSM6DSOAccelFS::g8  ? 0.244f / 1000 :
+                                               0.488f / 1000;
+    }
+
+    static constexpr float gyroSensitivity()
+    {
+      return GYRO_FS == LSM6DSOGyroFS::dps125  ? 4.375f / 1000 :
+             GYRO_FS == LSM6DSOGyroFS::dps250  ? 8.75f / 1000 :
+             GYRO_FS == LSM6DSOGyroFS::dps500  ? 17.5f / 1000 :
+             GYRO_FS == LSM6DSOGyroFS::dps1000 ? 35.0f / 1000 :
+                                                 70.0f / 1000;
+    }
+
+    // Multipliers for the integer path, the same values as
+    // LSM6DSO::getAccelMilliScale() and getGyroMilliScale().
+    static constexpr uint32_t accelMilliScale()
+    {
+      return ACCEL_FS == LSM6DSOAccelFS::g2 ? 261993006 :
+             ACCEL_FS == LSM6DSOAccelFS::g4 ? 523986011 :
+             ACCEL_FS == LSM6DSOAccelFS::g8 ? 1047972021 :
+                                              2095944041;
+    }
+
+    static constexpr uint16_t gyroMilliScale()
+    {
+      return GYRO_FS == LSM6DSOGyroFS::dps125  ? 1120 :
+             GYRO_FS == LSM6DSOGyroFS::dps250  ? 2240 :
+             GYRO_FS == LSM6DSOGyroFS::dps500  ? 4480 :
+             GYRO_FS == LSM6DSOGyroFS::dps1000 ? 8960 :
+                                                 17920;
+    }
+
+    bool begin(uint8_t deviceAddress = DEFAULT_ADDRESS, TwoWire &i2cPort = Wire)
+    {
+      if( beginCore(deviceAddress, i2cPort) != IMU_SUCCESS )
+        return false;
+
+      return writeInitSequence();
+    }
+
+    bool beginSPI(uint8_t csPin, uint32_t spiPortSpeed = 10000000, SPIClass &spiPort = SPI)
+    {
+      if( beginCoreSPI(csPin, spiPortSpeed, spiPort) != IMU_SUCCESS )
+        return false;
+
+      return writeInitSequence();
+    }
+
+    static float calcAccel( int16_t input ) { return static_cast<float>(input) * accelSensitivity(); }
+    static float calcGyro( int16_t input ) { return static_cast<float>(input) * gyroSensitivity(); }
+    static float calcTemp( int16_t input ) { return static_cast<float>(input) * (1.0f / 256) + 25.0f; }
+
+    static int32_t calcAccelMilli( int16_t input ) { return lsm6dsoAccelMilli(input, accelMilliScale()); }
+    static int32_t calcGyroMilli( int16_t input ) { return lsm6dsoGyroMilli(input, gyroMilliScale()); }
+
+    int16_t readRawAccelX() { return readAxis(OUTX_L_A); }
+    int16_t readRawAccelY() { return readAxis(OUTY_L_A); }
+    int16_t readRawAccelZ() { return readAxis(OUTZ_L_A); }
+    int16_t readRawGyroX() { return readAxis(OUTX_L_G); }
+    int16_t readRawGyroY() { return readAxis(OUTY_L_G); }
+    int16_t readRawGyroZ() { return readAxis(OUTZ_L_G); }
+
+    float readFloatAccelX() { return calcAccel(readRawAccelX()); }
+    float readFloatAccelY() { return calcAccel(readRawAccelY()); }
+    float readFloatAccelZ() { return calcAccel(readRawAccelZ()); }
+    float readFloatGyroX() { return calcGyro(readRawGyroX()); }
+    float readFloatGyroY() { return calcGyro(readRawGyroY()); }
+    float readFloatGyroZ() { return calcGyro(readRawGyroZ()); }
+
+    // OUT_TEMP_L through OUTZ_H_A in one burst.
+    bool readAllRaw(imuRawData &output)
+    {
+      uint8_t buffer[14];
+      if( readMultipleRegisters(buffer, OUT_TEMP_L, 14) != IMU_SUCCESS )
+        return false;
+
+      LSM6DSO::unpackAllRaw(buffer, output);
+
+      return true;
+    }
+
+    bool readAll(imuData &output)
+    {
+      if( !readAllRaw(output.raw) )
+        return false;
+
+      output.xAccel = calcAccel(output.raw.xAccel);
+      output.yAccel = calcAccel(output.raw.yAccel);
+      output.zAccel = calcAccel(output.raw.zAccel);
+      output.xGyro = calcGyro(output.raw.xGyro);
+      output.yGyro = calcGyro(output.raw.yGyro);
+      output.zGyro = calcGyro(output.raw.zGyro);
+      output.temperatureC = calcTemp(output.raw.temperature);
+
+      return true;
+    }
+
+  private:
+
+    bool writeInitSequence()
+    {
+      uint8_t sequence[INIT_LENGTH];
+      for( uint8_t i = 0; i < INIT_LENGTH; i++ )
+        sequence[i] = pgm_read_byte(&INIT_SEQUENCE[i]);
+
+      return writeMultipleRegisters(sequence, CTRL1_XL, INIT_LENGTH) == IMU_SUCCESS;
+    }
+
+    int16_t readAxis(uint8_t address)
+    {
+      int16_t output;
+      if( readRegisterInt16(&output, address) != IMU_SUCCESS )
+        return 0;
+
+      return output;
+    }
+};
+
+template <LSM6DSOAccelFS ACCEL_FS, LSM6DSOOdr ACCEL_ODR, LSM6DSOGyroFS GYRO_FS, LSM6DSOOdr GYRO_ODR>
+constexpr uint8_t LSM6DSOFixed<ACCEL_FS, ACCEL_ODR, GYRO_FS, GYRO_ODR>::INIT_SEQUENCE[] PROGMEM;
+
+#endif  // End of __LSM6DSO_FIXED_H__ definition check
@@ -0,0 +1,252 @@
+#include "SparkFunLSM6DSO_Group.h"
+
+LSM6DSOGroup::LSM6DSOGroup() :
+  count(0),
+  lastMember(GROUP_NO_MEMBER),
+  lastBus(0),
+  lastMicros(0),
+  microsHigh(0)
+{
+}
+
+int8_t LSM6DSOGroup::add(LSM6DSO &imu)
+{
+  if( count >= LSM6DSO_GROUP_MAX )
+    return GROUP_NO_MEMBER;
+
+  Member &member = members[count];
+  member.imu = &imu;
+  member.bus = imu.getBus();
+  member.level = 0;
+  member.levelMicros = 0;
+  member.wordsPerSecond = 0;
+  member.rateKnown = false;
+  member.rateWords = 0;
+  member.rateMicros = 0;
+  member.offsetNs = 0;
+  member.syncMicros = 0;
+  member.overruns = 0;
+
+  return count++;
+}
+
+uint8_t LSM6DSOGroup::getCount() const
+{
+  return count;
+}
+
+LSM6DSO &LSM6DSOGroup::getMember(uint8_t member)
+{
+  return *members[member].imu;
+}
+
+// The counters are reset back to back, each dated by the middle of its
+// transfer, and only then are the FIFOs emptied: a timestamp word batched
+// in between would still carry the old count.
+bool LSM6DSOGroup::begin()
+{
+  bool success = true;
+
+  for( uint8_t i = 0; i < count; i++ ){
+    LSM6DSO &imu = *members[i].imu;
+
+    // Keeps a timestamp decimation the sketch already chose.
+    uint8_t decimation = imu.readShadow(FIFO_CTRL4) & ~FIFO_TS_DEC_MASK;
+    success &= imu.enableTimestamp(true, decimation ? decimation : static_cast<uint8_t>(FIFO_TS_DEC_BY_1));
+  }
+
+  for( uint8_t i = 0; i < count; i++ ){
+    Member &member = members[i];
+
+    uint64_t before = nowNs();
+    success &= member.imu->resetTimestamp();
+    uint64_t after = nowNs();
+
+    member.offsetNs = static_cast<int64_t>(before + (after - before) / 2);
+  }
+
+  for( uint8_t i = 0; i < count; i++ ){
+    Member &member = members[i];
+    LSM6DSO &imu = *member.imu;
+
+    uint8_t mode = imu.readShadow(FIFO_CTRL4) & 0x07;
+    success &= imu.setFifoMode(FIFO_MODE_DISABLED);
+    success &= imu.setFifoMode(mode);
+
+    member.syncMicros = micros();
+    member.level = 0;
+    member.levelMicros = member.syncMicros;
+    member.wordsPerSecond = 0;
+    member.rateKnown = false;
+    member.rateWords = 0;
+    member.rateMicros = member.syncMicros;
+    member.overruns = 0;
+  }
+
+  lastMember = GROUP_NO_MEMBER;
+  lastBus = 0;
+  return success;
+}
+
+int8_t LSM6DSOGroup::drain(uint8_t words[], uint16_t maxWords, uint16_t &numWords)
+{
+  numWords = 0;
+
+  uint32_t now = micros();
+  int8_t chosen = pickMember(now);
+  if( chosen == GROUP_NO_MEMBER )
+    return GROUP_NO_MEMBER;
+
+  Member &member = members[chosen];
+  LSM6DSO &imu = *member.imu;
+
+  if( now - member.syncMicros >= GROUP_SYNC_INTERVAL_US )
+    synchronize(chosen);
+
+  uint16_t status = imu.getFifoStatus();
+  uint16_t unread = status & 0x03FF;
+  now = micros();
+
+  // Learn the arrival rate from what came in over at least
+  // GROUP_RATE_MIN_US, so drains close together can't read as no data. An
+  // overrun hides how much arrived, so it teaches nothing.
+  if( status & (OVERRUN_OVERRUN << 8) ){
+    member.overruns++;
+    member.rateWords = 0;
+    member.rateMicros = now;
+  }
+  else if( unread >= member.level ){
+    member.rateWords += unread - member.level;
+    uint32_t elapsed = now - member.rateMicros;
+    if( elapsed >= GROUP_RATE_MIN_US ){
+      uint32_t rate = (member.rateWords * 1000UL) / (elapsed / 1000);
+      if( !member.rateKnown )
+        member.wordsPerSecond = rate;
+      else
+        member.wordsPerSecond = member.wordsPerSecond - (member.wordsPerSecond >> 2) + (rate >> 2);
+      member.rateKnown = true;
+      member.rateWords = 0;
+      member.rateMicros = now;
+    }
+  }
+
+  numWords = unread < maxWords ? unread : maxWords;
+  if( numWords > 0 && imu.fifoReadWords(words, numWords) != numWords )
+    numWords = 0;
+
+  member.level = unread - numWords;
+  member.levelMicros = now;
+
+  lastMember = chosen;
+  lastBus = member.bus;
+  return chosen;
+}
+
+uint64_t LSM6DSOGroup::getSampleNs(uint8_t member, uint8_t slotsBack)
+{
+  uint64_t ticks = members[member].imu->getFifoSampleTicks(slotsBack);
+  if( ticks == 0 )
+    return 0;
+
+  return ticksToGroupNs(member, ticks);
+}
+
+uint64_t LSM6DSOGroup::ticksToGroupNs(uint8_t member, uint64_t ticks)
+{
+  return members[member].offsetNs + members[member].imu->ticksToNs(ticks);
+}
+
+uint64_t LSM6DSOGroup::nowNs()
+{
+  uint32_t now = micros();
+  if( now < lastMicros )
+    microsHigh++;
+  lastMicros = now;
+
+  return ((static_cast<uint64_t>(microsHigh) << 32) | now) * 1000;
+}
+
+uint32_t LSM6DSOGroup::getOverruns(uint8_t member) const
+{
+  return members[member].overruns;
+}
+
+// Earliest overflow first: the member with the fewest words of room left
+// at its arrival rate. A member whose rate isn't known yet goes first, once
+// per GROUP_RATE_MIN_US. One whose rate is known to be zero is never urgent;
+// when no other member needs a drain, the one left alone longest is looked
+// at again after GROUP_SYNC_INTERVAL_US, in case it has started. On a tie
+// the search order, starting after the last member drained and trying other
+// buses before its own, decides.
+int8_t LSM6DSOGroup::pickMember(uint32_t now)
+{
+  int8_t best = GROUP_NO_MEMBER;
+  uint32_t bestMicros = 0xFFFFFFFF;
+  int8_t idle = GROUP_NO_MEMBER;
+  uint32_t idleMicros = 0;
+
+  for( uint8_t pass = 0; pass < 2; pass++ ){
+    for( uint8_t step = 1; step <= count; step++ ){
+      uint8_t i = (lastMember + step) % count;
+      const Member &member = members[i];
+
+      if( (member.bus == lastBus) != (pass == 1) && count > 1 )
+        continue;
+
+      uint32_t sinceDrain = now - member.levelMicros;
+      if( !member.rateKnown ){
+        if( sinceDrain >= GROUP_RATE_MIN_US )
+          return i;
+        continue;
+      }
+
+      if( member.wordsPerSecond == 0 ){
+        if( sinceDrain >= GROUP_SYNC_INTERVAL_US && (idle == GROUP_NO_MEMBER || sinceDrain > idleMicros) ){
+          idle = i;
+          idleMicros = sinceDrain;
+        }
+        continue;
+      }
+
+      uint16_t level = predictLevel(member, now);
+      if( level < GROUP_MIN_WORDS )
+        continue;
+
+      uint32_t room = GROUP_FIFO_CAPACITY - level;
+      uint32_t untilFull = room * (1000000UL / member.wordsPerSecond);
+      if( untilFull < bestMicros ){
+        best = i;
+        bestMicros = untilFull;
+      }
+    }
+  }
+
+  return best != GROUP_NO_MEMBER ? best : idle;
+}
+
+uint16_t LSM6DSOGroup::predictLevel(const Member &member, uint32_t now) const
+{
+  uint32_t elapsed = now - member.levelMicros;
+  uint32_t arrived = (elapsed / 1000) * member.wordsPerSecond / 1000 +
+                     (elapsed % 1000) * member.wordsPerSecond / 1000000UL;
+  uint32_t level = member.level + arrived;
+
+  return level > GROUP_FIFO_CAPACITY ? GROUP_FIFO_CAPACITY : level;
+}
+
+// Compares the sensor's counter with the host clock and moves the offset
+// part of the way towards the difference, so a single slow transfer can't
+// jerk the timeline.
+void LSM6DSOGroup::synchronize(uint8_t index)
+{
+  Member &member = members[index];
+
+  uint64_t before = nowNs();
+  uint64_t ticks = member.imu->readTimestamp();
+  uint64_t after = nowNs();
+
+  int64_t host = static_cast<int64_t>(before + (after - before) / 2);
+  int64_t error = host - (member.offsetNs + static_cast<int64_t>(member.imu->ticksToNs(ticks)));
+  member.offsetNs += error / (1 << GROUP_SYNC_SHIFT);
+  member.syncMicros = micros();
+}
@@ -0,0 +1,174 @@
+/******************************************************************************
+SparkFunLSM6DSO_Group.h
+Coordinated FIFO draining and a common timeline for several sensors
+
+LSM6DSOGroup takes over the FIFOs of up to LSM6DSO_GROUP_MAX sensors on any
+mix of Wire and SPI ports. Polling each one in turn spends bus time on
+sensors with little waiting while another one's FIFO fills up. The group
+instead keeps an estimate of every FIFO's level from its arrival rate and
+always drains the one that will overflow soonest, in bursts of bulk reads.
+Sensors that are equally urgent are served round robin, alternating
+between buses. When nothing is close to worth a transfer, no transfer is
+made.
+
+Every sample comes out on one timeline, host micros() in nanoseconds.
+begin() resets the sensors' timestamp counters back to back and notes when;
+after that each sensor's trimmed ticks are mapped onto host time, and the
+mapping is re-measured once per GROUP_SYNC_INTERVAL_US to follow drift.
+
+  LSM6DSO imu[4];
+  LSM6DSOGroup group;
+  ... begin and configure each imu, FIFO in continuous mode ...
+  for( i = 0; i < 4; i++ ) group.add(imu[i]);
+  group.begin();
+
+  struct Sink {
+    bool addSample(uint8_t member, uint8_t sensorTag, const int16_t raw[3], uint64_t timeNs);
+  } sink;
+  loop: group.service(sink);
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_GROUP_H__
+#define __LSM6DSO_GROUP_H__
+
+#include "SparkFunLSM6DSO.h"
+
+#ifndef LSM6DSO_GROUP_MAX
+  #if defined(__AVR__)
+    #define LSM6DSO_GROUP_MAX 4
+  #else
+    #define LSM6DSO_GROUP_MAX 8
+  #endif
+#endif
+
+// Words service() reads per call; its stack buffer is 7 bytes per word.
+#ifndef LSM6DSO_GROUP_BURST
+  #if defined(__AVR__)
+    #define LSM6DSO_GROUP_BURST 16
+  #else
+    #define LSM6DSO_GROUP_BURST 64
+  #endif
+#endif
+
+#define GROUP_NO_MEMBER -1
+// Predicted level below which a FIFO isn't worth a transfer yet.
+#define GROUP_MIN_WORDS 8
+// Words the FIFO holds before it overruns.
+#define GROUP_FIFO_CAPACITY (FIFO_MAX_WORDS + 1)
+// How often each sensor's clock is compared with the host's again, and how
+// much of the difference each comparison corrects, as a power of two.
+#define GROUP_SYNC_INTERVAL_US 1000000UL
+#define GROUP_SYNC_SHIFT 2
+// Shortest stretch an arrival rate is measured over. Until a member's rate
+// is known it is drained once per stretch; once known to be zero, it is
+// looked at once per GROUP_SYNC_INTERVAL_US when nothing else needs it.
+#define GROUP_RATE_MIN_US 20000UL
+
+class LSM6DSOGroup
+{
+  public:
+
+    LSM6DSOGroup();
+
+    // Adds a sensor that has been begun and configured, FIFO included.
+    // Returns its index, or GROUP_NO_MEMBER when the group is full.
+    int8_t add(LSM6DSO &);
+    uint8_t getCount() const;
+    LSM6DSO &getMember(uint8_t member);
+
+    // Turns timestamps on where they aren't, empties every FIFO and resets
+    // the timestamp counters one after the other to start the timeline.
+    bool begin();
+
+    // Reads up to maxWords words from the member most in need and returns
+    // which one that was, or GROUP_NO_MEMBER when no FIFO is expected to
+    // hold GROUP_MIN_WORDS yet. Decode the words with that member's
+    // decodeFifoWordRaw() and date them with getSampleNs().
+    int8_t drain(uint8_t words[], uint16_t maxWords, uint16_t &numWords);
+
+    // One drain() of up to LSM6DSO_GROUP_BURST words, decoded. Each
+    // accelerometer and gyroscope sample goes to
+    // sink.addSample(member, sensorTag, raw, timeNs). Returns the number
+    // of samples.
+    template <class SINK>
+    uint16_t service(SINK &sink)
+    {
+      uint8_t words[LSM6DSO_GROUP_BURST * FIFO_WORD_LENGTH];
+      uint16_t numWords;
+      int16_t raw[FIFO_MAX_SAMPLES_PER_WORD][3];
+      uint8_t slotsBack[FIFO_MAX_SAMPLES_PER_WORD];
+      uint8_t sensorTag;
+      uint16_t delivered = 0;
+
+      int8_t member = drain(words, LSM6DSO_GROUP_BURST, numWords);
+      if( member == GROUP_NO_MEMBER )
+        return 0;
+
+      LSM6DSO &imu = *members[member].imu;
+      for( uint16_t word = 0; word < numWords; word++ ){
+        uint8_t samples = imu.decodeFifoWordRaw(&words[word * FIFO_WORD_LENGTH], raw, slotsBack, sensorTag);
+        if( sensorTag != GYROSCOPE_DATA && sensorTag != ACCELEROMETER_DATA )
+          continue;
+        for( uint8_t i = 0; i < samples; i++ ){
+          sink.addSample(static_cast<uint8_t>(member), sensorTag, raw[i], getSampleNs(member, slotsBack[i]));
+          delivered++;
+        }
+      }
+
+      return delivered;
+    }
+
+    // Group time of a sample from the member's last decodeFifoWordRaw()
+    // call, or of a reading of its timestamp counter. Zero until the FIFO
+    // has delivered a timestamp word.
+    uint64_t getSampleNs(uint8_t member, uint8_t slotsBack = 0);
+    uint64_t ticksToGroupNs(uint8_t member, uint64_t ticks);
+
+    // Host time in ns on the same timeline.
+    uint64_t nowNs();
+
+    // Times a member's FIFO was found overrun.
+    uint32_t getOverruns(uint8_t member) const;
+
+  private:
+
+    struct Member {
+      LSM6DSO *imu;
+      const void *bus;
+
+      // FIFO level left by the last drain, when, and the arrival rate.
+      uint16_t level;
+      uint32_t levelMicros;
+      uint32_t wordsPerSecond;
+      bool rateKnown;
+
+      // Words counted since rateMicros, towards the next rate measurement.
+      uint32_t rateWords;
+      uint32_t rateMicros;
+
+      // Group time of tick zero.
+      int64_t offsetNs;
+      uint32_t syncMicros;
+
+      uint32_t overruns;
+    };
+
+    int8_t pickMember(uint32_t now);
+    uint16_t predictLevel(const Member &member, uint32_t now) const;
+    void synchronize(uint8_t member);
+
+    Member members[LSM6DSO_GROUP_MAX];
+    uint8_t count;
+
+    int8_t lastMember;
+    const void *lastBus;
+
+    uint32_t lastMicros;
+    uint32_t microsHigh;
+};
+
+#endif  // End of __LSM6DSO_GROUP_H__ definition check
@@ -0,0 +1,402 @@
+#include "SparkFunLSM6DSO_Log.h"
+
+// Maps 0, -1, 1, -2, 2 ... to 0, 1, 2, 3, 4 ...
+static uint32_t zigzag(int16_t value, int16_t previous)
+{
+  int32_t delta = static_cast<int32_t>(value) - previous;
+  uint32_t doubled = static_cast<uint32_t>(delta) << 1;
+  return delta < 0 ? ~doubled : doubled;
+}
+
+static int16_t unzigzag(uint32_t code, int16_t previous)
+{
+  uint32_t delta = (code >> 1) ^ (0 - (code & 1));
+  return static_cast<int16_t>(static_cast<uint16_t>(previous + delta));
+}
+
+//****************************************************************************//
+//
+//  Encoder
+//
+//****************************************************************************//
+
+LSM6DSOLogEncoder::LSM6DSOLogEncoder(Print &port) :
+  port(port),
+  payloadLength(0),
+  bitBuffer(0),
+  bitCount(0),
+  groupCount(0),
+  count(0),
+  sequence(0),
+  accelMilliScale(0),
+  gyroMilliScale(0),
+  firstTicks(0),
+  lastTicks(0),
+  samples(0),
+  bytesWritten(0)
+{
+  pairing.gyroFresh = false;
+  pairing.accelFresh = false;
+}
+
+void LSM6DSOLogEncoder::begin(LSM6DSO &imu)
+{
+  accelMilliScale = imu.getAccelMilliScale();
+  gyroMilliScale = imu.getGyroMilliScale();
+  payloadLength = 0;
+  bitBuffer = 0;
+  bitCount = 0;
+  groupCount = 0;
+  count = 0;
+  sequence = 0;
+  samples = 0;
+  bytesWritten = 0;
+  pairing.gyroFresh = false;
+  pairing.accelFresh = false;
+}
+
+bool LSM6DSOLogEncoder::addSample(const int16_t gyro[3], const int16_t accel[3], uint32_t ticks)
+{
+  bool written = false;
+  if( count > 0 && !lsm6dsoTicksContinue(firstTicks, lastTicks, count, ticks) ){
+    flush();
+    written = true;
+  }
+
+  samples++;
+  lastTicks = ticks;
+
+  if( count == 0 ){
+    firstTicks = ticks;
+    for( uint8_t i = 0; i < 3; i++ ){
+      previous[i] = gyro[i];
+      previous[3 + i] = accel[i];
+      lsm6dsoPutUint16(&block[20 + 2 * i], static_cast<uint16_t>(gyro[i]));
+      lsm6dsoPutUint16(&block[26 + 2 * i], static_cast<uint16_t>(accel[i]));
+    }
+  }
+  else {
+    int16_t *sample = group[groupCount++];
+    for( uint8_t i = 0; i < 3; i++ ){
+      sample[i] = gyro[i];
+      sample[3 + i] = accel[i];
+    }
+    if( groupCount == LOG_GROUP )
+      packGroup();
+  }
+  count++;
+
+  if( count < LSM6DSO_LOG_BLOCK )
+    return written;
+
+  flush();
+  return true;
+}
+
+uint16_t LSM6DSOLogEncoder::addFifoWords(LSM6DSO &imu, const uint8_t words[], uint16_t numWords)
+{
+  return lsm6dsoPairFifoWords(imu, words, numWords, pairing, *this);
+}
+
+bool LSM6DSOLogEncoder::flush()
+{
+  if( count == 0 )
+    return true;
+
+  if( groupCount > 0 )
+    packGroup();
+  if( bitCount > 0 )
+    block[LOG_HEADER_LENGTH + payloadLength++] = bitBuffer & 0xFF;
+
+  uint16_t period = lsm6dsoTicksPeriod(firstTicks, lastTicks, count);
+
+  block[0] = LOG_SYNC_1;
+  block[1] = LOG_SYNC_2;
+  block[2] = LOG_VERSION;
+  block[3] = count;
+  lsm6dsoPutUint16(&block[4], payloadLength);
+  lsm6dsoPutUint16(&block[6], sequence);
+  lsm6dsoPutUint32(&block[8], accelMilliScale);
+  lsm6dsoPutUint16(&block[12], gyroMilliScale);
+  lsm6dsoPutUint32(&block[14], firstTicks);
+  lsm6dsoPutUint16(&block[18], period);
+
+  uint16_t length = LOG_HEADER_LENGTH + payloadLength;
+  lsm6dsoPutUint16(&block[length], lsm6dsoChecksum(&block[2], length - 2));
+  length += LOG_CRC_LENGTH;
+
+  count = 0;
+  payloadLength = 0;
+  bitBuffer = 0;
+  bitCount = 0;
+  sequence++;
+
+  uint16_t written = port.write(block, length);
+  bytesWritten += written;
+  return written == length;
+}
+
+uint32_t LSM6DSOLogEncoder::getSamples() const
+{
+  return samples;
+}
+
+uint32_t LSM6DSOLogEncoder::getBytesWritten() const
+{
+  return bytesWritten;
+}
+
+// Two passes over the group: the OR of every code of an axis gives its
+// width, then the codes go out at that width.
+void LSM6DSOLogEncoder::packGroup()
+{
+  uint8_t width[LOG_CHANNELS];
+
+  for( uint8_t c = 0; c < LOG_CHANNELS; c++ ){
+    uint32_t all = 0;
+    int16_t last = previous[c];
+    for( uint8_t j = 0; j < groupCount; j++ ){
+      all |= zigzag(group[j][c], last);
+      last = group[j][c];
+    }
+
+    width[c] = 0;
+    while( all ){
+      width[c]++;
+      all >>= 1;
+    }
+    putBits(width[c], LOG_WIDTH_BITS);
+  }
+
+  for( uint8_t j = 0; j < groupCount; j++ ){
+    for( uint8_t c = 0; c < LOG_CHANNELS; c++ ){
+      putBits(zigzag(group[j][c], previous[c]), width[c]);
+      previous[c] = group[j][c];
+    }
+  }
+
+  groupCount = 0;
+}
+
+// Fewer than 8 bits wait in bitBuffer between calls, so up to LOG_MAX_WIDTH
+// more still fit in 32.
+void LSM6DSOLogEncoder::putBits(uint32_t value, uint8_t width)
+{
+  bitBuffer |= value << bitCount;
+  bitCount += width;
+
+  while( bitCount >= 8 ){
+    block[LOG_HEADER_LENGTH + payloadLength++] = bitBuffer & 0xFF;
+    bitBuffer >>= 8;
+    bitCount -= 8;
+  }
+}
+
+//****************************************************************************//
+//
+//  Reader
+//
+//****************************************************************************//
+
+LSM6DSOLogReader::LSM6DSOLogReader(const uint8_t data[], uint32_t length) :
+  data(data),
+  length(length)
+{
+  rewind();
+}
+
+void LSM6DSOLogReader::rewind()
+{
+  blockOffset = 0;
+  nextOffset = 0;
+  inBlock = false;
+  index = 0;
+  crcErrors = 0;
+  skippedBytes = 0;
+}
+
+bool LSM6DSOLogReader::nextBlock()
+{
+  for( uint32_t offset = nextOffset; offset + LOG_HEADER_LENGTH + LOG_CRC_LENGTH <= length; offset++ ){
+    if( !validBlock(offset, false) )
+      continue;
+    if( !validBlock(offset, true) ){
+      crcErrors++;
+      continue;
+    }
+    skippedBytes += offset - nextOffset;
+    enterBlock(offset);
+    return true;
+  }
+
+  if( nextOffset < length )
+    skippedBytes += length - nextOffset;
+  nextOffset = length;
+  inBlock = false;
+  return false;
+}
+
+bool LSM6DSOLogReader::seek(uint32_t offset)
+{
+  if( !validBlock(offset, true) )
+    return false;
+
+  enterBlock(offset);
+  return true;
+}
+
+bool LSM6DSOLogReader::seekTicks(uint32_t ticks)
+{
+  blockOffset = 0;
+  nextOffset = 0;
+  inBlock = false;
+
+  if( !nextBlock() || static_cast<int32_t>(getBlockTicks() - ticks) > 0 )
+    return false;
+
+  // Only the headers are checked on the way; a damaged block ends the hops
+  // early and read() carries on from there.
+  while( validBlock(nextOffset, false) &&
+         static_cast<int32_t>(lsm6dsoGetUint32(&data[nextOffset + 14]) - ticks) <= 0 )
+    enterBlock(nextOffset);
+
+  if( !validBlock(blockOffset, true) ){
+    crcErrors++;
+    inBlock = false;
+    nextOffset = blockOffset + 1;
+    return nextBlock();
+  }
+
+  return true;
+}
+
+bool LSM6DSOLogReader::read(streamRecord &output)
+{
+  for( ;; ){
+    if( !inBlock || index >= data[blockOffset + 3] ){
+      if( !nextBlock() )
+        return false;
+    }
+
+    if( index == 0 || (index - 1) % LOG_GROUP != 0 )
+      break;
+
+    bool valid = true;
+    for( uint8_t c = 0; c < LOG_CHANNELS; c++ ){
+      widths[c] = getBits(LOG_WIDTH_BITS);
+      if( widths[c] > LOG_MAX_WIDTH )
+        valid = false;
+    }
+    if( valid )
+      break;
+
+    // Only a broken writer gets a block with a bad width past the CRC.
+    crcErrors++;
+    inBlock = false;
+  }
+
+  const uint8_t *header = &data[blockOffset];
+
+  if( index > 0 )
+    for( uint8_t c = 0; c < LOG_CHANNELS; c++ )
+      values[c] = unzigzag(getBits(widths[c]), values[c]);
+
+  uint32_t accelMilliScale = lsm6dsoGetUint32(&header[8]);
+  uint16_t gyroMilliScale = lsm6dsoGetUint16(&header[12]);
+  output.ticks = lsm6dsoGetUint32(&header[14]) + static_cast<uint32_t>(index) * lsm6dsoGetUint16(&header[18]);
+
+  for( uint8_t i = 0; i < 3; i++ ){
+    output.rawGyro[i] = values[i];
+    output.rawAccel[i] = values[3 + i];
+    output.milliGyro[i] = lsm6dsoGyroMilli(output.rawGyro[i], gyroMilliScale);
+    output.milliAccel[i] = lsm6dsoAccelMilli(output.rawAccel[i], accelMilliScale);
+  }
+
+  index++;
+  return true;
+}
+
+uint32_t LSM6DSOLogReader::getBlockOffset() const
+{
+  return blockOffset;
+}
+
+uint32_t LSM6DSOLogReader::getBlockTicks() const
+{
+  return inBlock ? lsm6dsoGetUint32(&data[blockOffset + 14]) : 0;
+}
+
+uint16_t LSM6DSOLogReader::getSequence() const
+{
+  return inBlock ? lsm6dsoGetUint16(&data[blockOffset + 6]) : 0;
+}
+
+uint8_t LSM6DSOLogReader::getCount() const
+{
+  return inBlock ? data[blockOffset + 3] : 0;
+}
+
+uint32_t LSM6DSOLogReader::getCrcErrors() const
+{
+  return crcErrors;
+}
+
+uint32_t LSM6DSOLogReader::getSkippedBytes() const
+{
+  return skippedBytes;
+}
+
+bool LSM6DSOLogReader::validBlock(uint32_t offset, bool checkCrc) const
+{
+  if( offset + LOG_HEADER_LENGTH + LOG_CRC_LENGTH > length )
+    return false;
+
+  const uint8_t *header = &data[offset];
+  if( header[0] != LOG_SYNC_1 || header[1] != LOG_SYNC_2 || header[2] != LOG_VERSION || header[3] == 0 )
+    return false;
+
+  uint16_t payload = lsm6dsoGetUint16(&header[4]);
+  if( payload > LOG_PAYLOAD_MAX(static_cast<uint32_t>(header[3])) )
+    return false;
+  if( offset + LOG_HEADER_LENGTH + payload + LOG_CRC_LENGTH > length )
+    return false;
+
+  if( !checkCrc )
+    return true;
+
+  uint16_t crcOffset = LOG_HEADER_LENGTH + payload;
+  return lsm6dsoGetUint16(&header[crcOffset]) == lsm6dsoChecksum(&header[2], crcOffset - 2);
+}
+
+void LSM6DSOLogReader::enterBlock(uint32_t offset)
+{
+  const uint8_t *header = &data[offset];
+  uint16_t payload = lsm6dsoGetUint16(&header[4]);
+
+  blockOffset = offset;
+  nextOffset = offset + LOG_HEADER_LENGTH + payload + LOG_CRC_LENGTH;
+  inBlock = true;
+
+  index = 0;
+  for( uint8_t c = 0; c < LOG_CHANNELS; c++ )
+    values[c] = static_cast<int16_t>(lsm6dsoGetUint16(&header[20 + 2 * c]));
+
+  bits = &header[LOG_HEADER_LENGTH];
+  bitsEnd = bits + payload;
+  bitBuffer = 0;
+  bitCount = 0;
+}
+
+uint32_t LSM6DSOLogReader::getBits(uint8_t width)
+{
+  while( bitCount < width ){
+    uint32_t next = bits < bitsEnd ? *bits++ : 0;
+    bitBuffer |= next << bitCount;
+    bitCount += 8;
+  }
+
+  uint32_t value = bitBuffer & ((1UL << width) - 1);
+  bitBuffer >>= width;
+  bitCount -= width;
+  return value;
+}
@@ -0,0 +1,216 @@
+/******************************************************************************
+SparkFunLSM6DSO_Log.h
+Compressed logging of 6-axis samples for long recordings
+
+LSM6DSOLogEncoder stores gyroscope/accelerometer pairs as raw counts in
+blocks for an SD card or flash file. A block opens with a keyframe, the first
+sample in full, followed by the change of each axis from one sample to the
+next. The changes are zigzag coded and bit packed in groups of LOG_GROUP
+samples, each axis of a group at the width its largest change needs. A
+sensor at rest or in ordinary motion changes by a few LSB per sample, so a
+sample takes 3 to 5 bytes instead of the 12 of SparkFunLSM6DSO_Stream.h.
+
+  LSM6DSOLogEncoder log(file);
+  log.begin(myIMU);
+  ...
+  uint16_t n = myIMU.fifoReadWords(words, myIMU.getUnreadFifoWords());
+  log.addFifoWords(myIMU, words, n);
+  ...
+  log.flush();
+
+Block layout, little endian:
+
+  0   2  sync, 0xC3 0x3C
+  2   1  LOG_VERSION
+  3   1  sample count n
+  4   2  payload length p in bytes
+  6   2  block sequence number
+  8   4  accelerometer milli scale, see LSM6DSO::getAccelMilliScale()
+  12  2  gyroscope milli scale, see LSM6DSO::getGyroMilliScale()
+  14  4  sensor time of the first sample, in timestamp ticks
+  18  2  ticks between samples, averaged over the block and rounded
+  20  12 first sample: gyro x, y, z, accel x, y, z as int16_t
+  32  p  samples 1 to n - 1 in groups of LOG_GROUP
+  ..  2  CRC-16/CCITT-FALSE over bytes 2 onwards
+
+Sample i is dated first + i * period. As with stream frames, a sample that
+doesn't follow the block's period (an overrun, a gap, a timestamp reset)
+starts a new block.
+
+The payload is a bit stream, least significant bit first. Each group starts
+with six 5 bit widths, one per axis, then holds every sample of the group as
+six deltas of that many bits. A delta d is stored as 2d for d >= 0 and
+-2d - 1 below, so small changes of either sign need few bits.
+
+Every block decodes on its own, so LSM6DSOLogReader can start anywhere: it
+skips from header to header to reach a time, or jumps to an offset taken
+from an earlier pass, and decodes straight out of the caller's buffer (a
+memory mapped file on a host) without copying it. A damaged block costs its
+own samples only.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_LOG_H__
+#define __LSM6DSO_LOG_H__
+
+#include "SparkFunLSM6DSO.h"
+#include "SparkFunLSM6DSO_Stream.h"
+
+// Samples per block, at most 255. Longer blocks spread the 34 bytes of
+// header and CRC thinner; shorter ones give finer random access and need
+// less RAM for the block being built, about 13 bytes per sample.
+#ifndef LSM6DSO_LOG_BLOCK
+  #if defined(__AVR__)
+    #define LSM6DSO_LOG_BLOCK 16
+  #else
+    #define LSM6DSO_LOG_BLOCK 128
+  #endif
+#endif
+
+#if LSM6DSO_LOG_BLOCK < 1 || LSM6DSO_LOG_BLOCK > 255
+  #error "LSM6DSO_LOG_BLOCK must be between 1 and 255"
+#endif
+
+#define LOG_SYNC_1 0xC3
+#define LOG_SYNC_2 0x3C
+#define LOG_VERSION 2
+#define LOG_HEADER_LENGTH 32
+#define LOG_CRC_LENGTH 2
+#define LOG_CHANNELS 6
+#define LOG_GROUP 16
+#define LOG_WIDTH_BITS 5
+// A delta between two int16_t values takes up to 17 bits once zigzag coded.
+#define LOG_MAX_WIDTH 17
+
+// Largest payload of a block of n samples, every delta at full width.
+#define LOG_PAYLOAD_MAX(n) (((((n) - 1 + LOG_GROUP - 1) / LOG_GROUP) * LOG_CHANNELS * LOG_WIDTH_BITS + \
+                             ((n) - 1) * LOG_CHANNELS * LOG_MAX_WIDTH + 7) / 8)
+#define LOG_BLOCK_MAX_LENGTH (LOG_HEADER_LENGTH + LOG_PAYLOAD_MAX(LSM6DSO_LOG_BLOCK) + LOG_CRC_LENGTH)
+
+class LSM6DSOLogEncoder
+{
+  public:
+
+    LSM6DSOLogEncoder(Print &);
+
+    // Takes the current scales from the sensor and restarts the sequence.
+    // Call flush() and then begin() again after changing the full scale.
+    void begin(LSM6DSO &);
+
+    // Adds one 6-axis sample; writes the block once it holds
+    // LSM6DSO_LOG_BLOCK samples, or first when the sample doesn't follow
+    // the block's period. Returns true when a block went out.
+    bool addSample(const int16_t gyro[3], const int16_t accel[3], uint32_t ticks);
+
+    // Decodes raw FIFO words (LSM6DSO::fifoReadWords()) and adds the
+    // samples paired by lsm6dsoPairFifoWords(). Returns the number of blocks
+    // written.
+    uint16_t addFifoWords(LSM6DSO &, const uint8_t words[], uint16_t numWords);
+
+    // Writes out a partly filled block.
+    bool flush();
+
+    // Samples added and bytes written since begin(), for the compression
+    // ratio: getSamples() * 12 / getBytesWritten().
+    uint32_t getSamples() const;
+    uint32_t getBytesWritten() const;
+
+  private:
+
+    void packGroup();
+    void putBits(uint32_t value, uint8_t width);
+
+    Print &port;
+
+    uint8_t block[LOG_BLOCK_MAX_LENGTH];
+    uint16_t payloadLength;
+    uint32_t bitBuffer;
+    uint8_t bitCount;
+
+    // Samples waiting for their group to fill, and the one before them.
+    int16_t group[LOG_GROUP][LOG_CHANNELS];
+    uint8_t groupCount;
+    int16_t previous[LOG_CHANNELS];
+
+    uint8_t count;
+    uint16_t sequence;
+    uint32_t accelMilliScale;
+    uint16_t gyroMilliScale;
+    uint32_t firstTicks;
+    uint32_t lastTicks;
+
+    uint32_t samples;
+    uint32_t bytesWritten;
+
+    fifoPairState pairing;
+};
+
+class LSM6DSOLogReader
+{
+  public:
+
+    // The log stays where it is; the reader only keeps a pointer to it.
+    LSM6DSOLogReader(const uint8_t data[], uint32_t length);
+
+    // Back to the start of the log, clearing the error counts.
+    void rewind();
+
+    // Moves to the next valid block, skipping anything that isn't one.
+    // Returns false at the end of the log.
+    bool nextBlock();
+
+    // Moves to the block at offset, as returned by getBlockOffset() on an
+    // earlier pass. Returns false if there is no valid block there.
+    bool seek(uint32_t offset);
+
+    // Moves to the last block starting at or before ticks, hopping over
+    // the payload of the ones before it without decoding them. Returns false
+    // if the log starts later or holds no valid block.
+    bool seekTicks(uint32_t ticks);
+
+    // Decodes the next sample, moving on to the next block at the end of
+    // the current one. Returns false at the end of the log.
+    bool read(streamRecord &output);
+
+    // The current block.
+    uint32_t getBlockOffset() const;
+    uint32_t getBlockTicks() const;
+    uint16_t getSequence() const;
+    uint8_t getCount() const;
+
+    // Blocks that had a plausible header but failed the CRC, and bytes
+    // skipped between valid blocks.
+    uint32_t getCrcErrors() const;
+    uint32_t getSkippedBytes() const;
+
+  private:
+
+    bool validBlock(uint32_t offset, bool checkCrc) const;
+    void enterBlock(uint32_t offset);
+    uint32_t getBits(uint8_t width);
+
+    const uint8_t *data;
+    uint32_t length;
+
+    // Current block, and where the search for the next one starts.
+    uint32_t blockOffset;
+    uint32_t nextOffset;
+    bool inBlock;
+
+    // Decoding position within the current block.
+    uint8_t index;
+    int16_t values[LOG_CHANNELS];
+    uint8_t widths[LOG_CHANNELS];
+    const uint8_t *bits;
+    const uint8_t *bitsEnd;
+    uint32_t bitBuffer;
+    uint8_t bitCount;
+
+    uint32_t crcErrors;
+    uint32_t skippedBytes;
+};
+
+#endif  // End of __LSM6DSO_LOG_H__ definition check
@@ -0,0 +1,146 @@
+/******************************************************************************
+SparkFunLSM6DSO_Ring.h
+LSM6DSO Arduino and Teensy Driver
+
+Fixed capacity single-producer/single-consumer event ring used to hand
+interrupt events from a pin ISR to the main loop without disabling
+interrupts.
+
+The ISR only records that something happened (typically a micros() stamp)
+and returns; the loop pops events in batches and does the bus work:
+
+  LSM6DSOEventRing<16> imuEvents;
+
+  void imuISR() { imuEvents.push(micros()); }
+
+  void loop() {
+    uint32_t stamps[8];
+    uint8_t count = imuEvents.pop(stamps, 8);
+    if( count )
+      myIMU.fifoRead(samples, 64);
+  }
+
+push() must only be called from one context (the ISR) and pop() from one
+other context (the loop). Indices are single bytes so every load and store
+is atomic even on 8 bit AVR cores.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_RING_H__
+#define __LSM6DSO_RING_H__
+
+#include <stdint.h>
+
+// Keeps the compiler (and the core, on multi-issue parts) from reordering
+// slot accesses across index updates.
+#ifndef LSM6DSO_MEMORY_BARRIER
+  #define LSM6DSO_MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+template <uint8_t SIZE>
+class LSM6DSOEventRing
+{
+  // Free running 8 bit indices wrap cleanly only for power of two sizes.
+  static_assert(SIZE > 0 && SIZE <= 128 && (SIZE & (SIZE - 1)) == 0,
+                "LSM6DSOEventRing size must be a power of two, at most 128");
+
+  public:
+
+    LSM6DSOEventRing() : head(0), tail(0), dropCount(0), highWater(0) { }
+
+    // Producer side. Returns false and counts a drop when the ring is full.
+    bool push(uint32_t event)
+    {
+      uint8_t localHead = head;
+      uint8_t used = static_cast<uint8_t>(localHead - tail);
+
+      if( used >= SIZE ){
+        dropCount++;
+        return false;
+      }
+
+      events[localHead & (SIZE - 1)] = event;
+      LSM6DSO_MEMORY_BARRIER();
+      head = localHead + 1;
+
+      if( used + 1 > highWater )
+        highWater = used + 1;
+
+      return true;
+    }
+
+    // Consumer side. Copies up to maxEvents of the oldest events into output
+    // and returns how many were copied.
+    uint8_t pop(uint32_t output[], uint8_t maxEvents)
+    {
+      uint8_t localTail = tail;
+      uint8_t used = static_cast<uint8_t>(head - localTail);
+      LSM6DSO_MEMORY_BARRIER();
+
+      if( used > maxEvents )
+        used = maxEvents;
+
+      for( uint8_t i = 0; i < used; i++ )
+        output[i] = events[(localTail + i) & (SIZE - 1)];
+
+      LSM6DSO_MEMORY_BARRIER();
+      tail = localTail + used;
+
+      return used;
+    }
+
+    // Discards everything pending. Consumer side only.
+    void clear()
+    {
+      tail = head;
+    }
+
+    uint8_t available() const
+    {
+      return static_cast<uint8_t>(head - tail);
+    }
+
+    uint8_t capacity() const
+    {
+      return SIZE;
+    }
+
+    // Number of events lost because the ring was full. Read twice until
+    // stable since the counter is wider than a byte.
+    uint16_t getDropCount() const
+    {
+      uint16_t first;
+      uint16_t second;
+      do {
+        first = dropCount;
+        second = dropCount;
+      } while( first != second );
+      return first;
+    }
+
+    // Deepest the ring has been since construction or resetStatistics().
+    uint8_t getHighWater() const
+    {
+      return highWater;
+    }
+
+    // Consumer side; may race with a concurrent push and lose one update.
+    void resetStatistics()
+    {
+      dropCount = 0;
+      highWater = 0;
+    }
+
+  private:
+
+    volatile uint32_t events[SIZE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    volatile uint16_t dropCount;
+    volatile uint8_t highWater;
+};
+
+#endif  // End of __LSM6DSO_RING_H__ definition check
@@ -0,0 +1,306 @@
+#include "SparkFunLSM6DSO_Stream.h"
+
+#include <string.h>
+
+uint16_t lsm6dsoTicksPeriod(uint32_t firstTicks, uint32_t lastTicks, uint8_t count)
+{
+  if( count < 2 )
+    return 0;
+
+  uint32_t period = (lastTicks - firstTicks + (count - 1) / 2) / (count - 1);
+  return period > 0xFFFF ? 0xFFFF : period;
+}
+
+// Steps wander from the average by a tick of timestamp jitter, plus some
+// rounding while a frame holds only a few records; an eighth of the period
+// covers both. A lost batching slot doubles the step and ends the frame.
+// Compared over all the intervals so far, which needs no division.
+bool lsm6dsoTicksContinue(uint32_t firstTicks, uint32_t lastTicks, uint8_t count, uint32_t ticks)
+{
+  uint32_t step = ticks - lastTicks;
+  if( step > 0xFFFF )
+    return false;
+  if( count < 2 )
+    return true;
+
+  uint32_t intervals = count - 1;
+  uint32_t span = lastTicks - firstTicks;
+  uint32_t steps = step * intervals;
+  uint32_t slack = span / 8 + intervals;
+  return steps + slack >= span && steps <= span + slack;
+}
+
+//****************************************************************************//
+//
+//  Encoder
+//
+//****************************************************************************//
+
+LSM6DSOStreamEncoder::LSM6DSOStreamEncoder(Print &port) :
+  port(port),
+  count(0),
+  sequence(0),
+  accelMilliScale(0),
+  gyroMilliScale(0),
+  firstTicks(0),
+  lastTicks(0)
+{
+  pairing.gyroFresh = false;
+  pairing.accelFresh = false;
+}
+
+void LSM6DSOStreamEncoder::begin(LSM6DSO &imu)
+{
+  accelMilliScale = imu.getAccelMilliScale();
+  gyroMilliScale = imu.getGyroMilliScale();
+  count = 0;
+  sequence = 0;
+  pairing.gyroFresh = false;
+  pairing.accelFresh = false;
+}
+
+bool LSM6DSOStreamEncoder::addSample(const int16_t gyro[3], const int16_t accel[3], uint32_t ticks)
+{
+  bool written = false;
+  if( count > 0 && !lsm6dsoTicksContinue(firstTicks, lastTicks, count, ticks) ){
+    flush();
+    written = true;
+  }
+
+  if( count == 0 )
+    firstTicks = ticks;
+  lastTicks = ticks;
+
+  uint8_t *record = &frame[STREAM_HEADER_LENGTH + count * STREAM_RECORD_LENGTH];
+  for( uint8_t i = 0; i < 3; i++ ){
+    lsm6dsoPutUint16(&record[2 * i], static_cast<uint16_t>(gyro[i]));
+    lsm6dsoPutUint16(&record[6 + 2 * i], static_cast<uint16_t>(accel[i]));
+  }
+  count++;
+
+  if( count < LSM6DSO_STREAM_RECORDS )
+    return written;
+
+  flush();
+  return true;
+}
+
+uint16_t LSM6DSOStreamEncoder::addFifoWords(LSM6DSO &imu, const uint8_t words[], uint16_t numWords)
+{
+  return lsm6dsoPairFifoWords(imu, words, numWords, pairing, *this);
+}
+
+bool LSM6DSOStreamEncoder::flush()
+{
+  if( count == 0 )
+    return true;
+
+  uint16_t period = lsm6dsoTicksPeriod(firstTicks, lastTicks, count);
+
+  frame[0] = STREAM_SYNC_1;
+  frame[1] = STREAM_SYNC_2;
+  frame[2] = STREAM_VERSION;
+  frame[3] = count;
+  lsm6dsoPutUint16(&frame[4], sequence);
+  lsm6dsoPutUint32(&frame[6], accelMilliScale);
+  lsm6dsoPutUint16(&frame[10], gyroMilliScale);
+  lsm6dsoPutUint32(&frame[12], firstTicks);
+  lsm6dsoPutUint16(&frame[16], period);
+
+  uint16_t length = STREAM_HEADER_LENGTH + count * STREAM_RECORD_LENGTH;
+  lsm6dsoPutUint16(&frame[length], lsm6dsoChecksum(&frame[2], length - 2));
+  length += STREAM_CRC_LENGTH;
+
+  count = 0;
+  sequence++;
+
+  return port.write(frame, length) == length;
+}
+
+uint16_t LSM6DSOStreamEncoder::getSequence() const
+{
+  return sequence;
+}
+
+//****************************************************************************//
+//
+//  Decoder
+//
+//****************************************************************************//
+
+LSM6DSOStreamDecoder::LSM6DSOStreamDecoder()
+{
+  reset();
+}
+
+void LSM6DSOStreamDecoder::reset()
+{
+  received = 0;
+  frameReady = false;
+  pendingOffset = 0;
+  pendingLength = 0;
+  sequenceValid = false;
+  lastSequence = 0;
+  crcErrors = 0;
+  lostFrames = 0;
+  skippedBytes = 0;
+}
+
+bool LSM6DSOStreamDecoder::push(uint8_t value)
+{
+  uint16_t pending = 0;
+
+  if( frameReady ){
+    frameReady = false;
+    received = 0;
+    pending = pendingLength;
+    memmove(frame, &frame[pendingOffset], pending);
+    pendingLength = 0;
+  }
+
+  if( pending == 0 ){
+    if( !accept(value) )
+      resync();
+  }
+  else {
+    frame[pending++] = value;
+    scan(0, pending);
+  }
+
+  return frameReady;
+}
+
+uint8_t LSM6DSOStreamDecoder::getCount() const
+{
+  return frameReady ? frame[3] : 0;
+}
+
+uint16_t LSM6DSOStreamDecoder::getSequence() const
+{
+  return lastSequence;
+}
+
+bool LSM6DSOStreamDecoder::getRecord(uint8_t index, streamRecord &output) const
+{
+  if( index >= getCount() )
+    return false;
+
+  uint32_t accelMilliScale = lsm6dsoGetUint32(&frame[6]);
+  uint16_t gyroMilliScale = lsm6dsoGetUint16(&frame[10]);
+  uint32_t firstTicks = lsm6dsoGetUint32(&frame[12]);
+  uint16_t period = lsm6dsoGetUint16(&frame[16]);
+
+  output.ticks = firstTicks + static_cast<uint32_t>(index) * period;
+
+  const uint8_t *record = &frame[STREAM_HEADER_LENGTH + index * STREAM_RECORD_LENGTH];
+  for( uint8_t i = 0; i < 3; i++ ){
+    output.rawGyro[i] = static_cast<int16_t>(lsm6dsoGetUint16(&record[2 * i]));
+    output.rawAccel[i] = static_cast<int16_t>(lsm6dsoGetUint16(&record[6 + 2 * i]));
+    output.milliGyro[i] = lsm6dsoGyroMilli(output.rawGyro[i], gyroMilliScale);
+    output.milliAccel[i] = lsm6dsoAccelMilli(output.rawAccel[i], accelMilliScale);
+  }
+
+  return true;
+}
+
+uint32_t LSM6DSOStreamDecoder::getCrcErrors() const
+{
+  return crcErrors;
+}
+
+uint32_t LSM6DSOStreamDecoder::getLostFrames() const
+{
+  return lostFrames;
+}
+
+uint32_t LSM6DSOStreamDecoder::getSkippedBytes() const
+{
+  return skippedBytes;
+}
+
+uint16_t LSM6DSOStreamDecoder::frameLength() const
+{
+  return STREAM_HEADER_LENGTH + frame[3] * STREAM_RECORD_LENGTH + STREAM_CRC_LENGTH;
+}
+
+// Adds one byte to the frame being received. Returns false when that
+// frame turns out to be bad, leaving it in place for resync().
+bool LSM6DSOStreamDecoder::accept(uint8_t value)
+{
+  if( received == 0 && value != STREAM_SYNC_1 ){
+    skippedBytes++;
+    return true;
+  }
+
+  if( received == 1 && value != STREAM_SYNC_2 ){
+    skippedBytes++;
+    if( value != STREAM_SYNC_1 ){
+      skippedBytes++;
+      received = 0;
+    }
+    return true;
+  }
+
+  frame[received++] = value;
+
+  if( received == 4 ){
+    if( frame[2] != STREAM_VERSION || frame[3] == 0 || frame[3] > LSM6DSO_STREAM_RECORDS ){
+      crcErrors++;
+      return false;
+    }
+  }
+
+  if( received < 4 || received < frameLength() )
+    return true;
+
+  uint16_t length = frameLength() - STREAM_CRC_LENGTH;
+  if( lsm6dsoGetUint16(&frame[length]) != lsm6dsoChecksum(&frame[2], length - 2) ){
+    crcErrors++;
+    return false;
+  }
+
+  uint16_t sequence = lsm6dsoGetUint16(&frame[4]);
+  if( sequenceValid )
+    lostFrames += static_cast<uint16_t>(sequence - lastSequence - 1);
+  lastSequence = sequence;
+  sequenceValid = true;
+
+  frameReady = true;
+  return true;
+}
+
+// The frame that just failed may have started on a false sync word; the
+// real one can be anywhere in the bytes already received. Drop the first
+// byte and scan the rest again.
+void LSM6DSOStreamDecoder::resync()
+{
+  uint16_t length = received;
+
+  skippedBytes++;
+  received = 0;
+  scan(1, length);
+}
+
+// Feeds frame[next] to frame[length - 1] through accept(), in place: a byte
+// is only ever written back at or before where it was read. A candidate
+// that fails in turn drops its first byte and is scanned again the same
+// way, so false sync words inside false frames cost no stack. Whatever
+// follows a completed frame is kept for the next push().
+void LSM6DSOStreamDecoder::scan(uint16_t next, uint16_t length)
+{
+  while( next < length && !frameReady ){
+    if( accept(frame[next++]) )
+      continue;
+
+    // Keep the failed candidate, less its first byte, ahead of the bytes
+    // not scanned yet.
+    memmove(&frame[received], &frame[next], length - next);
+    length = received + length - next;
+    next = 1;
+    skippedBytes++;
+    received = 0;
+  }
+
+  pendingOffset = next;
+  pendingLength = length - next;
+}
@@ -0,0 +1,238 @@
+#include "Arduino.h"
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+HardwareSerial Serial;
+
+namespace {
+
+uint64_t clockNanos = 0;
+
+uint8_t pinLevels[HOST_MAX_PINS];
+void (*pinHandlers[HOST_MAX_PINS])(void);
+int pinModes[HOST_MAX_PINS];
+
+std::vector<HostClockListener *> &clockListeners()
+{
+  static std::vector<HostClockListener *> listeners;
+  return listeners;
+}
+
+std::vector<HostPinListener *> &pinListeners()
+{
+  static std::vector<HostPinListener *> listeners;
+  return listeners;
+}
+
+}
+
+//****************************************************************************//
+//
+//  Virtual clock
+//
+//****************************************************************************//
+
+uint64_t hostMicros()
+{
+  return clockNanos / 1000;
+}
+
+void hostAdvanceNanos(uint64_t nanos)
+{
+  clockNanos += nanos;
+
+  // Listeners may unregister themselves from the callback.
+  std::vector<HostClockListener *> listeners = clockListeners();
+  for( size_t i = 0; i < listeners.size(); i++ )
+    listeners[i]->onClockAdvance(hostMicros());
+}
+
+void hostAdvanceMicros(uint64_t micros)
+{
+  hostAdvanceNanos(micros * 1000);
+}
+
+unsigned long millis()
+{
+  return static_cast<unsigned long>(hostMicros() / 1000);
+}
+
+unsigned long micros()
+{
+  return static_cast<unsigned long>(hostMicros());
+}
+
+void delay(unsigned long ms)
+{
+  hostAdvanceMicros(static_cast<uint64_t>(ms) * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  hostAdvanceMicros(us);
+}
+
+void hostAddClockListener(HostClockListener *listener)
+{
+  clockListeners().push_back(listener);
+}
+
+void hostRemoveClockListener(HostClockListener *listener)
+{
+  std::vector<HostClockListener *> &listeners = clockListeners();
+  listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+}
+
+//****************************************************************************//
+//
+//  Pins and interrupts
+//
+//****************************************************************************//
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if( pin < HOST_MAX_PINS )
+    pinModes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+  if( pin < HOST_MAX_PINS )
+    pinLevels[pin] = level ? HIGH : LOW;
+
+  std::vector<HostPinListener *> listeners = pinListeners();
+  for( size_t i = 0; i < listeners.size(); i++ )
+    listeners[i]->onPinWrite(pin, level ? HIGH : LOW);
+}
+
+int digitalRead(uint8_t pin)
+{
+  if( pin >= HOST_MAX_PINS )
+    return LOW;
+
+  return pinLevels[pin];
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode)
+{
+  if( pin >= HOST_MAX_PINS )
+    return;
+
+  pinHandlers[pin] = handler;
+  pinModes[pin] = mode;
+}
+
+void detachInterrupt(uint8_t pin)
+{
+  if( pin < HOST_MAX_PINS )
+    pinHandlers[pin] = 0;
+}
+
+void interrupts() { }
+void noInterrupts() { }
+
+void hostSetPinLevel(uint8_t pin, uint8_t level)
+{
+  if( pin >= HOST_MAX_PINS )
+    return;
+
+  uint8_t previous = pinLevels[pin];
+  pinLevels[pin] = level ? HIGH : LOW;
+
+  if( pinHandlers[pin] == 0 || previous == pinLevels[pin] )
+    return;
+
+  int mode = pinModes[pin];
+  if( mode == CHANGE ||
+      (mode == RISING && pinLevels[pin] == HIGH) ||
+      (mode == FALLING && pinLevels[pin] == LOW) )
+    pinHandlers[pin]();
+}
+
+void hostAddPinListener(HostPinListener *listener)
+{
+  pinListeners().push_back(listener);
+}
+
+void hostRemovePinListener(HostPinListener *listener)
+{
+  std::vector<HostPinListener *> &listeners = pinListeners();
+  listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+}
+
+void hostReset()
+{
+  clockNanos = 0;
+  memset(pinLevels, 0, sizeof(pinLevels));
+  memset(pinHandlers, 0, sizeof(pinHandlers));
+  memset(pinModes, 0, sizeof(pinModes));
+  clockListeners().clear();
+  pinListeners().clear();
+}
+
+//****************************************************************************//
+//
+//  Print
+//
+//****************************************************************************//
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while( size-- )
+    n += write(*buffer++);
+  return n;
+}
+
+size_t Print::print(const char *str)
+{
+  return write(str);
+}
+
+size_t Print::print(char c)
+{
+  return write(static_cast<uint8_t>(c));
+}
+
+size_t Print::print(long value, int base)
+{
+  char text[24];
+  snprintf(text, sizeof(text), base == HEX ? "%lX" : "%ld", value);
+  return write(text);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  char text[24];
+  snprintf(text, sizeof(text), base == HEX ? "%lX" : "%lu", value);
+  return write(text);
+}
+
+size_t Print::print(double value, int digits)
+{
+  char text[48];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text);
+}
+
+size_t Print::println()
+{
+  return write("\r\n");
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  return fwrite(buffer, 1, size, stdout);
+}
+
+void HardwareSerial::flush()
+{
+  fflush(stdout);
+}
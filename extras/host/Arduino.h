@@ -0,0 +1,140 @@
+/******************************************************************************
+Arduino.h
+Host (Linux) stand-in for the Arduino core
+
+Just enough of the Arduino API to build the LSM6DSO driver on a desktop
+compiler. Time is virtual: millis()/micros() report a clock that only moves
+when delay(), a simulated bus transfer or hostAdvanceMicros() advances it,
+so runs are deterministic and independent of the host's speed.
+
+Anything prefixed with "host" is not part of the Arduino API; it is the
+hook used by simulated devices and benchmarks.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __ARDUINO_HOST_H__
+#define __ARDUINO_HOST_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define digitalPinToInterrupt(p) (p)
+
+#define HOST_MAX_PINS 64
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void delayMicroseconds(unsigned int);
+
+void pinMode(uint8_t, uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+int digitalRead(uint8_t);
+
+void attachInterrupt(uint8_t, void (*)(void), int);
+void detachInterrupt(uint8_t);
+void interrupts();
+void noInterrupts();
+
+class Print
+{
+  public:
+    virtual ~Print() { }
+
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+
+    size_t write(const char *str) { return write(reinterpret_cast<const uint8_t *>(str), strlen(str)); }
+
+    size_t print(const char *);
+    size_t print(char);
+    size_t print(long, int = DEC);
+    size_t print(unsigned long, int = DEC);
+    size_t print(int value, int base = DEC) { return print(static_cast<long>(value), base); }
+    size_t print(unsigned int value, int base = DEC) { return print(static_cast<unsigned long>(value), base); }
+    size_t print(double, int = 2);
+
+    size_t println();
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+// Writes to stdout.
+class HardwareSerial : public Print
+{
+  public:
+    void begin(unsigned long) { }
+    void flush();
+    operator bool() { return true; }
+
+    using Print::write;
+    size_t write(uint8_t);
+    size_t write(const uint8_t *buffer, size_t size);
+};
+
+extern HardwareSerial Serial;
+
+//****************************************************************************//
+//
+//  Host hooks
+//
+//****************************************************************************//
+
+// Notified every time the virtual clock moves forward.
+class HostClockListener
+{
+  public:
+    virtual ~HostClockListener() { }
+    virtual void onClockAdvance(uint64_t nowMicros) = 0;
+};
+
+// Notified on every digitalWrite(), e.g. to follow a chip select line.
+class HostPinListener
+{
+  public:
+    virtual ~HostPinListener() { }
+    virtual void onPinWrite(uint8_t pin, uint8_t level) = 0;
+};
+
+uint64_t hostMicros();
+void hostAdvanceMicros(uint64_t);
+void hostAdvanceNanos(uint64_t);
+
+void hostAddClockListener(HostClockListener *);
+void hostRemoveClockListener(HostClockListener *);
+void hostAddPinListener(HostPinListener *);
+void hostRemovePinListener(HostPinListener *);
+
+// Drives an input pin from the device side and dispatches any interrupt
+// handler attached to it.
+void hostSetPinLevel(uint8_t pin, uint8_t level);
+
+// Rewinds the clock to zero and forgets pins, handlers and listeners.
+void hostReset();
+
+#endif  // End of __ARDUINO_HOST_H__ definition check
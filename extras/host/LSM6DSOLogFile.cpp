@@ -0,0 +1,495 @@
+#include "LSM6DSOLogFile.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+//****************************************************************************//
+//
+//  Mapping and index
+//
+//****************************************************************************//
+
+LSM6DSOMappedFile::LSM6DSOMappedFile() : mapping(0), length(0)
+{
+}
+
+LSM6DSOMappedFile::~LSM6DSOMappedFile()
+{
+  close();
+}
+
+bool LSM6DSOMappedFile::open(const char *path)
+{
+  close();
+
+  int descriptor = ::open(path, O_RDONLY);
+  if( descriptor < 0 )
+    return false;
+
+  struct stat info;
+  bool success = fstat(descriptor, &info) == 0;
+
+  if( success && info.st_size > 0 ){
+    void *address = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if( address == MAP_FAILED )
+      success = false;
+    else {
+      // The index pass reads front to back; analysis mostly does too.
+      madvise(address, info.st_size, MADV_SEQUENTIAL);
+      mapping = static_cast<const uint8_t *>(address);
+      length = info.st_size;
+    }
+  }
+
+  ::close(descriptor);
+  return success;
+}
+
+void LSM6DSOMappedFile::close()
+{
+  if( mapping )
+    munmap(const_cast<uint8_t *>(mapping), length);
+  mapping = 0;
+  length = 0;
+}
+
+uint64_t LSM6DSOTickExtender::extend(uint32_t ticks)
+{
+  if( !valid ){
+    valid = true;
+    last = ticks;
+    return last;
+  }
+
+  last += static_cast<int32_t>(ticks - static_cast<uint32_t>(last));
+  return last;
+}
+
+void LSM6DSOSeekIndex::add(uint64_t ticks, uint64_t sample, size_t offset)
+{
+  LSM6DSOSeekPoint point = { ticks, sample, offset };
+  points.push_back(point);
+}
+
+static bool ticksBefore(uint64_t ticks, const LSM6DSOSeekPoint &point)
+{
+  return ticks < point.ticks;
+}
+
+static bool sampleBefore(uint64_t sample, const LSM6DSOSeekPoint &point)
+{
+  return sample < point.sample;
+}
+
+size_t LSM6DSOSeekIndex::findTicks(uint64_t ticks) const
+{
+  std::vector<LSM6DSOSeekPoint>::const_iterator after =
+    std::upper_bound(points.begin(), points.end(), ticks, ticksBefore);
+  return after == points.begin() ? 0 : (after - points.begin()) - 1;
+}
+
+size_t LSM6DSOSeekIndex::findSample(uint64_t sample) const
+{
+  std::vector<LSM6DSOSeekPoint>::const_iterator after =
+    std::upper_bound(points.begin(), points.end(), sample, sampleBefore);
+  return after == points.begin() ? 0 : (after - points.begin()) - 1;
+}
+
+//****************************************************************************//
+//
+//  Stream captures
+//
+//****************************************************************************//
+
+int16_t LSM6DSOStreamFile::Column::iterator::operator*() const
+{
+  const uint8_t *record = file->frame(frame) + STREAM_HEADER_LENGTH + this->record * STREAM_RECORD_LENGTH;
+  return static_cast<int16_t>(lsm6dsoGetUint16(&record[offset]));
+}
+
+LSM6DSOStreamFile::Column::iterator &LSM6DSOStreamFile::Column::iterator::operator++()
+{
+  if( ++record >= file->frameCount(frame) ){
+    frame++;
+    record = 0;
+  }
+  return *this;
+}
+
+int16_t LSM6DSOStreamFile::Column::operator[](size_t sample) const
+{
+  return *at(sample);
+}
+
+LSM6DSOStreamFile::Column::iterator LSM6DSOStreamFile::Column::at(size_t sample) const
+{
+  if( sample >= file->size() )
+    return end();
+
+  size_t frame = file->index.findSample(sample);
+  return iterator(file, frame, static_cast<uint8_t>(sample - file->index[frame].sample), offset);
+}
+
+LSM6DSOStreamFile::LSM6DSOStreamFile() : data(0), length(0), samples(0), crcErrors(0)
+{
+}
+
+bool LSM6DSOStreamFile::open(const char *path)
+{
+  if( !file.open(path) )
+    return false;
+
+  data = file.data();
+  length = file.size();
+  return build();
+}
+
+bool LSM6DSOStreamFile::open(const uint8_t data[], size_t length)
+{
+  file.close();
+  this->data = data;
+  this->length = length;
+  return build();
+}
+
+uint64_t LSM6DSOStreamFile::ticks(size_t sample) const
+{
+  if( index.size() == 0 )
+    return 0;
+
+  size_t frame = index.findSample(sample);
+  return index[frame].ticks + (sample - index[frame].sample) * framePeriod(frame);
+}
+
+size_t LSM6DSOStreamFile::findTicks(uint64_t ticks) const
+{
+  if( index.size() == 0 )
+    return 0;
+
+  size_t frame = index.findTicks(ticks);
+  const LSM6DSOSeekPoint &point = index[frame];
+  if( ticks <= point.ticks )
+    return point.sample;
+
+  uint8_t count = frameCount(frame);
+  uint16_t period = framePeriod(frame);
+  if( period == 0 )
+    return point.sample + count;
+
+  uint64_t record = (ticks - point.ticks + period - 1) / period;
+  return point.sample + std::min<uint64_t>(record, count);
+}
+
+void LSM6DSOStreamFile::record(size_t sample, streamRecord &output) const
+{
+  size_t frame = index.findSample(sample);
+  const uint8_t *header = this->frame(frame);
+  const uint8_t *record = header + STREAM_HEADER_LENGTH + (sample - index[frame].sample) * STREAM_RECORD_LENGTH;
+  uint32_t accelMilliScale = lsm6dsoGetUint32(&header[6]);
+  uint16_t gyroMilliScale = lsm6dsoGetUint16(&header[10]);
+
+  output.ticks = static_cast<uint32_t>(ticks(sample));
+  for( uint8_t i = 0; i < 3; i++ ){
+    output.rawGyro[i] = static_cast<int16_t>(lsm6dsoGetUint16(&record[2 * i]));
+    output.rawAccel[i] = static_cast<int16_t>(lsm6dsoGetUint16(&record[6 + 2 * i]));
+    output.milliGyro[i] = lsm6dsoGyroMilli(output.rawGyro[i], gyroMilliScale);
+    output.milliAccel[i] = lsm6dsoAccelMilli(output.rawAccel[i], accelMilliScale);
+  }
+}
+
+uint16_t LSM6DSOStreamFile::framePeriod(size_t i) const
+{
+  return lsm6dsoGetUint16(&frame(i)[16]);
+}
+
+// One point per frame that passes the CRC. Damaged frames and anything
+// between frames are stepped over a byte at a time, as the decoder does.
+bool LSM6DSOStreamFile::build()
+{
+  LSM6DSOTickExtender extender;
+  size_t offset = 0;
+
+  index.clear();
+  samples = 0;
+  crcErrors = 0;
+
+  while( offset + STREAM_HEADER_LENGTH + STREAM_CRC_LENGTH <= length ){
+    const uint8_t *header = &data[offset];
+    if( header[0] != STREAM_SYNC_1 || header[1] != STREAM_SYNC_2 || header[2] != STREAM_VERSION ||
+        header[3] == 0 ){
+      offset++;
+      continue;
+    }
+
+    size_t frameLength = STREAM_HEADER_LENGTH + header[3] * STREAM_RECORD_LENGTH;
+    if( offset + frameLength + STREAM_CRC_LENGTH > length ||
+        lsm6dsoGetUint16(&header[frameLength]) != lsm6dsoChecksum(&header[2], frameLength - 2) ){
+      crcErrors++;
+      offset++;
+      continue;
+    }
+
+    index.add(extender.extend(lsm6dsoGetUint32(&header[12])), samples, offset);
+    samples += header[3];
+    offset += frameLength + STREAM_CRC_LENGTH;
+  }
+
+  return index.size() > 0;
+}
+
+//****************************************************************************//
+//
+//  Compressed logs
+//
+//****************************************************************************//
+
+LSM6DSOLogFile::LSM6DSOLogFile() : data(0), length(0), samples(0), crcErrors(0)
+{
+}
+
+bool LSM6DSOLogFile::open(const char *path)
+{
+  if( !file.open(path) )
+    return false;
+
+  data = file.data();
+  length = file.size();
+  return build();
+}
+
+bool LSM6DSOLogFile::open(const uint8_t data[], size_t length)
+{
+  file.close();
+  this->data = data;
+  this->length = length;
+  return build();
+}
+
+bool LSM6DSOLogFile::seekTicks(LSM6DSOLogReader &reader, uint64_t ticks) const
+{
+  if( index.size() == 0 )
+    return false;
+
+  return reader.seek(index[index.findTicks(ticks)].offset);
+}
+
+// Block headers carry their payload length, so this hops from block to
+// block and only the CRC check reads the payloads.
+bool LSM6DSOLogFile::build()
+{
+  index.clear();
+  samples = 0;
+  crcErrors = 0;
+
+  if( length > UINT32_MAX )
+    return false;
+
+  LSM6DSOTickExtender extender;
+  LSM6DSOLogReader reader(data, length);
+  while( reader.nextBlock() ){
+    index.add(extender.extend(reader.getBlockTicks()), samples, reader.getBlockOffset());
+    samples += reader.getCount();
+  }
+  crcErrors = reader.getCrcErrors();
+
+  return index.size() > 0;
+}
+
+//****************************************************************************//
+//
+//  FIFO dumps
+//
+//****************************************************************************//
+
+LSM6DSOFifoDump::Cursor::Cursor(const LSM6DSOFifoDump &dump) : dump(dump)
+{
+  restart(SIZE_MAX);
+}
+
+void LSM6DSOFifoDump::Cursor::seekTicks(uint64_t ticks)
+{
+  const LSM6DSOSeekIndex &index = dump.getIndex();
+  restart(index.size() ? index.findTicks(ticks) : SIZE_MAX);
+}
+
+bool LSM6DSOFifoDump::Cursor::next(fifoDumpSample &output)
+{
+  while( returned >= pending ){
+    if( word >= dump.getWords() )
+      return false;
+
+    const uint8_t *data = dump.word(word++);
+    uint8_t count = (data[0] >> 1) & 0x03;
+    if( timeValid && count != tagCount )
+      slotTime += static_cast<uint64_t>((count - tagCount) & 0x03) * dump.getSlotTicks();
+    tagCount = count;
+
+    if( (data[0] >> 3) == TIMESTAMP_DATA ){
+      slotTime = extender.extend(lsm6dsoGetUint32(&data[1]));
+      timeValid = true;
+      continue;
+    }
+
+    pending = decoder.decodeFifoWordRaw(data, raw, slotsBack, sensorTag);
+    returned = 0;
+  }
+
+  output.ticks = timeValid ? slotTime - slotsBack[returned] * dump.getSlotTicks() : 0;
+  output.sensorTag = sensorTag;
+  output.raw[0] = raw[returned][0];
+  output.raw[1] = raw[returned][1];
+  output.raw[2] = raw[returned][2];
+  output.word = word - 1;
+  returned++;
+
+  return true;
+}
+
+// Starts at a seek point, or at the first word for SIZE_MAX. Seek points
+// are timestamp words, so the extender is primed with the value the point
+// was indexed under, and uncompressed words made up from the stored
+// references give compressed words after the point something to build on.
+void LSM6DSOFifoDump::Cursor::restart(size_t point)
+{
+  decoder.resetFifoDecoder();
+  extender = LSM6DSOTickExtender();
+  word = 0;
+
+  if( point != SIZE_MAX ){
+    const LSM6DSOSeekPoint &seekPoint = dump.getIndex()[point];
+    const Reference &reference = dump.references[point];
+    uint8_t made[FIFO_WORD_LENGTH];
+
+    extender.restart(seekPoint.ticks);
+    word = seekPoint.sample;
+
+    for( uint8_t sensor = 0; sensor < 2; sensor++ ){
+      const int16_t *values = sensor ? reference.accel : reference.gyro;
+      if( !(sensor ? reference.accelValid : reference.gyroValid) )
+        continue;
+      made[0] = (sensor ? ACCELEROMETER_DATA : GYROSCOPE_DATA) << 3;
+      for( uint8_t i = 0; i < 3; i++ ){
+        made[2 * i + 1] = static_cast<uint16_t>(values[i]) & 0xFF;
+        made[2 * i + 2] = static_cast<uint16_t>(values[i]) >> 8;
+      }
+      decoder.decodeFifoWordRaw(made, raw, slotsBack, sensorTag);
+    }
+  }
+
+  slotTime = 0;
+  timeValid = false;
+  tagCount = 0;
+  pending = 0;
+  returned = 0;
+}
+
+LSM6DSOFifoDump::LSM6DSOFifoDump() : data(0), words(0), slotTicks(0)
+{
+}
+
+bool LSM6DSOFifoDump::open(const char *path)
+{
+  if( !file.open(path) )
+    return false;
+
+  data = file.data();
+  words = file.size() / FIFO_WORD_LENGTH;
+  return build();
+}
+
+bool LSM6DSOFifoDump::open(const uint8_t data[], size_t length)
+{
+  file.close();
+  this->data = data;
+  words = length / FIFO_WORD_LENGTH;
+  return build();
+}
+
+// Counts batching slots by following TAG_CNT, measures their length from
+// the timestamp words, and runs the decoder alongside to note the
+// compression references at each seek point. TAG_CNT only counts to four,
+// so slots lost to an overrun go unseen: the length is taken from the
+// stretches between timestamp words that agree with their median, and a
+// gap doesn't stretch it.
+bool LSM6DSOFifoDump::build()
+{
+  LSM6DSOTickExtender extender;
+  LSM6DSO decoder;
+  Reference reference;
+  uint64_t slots = 0;
+  uint64_t lastTicks = 0, lastSlots = 0;
+  bool timestamps = false;
+  // Ticks and slots between consecutive timestamp words.
+  std::vector<std::pair<uint64_t, uint64_t> > stretches;
+  uint8_t tagCount = 0;
+
+  int16_t raw[FIFO_MAX_SAMPLES_PER_WORD][3];
+  uint8_t slotsBack[FIFO_MAX_SAMPLES_PER_WORD];
+  uint8_t sensorTag;
+
+  index.clear();
+  references.clear();
+  slotTicks = 0;
+  reference.gyroValid = false;
+  reference.accelValid = false;
+
+  for( size_t i = 0; i < words; i++ ){
+    const uint8_t *data = word(i);
+    uint8_t count = (data[0] >> 1) & 0x03;
+    if( i > 0 )
+      slots += (count - tagCount) & 0x03;
+    tagCount = count;
+
+    if( (data[0] >> 3) != TIMESTAMP_DATA ){
+      uint8_t samples = decoder.decodeFifoWordRaw(data, raw, slotsBack, sensorTag);
+      if( samples == 0 || sensorTag == TEMPERATURE_DATA )
+        continue;
+
+      int16_t *last = sensorTag == GYROSCOPE_DATA ? reference.gyro : reference.accel;
+      for( uint8_t j = 0; j < 3; j++ )
+        last[j] = raw[samples - 1][j];
+      if( sensorTag == GYROSCOPE_DATA )
+        reference.gyroValid = true;
+      else
+        reference.accelValid = true;
+      continue;
+    }
+
+    uint64_t ticks = extender.extend(lsm6dsoGetUint32(&data[1]));
+    if( timestamps && slots > lastSlots && ticks > lastTicks )
+      stretches.push_back(std::make_pair(ticks - lastTicks, slots - lastSlots));
+    timestamps = true;
+    lastTicks = ticks;
+    lastSlots = slots;
+
+    if( index.size() == 0 || i - index[index.size() - 1].sample >= LSM6DSO_FIFO_INDEX_SPACING ){
+      index.add(ticks, i, i * FIFO_WORD_LENGTH);
+      references.push_back(reference);
+    }
+  }
+
+  if( !stretches.empty() ){
+    std::vector<double> perSlot;
+    for( size_t i = 0; i < stretches.size(); i++ )
+      perSlot.push_back(static_cast<double>(stretches[i].first) / stretches[i].second);
+    std::nth_element(perSlot.begin(), perSlot.begin() + perSlot.size() / 2, perSlot.end());
+    double median = perSlot[perSlot.size() / 2];
+
+    uint64_t ticks = 0, counted = 0;
+    for( size_t i = 0; i < stretches.size(); i++ ){
+      double length = static_cast<double>(stretches[i].first) / stretches[i].second;
+      if( length > median * 0.75 && length < median * 1.25 ){
+        ticks += stretches[i].first;
+        counted += stretches[i].second;
+      }
+    }
+    slotTicks = (ticks + counted / 2) / counted;
+  }
+
+  return words > 0;
+}
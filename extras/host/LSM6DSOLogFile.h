@@ -0,0 +1,325 @@
+/******************************************************************************
+LSM6DSOLogFile.h
+Memory mapped access to recorded LSM6DSO data for offline analysis
+
+Opens recordings in place with mmap() instead of parsing text dumps:
+
+  - LSM6DSOStreamFile: captures of LSM6DSOStreamEncoder frames
+    (SparkFunLSM6DSO_Stream.h). Records are fixed size, so every axis is
+    also available as a Column that reads the mapped bytes directly.
+  - LSM6DSOLogFile: LSM6DSOLogEncoder logs (SparkFunLSM6DSO_Log.h), decoded
+    block by block straight from the mapping.
+  - LSM6DSOFifoDump: raw FIFO words as fifoReadWords() returns them, written
+    back to back. Words are read in place and decoded with the driver's own
+    FIFO decoder, compressed words included.
+
+Opening a file makes one pass over it to build a sparse seek index, one
+point per frame, per block or per LSM6DSO_FIFO_INDEX_SPACING words. After
+that, finding a time is a binary search over the index, O(log n), and never
+touches the data in between.
+
+  LSM6DSOStreamFile capture;
+  capture.open("flight.bin");
+  size_t first = capture.findTicks(startTicks);
+  size_t last = capture.findTicks(endTicks);
+  LSM6DSOStreamFile::Column az = capture.column(AXIS_ACCEL_Z);
+  for( size_t i = first; i < last; i++ ) sum += az[i];
+
+Times are sensor ticks widened to 64 bits (25us nominal, see
+LSM6DSO::ticksToNs()). Host only: needs POSIX mmap() and the C++ library.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_LOG_FILE_H__
+#define __LSM6DSO_LOG_FILE_H__
+
+#include "SparkFunLSM6DSO.h"
+#include "SparkFunLSM6DSO_Stream.h"
+#include "SparkFunLSM6DSO_Log.h"
+
+#include <stddef.h>
+#include <vector>
+
+// Words between seek points in a FIFO dump.
+#define LSM6DSO_FIFO_INDEX_SPACING 1024
+
+// Axis order of streamRecord and of the stream and log formats.
+typedef enum {
+  AXIS_GYRO_X = 0,
+  AXIS_GYRO_Y,
+  AXIS_GYRO_Z,
+  AXIS_ACCEL_X,
+  AXIS_ACCEL_Y,
+  AXIS_ACCEL_Z,
+} LSM6DSO_AXIS_t;
+
+// Read only mapping of a whole file.
+class LSM6DSOMappedFile
+{
+  public:
+
+    LSM6DSOMappedFile();
+    ~LSM6DSOMappedFile();
+
+    bool open(const char *path);
+    void close();
+
+    const uint8_t *data() const { return mapping; }
+    size_t size() const { return length; }
+
+  private:
+
+    LSM6DSOMappedFile(const LSM6DSOMappedFile &);
+    LSM6DSOMappedFile &operator=(const LSM6DSOMappedFile &);
+
+    const uint8_t *mapping;
+    size_t length;
+};
+
+// Widens 32 bit sensor ticks to 64 bits, assuming consecutive values are
+// less than 2^31 ticks (about 15 hours) apart.
+class LSM6DSOTickExtender
+{
+  public:
+
+    LSM6DSOTickExtender() : valid(false), last(0) {}
+
+    uint64_t extend(uint32_t ticks);
+    // Continues from a value extend() returned earlier.
+    void restart(uint64_t ticks) { valid = true; last = ticks; }
+
+  private:
+
+    bool valid;
+    uint64_t last;
+};
+
+struct LSM6DSOSeekPoint {
+  uint64_t ticks;     // time of the first sample after offset
+  uint64_t sample;    // samples before offset
+  size_t offset;      // byte offset in the file
+};
+
+// Points in file order; ticks and sample numbers must not decrease.
+class LSM6DSOSeekIndex
+{
+  public:
+
+    void clear() { points.clear(); }
+    void add(uint64_t ticks, uint64_t sample, size_t offset);
+
+    size_t size() const { return points.size(); }
+    const LSM6DSOSeekPoint &operator[](size_t i) const { return points[i]; }
+
+    // Last point at or before ticks / holding sample, or 0 if the first
+    // point is already later.
+    size_t findTicks(uint64_t ticks) const;
+    size_t findSample(uint64_t sample) const;
+
+  private:
+
+    std::vector<LSM6DSOSeekPoint> points;
+};
+
+class LSM6DSOStreamFile
+{
+  public:
+
+    // One axis of every sample in the file, in raw counts.
+    class Column
+    {
+      public:
+
+        class iterator
+        {
+          public:
+
+            iterator(const LSM6DSOStreamFile *file, size_t frame, uint8_t record, uint8_t offset) :
+              file(file), frame(frame), record(record), offset(offset) {}
+
+            int16_t operator*() const;
+            iterator &operator++();
+            bool operator==(const iterator &other) const { return frame == other.frame && record == other.record; }
+            bool operator!=(const iterator &other) const { return !(*this == other); }
+
+          private:
+
+            const LSM6DSOStreamFile *file;
+            size_t frame;
+            uint8_t record;
+            uint8_t offset;
+        };
+
+        Column(const LSM6DSOStreamFile *file, uint8_t offset) : file(file), offset(offset) {}
+
+        size_t size() const { return file->size(); }
+        // O(log frames); iterate for whole runs.
+        int16_t operator[](size_t sample) const;
+
+        iterator begin() const { return iterator(file, 0, 0, offset); }
+        iterator end() const { return iterator(file, file->index.size(), 0, offset); }
+        // Iterator at a sample, for ranges from findTicks().
+        iterator at(size_t sample) const;
+
+      private:
+
+        const LSM6DSOStreamFile *file;
+        uint8_t offset;
+    };
+
+    LSM6DSOStreamFile();
+
+    bool open(const char *path);
+    // Indexes a capture already in memory. The buffer must outlive this.
+    bool open(const uint8_t data[], size_t length);
+
+    size_t size() const { return samples; }
+    size_t getFrames() const { return index.size(); }
+    uint32_t getCrcErrors() const { return crcErrors; }
+    const LSM6DSOSeekIndex &getIndex() const { return index; }
+
+    Column column(LSM6DSO_AXIS_t axis) const { return Column(this, 2 * axis); }
+    uint64_t ticks(size_t sample) const;
+    // First sample at or after ticks; size() if there is none.
+    size_t findTicks(uint64_t ticks) const;
+    void record(size_t sample, streamRecord &output) const;
+
+  private:
+
+    friend class Column;
+
+    bool build();
+    const uint8_t *frame(size_t i) const { return data + index[i].offset; }
+    uint8_t frameCount(size_t i) const { return data[index[i].offset + 3]; }
+    uint16_t framePeriod(size_t i) const;
+
+    LSM6DSOMappedFile file;
+    const uint8_t *data;
+    size_t length;
+
+    LSM6DSOSeekIndex index;
+    size_t samples;
+    uint32_t crcErrors;
+};
+
+class LSM6DSOLogFile
+{
+  public:
+
+    LSM6DSOLogFile();
+
+    // LSM6DSOLogReader offsets are 32 bit, so logs stop at 4GB, over a
+    // week of samples at 1660Hz.
+    bool open(const char *path);
+    bool open(const uint8_t data[], size_t length);
+
+    size_t size() const { return samples; }
+    size_t getBlocks() const { return index.size(); }
+    uint32_t getCrcErrors() const { return crcErrors; }
+    const LSM6DSOSeekIndex &getIndex() const { return index; }
+
+    // A reader over the mapping, at the start or at the block holding
+    // ticks.
+    LSM6DSOLogReader reader() const { return LSM6DSOLogReader(data, length); }
+    bool seekTicks(LSM6DSOLogReader &reader, uint64_t ticks) const;
+
+  private:
+
+    bool build();
+
+    LSM6DSOMappedFile file;
+    const uint8_t *data;
+    size_t length;
+
+    LSM6DSOSeekIndex index;
+    size_t samples;
+    uint32_t crcErrors;
+};
+
+// One sample decoded from a FIFO dump.
+struct fifoDumpSample {
+public:
+  uint64_t ticks;       // zero before the first timestamp word
+  uint8_t sensorTag;    // GYROSCOPE_DATA, ACCELEROMETER_DATA or TEMPERATURE_DATA
+  int16_t raw[3];
+  size_t word;          // word it came from
+};
+
+// Seek points of a dump count words, not samples: sample is the word
+// index and ticks the timestamp word found there.
+class LSM6DSOFifoDump
+{
+  public:
+
+    // Walks the words in place, dating samples from the timestamp words
+    // and TAG_CNT the same way LSM6DSO::getFifoSampleTicks() does.
+    class Cursor
+    {
+      public:
+
+        Cursor(const LSM6DSOFifoDump &dump);
+
+        // To the seek point before ticks.
+        void seekTicks(uint64_t ticks);
+        bool next(fifoDumpSample &output);
+
+      private:
+
+        void restart(size_t point);
+
+        const LSM6DSOFifoDump &dump;
+        LSM6DSO decoder;
+        LSM6DSOTickExtender extender;
+        size_t word;
+        uint64_t slotTime;
+        bool timeValid;
+        uint8_t tagCount;
+
+        // Samples of the last word not yet returned.
+        int16_t raw[FIFO_MAX_SAMPLES_PER_WORD][3];
+        uint8_t slotsBack[FIFO_MAX_SAMPLES_PER_WORD];
+        uint8_t sensorTag;
+        uint8_t pending;
+        uint8_t returned;
+    };
+
+    LSM6DSOFifoDump();
+
+    bool open(const char *path);
+    bool open(const uint8_t data[], size_t length);
+
+    size_t getWords() const { return words; }
+    const uint8_t *word(size_t i) const { return data + i * FIFO_WORD_LENGTH; }
+    uint8_t tag(size_t i) const { return data[i * FIFO_WORD_LENGTH] >> 3; }
+
+    // Length of a batching slot, measured from the timestamp words; zero
+    // if the dump has fewer than two.
+    uint32_t getSlotTicks() const { return slotTicks; }
+    const LSM6DSOSeekIndex &getIndex() const { return index; }
+
+  private:
+
+    // Last sample of each sensor before a seek point, the reference the
+    // next compressed word builds on.
+    struct Reference {
+      int16_t gyro[3];
+      int16_t accel[3];
+      bool gyroValid;
+      bool accelValid;
+    };
+
+    bool build();
+
+    LSM6DSOMappedFile file;
+    const uint8_t *data;
+    size_t words;
+
+    LSM6DSOSeekIndex index;
+    std::vector<Reference> references;
+    uint32_t slotTicks;
+};
+
+#endif  // End of __LSM6DSO_LOG_FILE_H__ definition check
@@ -0,0 +1,1067 @@
+#include "LSM6DSOSimulator.h"
+
+namespace {
+
+// Main bank
+const uint8_t REG_FUNC_CFG_ACCESS    = 0x01;
+const uint8_t REG_FIFO_CTRL1         = 0x07;
+const uint8_t REG_FIFO_CTRL2         = 0x08;
+const uint8_t REG_FIFO_CTRL3         = 0x09;
+const uint8_t REG_FIFO_CTRL4         = 0x0A;
+const uint8_t REG_COUNTER_BDR_REG1   = 0x0B;
+const uint8_t REG_COUNTER_BDR_REG2   = 0x0C;
+const uint8_t REG_INT1_CTRL          = 0x0D;
+const uint8_t REG_INT2_CTRL          = 0x0E;
+const uint8_t REG_WHO_AM_I           = 0x0F;
+const uint8_t REG_CTRL1_XL           = 0x10;
+const uint8_t REG_CTRL2_G            = 0x11;
+const uint8_t REG_CTRL3_C            = 0x12;
+const uint8_t REG_CTRL6_C            = 0x15;
+const uint8_t REG_CTRL7_G            = 0x16;
+const uint8_t REG_CTRL8_XL           = 0x17;
+const uint8_t REG_CTRL10_C           = 0x19;
+const uint8_t REG_STATUS             = 0x1E;
+const uint8_t REG_OUT_TEMP_L         = 0x20;
+const uint8_t REG_OUTX_L_G           = 0x22;
+const uint8_t REG_OUTX_L_A           = 0x28;
+const uint8_t REG_OUTZ_H_A           = 0x2D;
+const uint8_t REG_FIFO_STATUS1       = 0x3A;
+const uint8_t REG_FIFO_STATUS2       = 0x3B;
+const uint8_t REG_TIMESTAMP0         = 0x40;
+const uint8_t REG_TIMESTAMP2         = 0x42;
+const uint8_t REG_TIMESTAMP3         = 0x43;
+const uint8_t REG_INTERNAL_FREQ_FINE = 0x63;
+const uint8_t REG_X_OFS_USR          = 0x73;
+const uint8_t REG_FIFO_DATA_OUT_TAG  = 0x78;
+const uint8_t REG_FIFO_DATA_OUT_Z_H  = 0x7E;
+
+// Embedded bank
+const uint8_t EMB_PAGE_SEL           = 0x02;
+const uint8_t EMB_FUNC_EN_B          = 0x05;
+const uint8_t EMB_PAGE_ADDRESS       = 0x08;
+const uint8_t EMB_PAGE_VALUE         = 0x09;
+const uint8_t EMB_PAGE_RW            = 0x17;
+
+// FIFO tags
+const uint8_t TAG_GYRO               = 0x01;
+const uint8_t TAG_ACCEL              = 0x02;
+const uint8_t TAG_TEMPERATURE        = 0x03;
+const uint8_t TAG_TIMESTAMP          = 0x04;
+const uint8_t TAG_ACCEL_T_2          = 0x06;
+const uint8_t TAG_ACCEL_T_1          = 0x07;
+const uint8_t TAG_ACCEL_2xC          = 0x08;
+const uint8_t TAG_ACCEL_3xC          = 0x09;
+const uint8_t TAG_GYRO_T_2           = 0x0A;
+const uint8_t TAG_GYRO_T_1           = 0x0B;
+const uint8_t TAG_GYRO_2xC           = 0x0C;
+const uint8_t TAG_GYRO_3xC           = 0x0D;
+
+// ODR_XL/ODR_G and BDR_XL/BDR_GY codes 1-10; code 11 is 1.6Hz for the
+// accelerometer and 6.5Hz for the gyroscope batch rate.
+const double RATE_TABLE[11] = { 0, 12.5, 26, 52, 104, 208, 416, 833, 1667, 3333, 6667 };
+
+const double NEVER = 1e300;
+
+const uint8_t TIMESTAMP_DUE = 0xFF;
+
+void defaultMotion(double seconds, SimMotion &motion)
+{
+  motion.accel[0] = 0.02 * sin(2 * M_PI * 0.5 * seconds);
+  motion.accel[1] = -0.01;
+  motion.accel[2] = 1.0;
+  motion.gyro[0] = 2.0 * sin(2 * M_PI * 1.0 * seconds);
+  motion.gyro[1] = -1.5;
+  motion.gyro[2] = 30.0;
+  motion.temperatureC = 27.5;
+}
+
+double rateFromCode(uint8_t code, double code11)
+{
+  if( code == 11 )
+    return code11;
+  if( code > 10 )
+    return 0;
+  return RATE_TABLE[code];
+}
+
+}
+
+LSM6DSOSimulator::LSM6DSOSimulator()
+{
+  motion = defaultMotion;
+  freqFine = 0;
+  fifoCapacity = 512;
+
+  int1Pin = -1;
+  int2Pin = -1;
+  int1Level = false;
+  int2Level = false;
+
+  wirePort = 0;
+  wireAddress = 0;
+  spiPort = 0;
+  spiCsPin = 0;
+
+  memset(pages, 0, sizeof(pages));
+
+  currentMicros = hostMicros();
+  powerOnReset();
+  resetStatistics();
+
+  hostAddClockListener(this);
+}
+
+LSM6DSOSimulator::~LSM6DSOSimulator()
+{
+  hostRemoveClockListener(this);
+
+  if( wirePort != 0 )
+    wirePort->detachDevice(wireAddress);
+  if( spiPort != 0 )
+    spiPort->detachDevice(spiCsPin);
+}
+
+void LSM6DSOSimulator::attach(TwoWire &wire, uint8_t address)
+{
+  wirePort = &wire;
+  wireAddress = address;
+  wire.attachDevice(address, this);
+}
+
+void LSM6DSOSimulator::attachSPI(SPIClass &spi, uint8_t csPin)
+{
+  spiPort = &spi;
+  spiCsPin = csPin;
+  spi.attachDevice(csPin, this);
+}
+
+void LSM6DSOSimulator::connectInterrupts(int int1, int int2)
+{
+  int1Pin = int1;
+  int2Pin = int2;
+  updateInterrupts();
+}
+
+void LSM6DSOSimulator::setMotion(MotionFunction newMotion)
+{
+  motion = newMotion;
+}
+
+void LSM6DSOSimulator::setInternalFreqFine(int8_t trim)
+{
+  freqFine = trim;
+  regs[REG_INTERNAL_FREQ_FINE] = static_cast<uint8_t>(trim);
+  reschedule();
+}
+
+void LSM6DSOSimulator::setFifoCapacity(uint16_t words)
+{
+  fifoCapacity = words;
+}
+
+void LSM6DSOSimulator::resetStatistics()
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+uint8_t LSM6DSOSimulator::peekRegister(uint8_t address) const
+{
+  return regs[address & 0x7F];
+}
+
+uint8_t LSM6DSOSimulator::peekEmbedded(uint8_t address) const
+{
+  return embedded[address & 0x7F];
+}
+
+void LSM6DSOSimulator::pokeEmbedded(uint8_t address, uint8_t value)
+{
+  embedded[address & 0x7F] = value;
+}
+
+uint8_t LSM6DSOSimulator::peekPage(uint8_t page, uint8_t address) const
+{
+  return pages[page & 0x0F][address];
+}
+
+void LSM6DSOSimulator::pokePage(uint8_t page, uint8_t address, uint8_t value)
+{
+  pages[page & 0x0F][address] = value;
+}
+
+//****************************************************************************//
+//
+//  Reset and scheduling
+//
+//****************************************************************************//
+
+void LSM6DSOSimulator::resetRegisters()
+{
+  memset(regs, 0, sizeof(regs));
+  memset(embedded, 0, sizeof(embedded));
+
+  regs[REG_WHO_AM_I] = 0x6C;
+  regs[REG_CTRL3_C] = 0x04;   // IF_INC
+  regs[REG_INTERNAL_FREQ_FINE] = static_cast<uint8_t>(freqFine);
+  embedded[EMB_PAGE_SEL] = 0x01;
+
+  fifo.clear();
+  overrunLatched = false;
+  counterFlag = false;
+  batchCounter = 0;
+
+  memset(&accelCompressor, 0, sizeof(accelCompressor));
+  memset(&gyroCompressor, 0, sizeof(gyroCompressor));
+
+  for( uint8_t i = 0; i < 7; i++ ){
+    outputLocked[i] = false;
+    pendingOutput[i] = 0;
+  }
+  accelUnread = false;
+  gyroUnread = false;
+
+  slotCounter = 0;
+  slotsSinceTimestamp = TIMESTAMP_DUE;
+  lastSlotTime = -1;
+
+  timestampZero = now();
+  timestampFrozen = 0;
+  memset(timestampLatch, 0, sizeof(timestampLatch));
+
+  pointer = 0;
+  spiSelected = false;
+  spiAddressPhase = false;
+  spiRead = false;
+}
+
+void LSM6DSOSimulator::powerOnReset()
+{
+  resetRegisters();
+  reschedule();
+  updateInterrupts();
+}
+
+double LSM6DSOSimulator::now() const
+{
+  return static_cast<double>(currentMicros) / 1e6;
+}
+
+double LSM6DSOSimulator::trim() const
+{
+  return 1.0 + 0.0015 * freqFine;
+}
+
+double LSM6DSOSimulator::accelOdr() const
+{
+  // 1.6Hz is a low power rate; high performance mode runs it at 12.5Hz.
+  double lowest = (regs[REG_CTRL6_C] & 0x10) ? 1.6 : 12.5;
+  return rateFromCode(regs[REG_CTRL1_XL] >> 4, lowest) * trim();
+}
+
+double LSM6DSOSimulator::gyroOdr() const
+{
+  uint8_t code = regs[REG_CTRL2_G] >> 4;
+  return code == 11 ? 0 : rateFromCode(code, 0) * trim();
+}
+
+double LSM6DSOSimulator::accelBdr() const
+{
+  return rateFromCode(regs[REG_FIFO_CTRL3] & 0x0F, 1.6) * trim();
+}
+
+double LSM6DSOSimulator::gyroBdr() const
+{
+  return rateFromCode(regs[REG_FIFO_CTRL3] >> 4, 6.5) * trim();
+}
+
+double LSM6DSOSimulator::temperatureBdr() const
+{
+  switch( (regs[REG_FIFO_CTRL4] >> 4) & 0x03 ){
+    case 1:
+      return 1.6 * trim();
+    case 2:
+      return 12.5 * trim();
+    case 3:
+      return 52 * trim();
+    default:
+      return 0;
+  }
+}
+
+// Next event at the given rate, aligned to the rate's own grid so that a
+// reconfiguration doesn't introduce phase jumps between sensors.
+static double nextTick(double seconds, double rate)
+{
+  if( rate <= 0 )
+    return NEVER;
+
+  return (floor(seconds * rate) + 1) / rate;
+}
+
+void LSM6DSOSimulator::reschedule()
+{
+  double t = now();
+  bool fifoOn = (regs[REG_FIFO_CTRL4] & 0x07) != 0;
+
+  nextAccel = nextTick(t, accelOdr());
+  nextGyro = nextTick(t, gyroOdr());
+  nextAccelBatch = fifoOn && accelOdr() > 0 ? nextTick(t, accelBdr()) : NEVER;
+  nextGyroBatch = fifoOn && gyroOdr() > 0 ? nextTick(t, gyroBdr()) : NEVER;
+  nextTemperatureBatch = fifoOn ? nextTick(t, temperatureBdr()) : NEVER;
+}
+
+//****************************************************************************//
+//
+//  Time stepping
+//
+//****************************************************************************//
+
+void LSM6DSOSimulator::onClockAdvance(uint64_t nowMicros)
+{
+  update(nowMicros);
+}
+
+void LSM6DSOSimulator::update(uint64_t nowMicros)
+{
+  if( nowMicros <= currentMicros )
+    return;
+
+  double target = static_cast<double>(nowMicros) / 1e6;
+
+  while( true ){
+
+    double next = nextAccel;
+    if( nextGyro < next )
+      next = nextGyro;
+    if( nextAccelBatch < next )
+      next = nextAccelBatch;
+    if( nextGyroBatch < next )
+      next = nextGyroBatch;
+    if( nextTemperatureBatch < next )
+      next = nextTemperatureBatch;
+
+    if( next > target )
+      break;
+
+    if( next == nextAccel ){
+      sampleAccel(next);
+      nextAccel += 1.0 / accelOdr();
+    }
+    if( next == nextGyro ){
+      sampleGyro(next);
+      nextGyro += 1.0 / gyroOdr();
+    }
+    if( next == nextGyroBatch ){
+      SimMotion m;
+      motion(next, m);
+      int16_t raw[3];
+      for( uint8_t i = 0; i < 3; i++ )
+        raw[i] = toRaw(m.gyro[i], gyroSensitivity());
+      batch(TAG_GYRO, next, raw);
+      nextGyroBatch += 1.0 / gyroBdr();
+    }
+    if( next == nextAccelBatch ){
+      SimMotion m;
+      motion(next, m);
+      int16_t raw[3];
+      for( uint8_t i = 0; i < 3; i++ )
+        raw[i] = accelToRaw(m.accel[i], i);
+      batch(TAG_ACCEL, next, raw);
+      nextAccelBatch += 1.0 / accelBdr();
+    }
+    if( next == nextTemperatureBatch ){
+      SimMotion m;
+      motion(next, m);
+      int16_t raw[3] = { static_cast<int16_t>((m.temperatureC - 25.0) * 256.0), 0, 0 };
+      batch(TAG_TEMPERATURE, next, raw);
+      nextTemperatureBatch += 1.0 / temperatureBdr();
+    }
+  }
+
+  currentMicros = nowMicros;
+  updateInterrupts();
+}
+
+double LSM6DSOSimulator::accelSensitivity() const
+{
+  bool newMode = (regs[REG_CTRL8_XL] & 0x02) != 0;
+
+  switch( (regs[REG_CTRL1_XL] >> 2) & 0x03 ){
+    case 0:
+      return 0.061e-3;
+    case 1:
+      return newMode ? 0.061e-3 : 0.488e-3;
+    case 2:
+      return 0.122e-3;
+    default:
+      return 0.244e-3;
+  }
+}
+
+double LSM6DSOSimulator::gyroSensitivity() const
+{
+  if( regs[REG_CTRL2_G] & 0x02 )
+    return 4.375e-3;
+
+  switch( (regs[REG_CTRL2_G] >> 2) & 0x03 ){
+    case 0:
+      return 8.75e-3;
+    case 1:
+      return 17.5e-3;
+    case 2:
+      return 35e-3;
+    default:
+      return 70e-3;
+  }
+}
+
+int16_t LSM6DSOSimulator::toRaw(double value, double sensitivity) const
+{
+  double raw = floor(value / sensitivity + 0.5);
+  if( raw > 32767 )
+    raw = 32767;
+  if( raw < -32768 )
+    raw = -32768;
+  return static_cast<int16_t>(raw);
+}
+
+// USR_OFF_ON_OUT: the user offset, weighted by USR_OFF_W, is subtracted
+// before the data reaches the output registers and the FIFO.
+int16_t LSM6DSOSimulator::accelToRaw(double value, uint8_t axis) const
+{
+  if( regs[REG_CTRL7_G] & 0x02 ){
+    double offsetWeight = (regs[REG_CTRL6_C] & 0x08) ? 1.0 / 64 : 1.0 / 1024;
+    value -= static_cast<int8_t>(regs[REG_X_OFS_USR + axis]) * offsetWeight;
+  }
+
+  return toRaw(value, accelSensitivity());
+}
+
+void LSM6DSOSimulator::sampleAccel(double seconds)
+{
+  SimMotion m;
+  motion(seconds, m);
+
+  for( uint8_t i = 0; i < 3; i++ )
+    pendingOutput[4 + i] = accelToRaw(m.accel[i], i);
+  pendingOutput[0] = static_cast<int16_t>((m.temperatureC - 25.0) * 256.0);
+
+  bool bdu = (regs[REG_CTRL3_C] & 0x40) != 0;
+  for( uint8_t pair = 4; pair < 7; pair++ ){
+    if( bdu && outputLocked[pair] )
+      continue;
+    regs[REG_OUT_TEMP_L + 2 * pair] = pendingOutput[pair] & 0xFF;
+    regs[REG_OUT_TEMP_L + 2 * pair + 1] = (pendingOutput[pair] >> 8) & 0xFF;
+  }
+
+  stats.accelSamples++;
+  if( accelUnread )
+    stats.accelMissed++;
+  accelUnread = true;
+  regs[REG_STATUS] |= 0x01;
+
+  sampleTemperature(seconds);
+}
+
+void LSM6DSOSimulator::sampleGyro(double seconds)
+{
+  SimMotion m;
+  motion(seconds, m);
+
+  for( uint8_t i = 0; i < 3; i++ )
+    pendingOutput[1 + i] = toRaw(m.gyro[i], gyroSensitivity());
+  pendingOutput[0] = static_cast<int16_t>((m.temperatureC - 25.0) * 256.0);
+
+  bool bdu = (regs[REG_CTRL3_C] & 0x40) != 0;
+  for( uint8_t pair = 1; pair < 4; pair++ ){
+    if( bdu && outputLocked[pair] )
+      continue;
+    regs[REG_OUT_TEMP_L + 2 * pair] = pendingOutput[pair] & 0xFF;
+    regs[REG_OUT_TEMP_L + 2 * pair + 1] = (pendingOutput[pair] >> 8) & 0xFF;
+  }
+
+  stats.gyroSamples++;
+  if( gyroUnread )
+    stats.gyroMissed++;
+  gyroUnread = true;
+  regs[REG_STATUS] |= 0x02;
+
+  sampleTemperature(seconds);
+}
+
+void LSM6DSOSimulator::sampleTemperature(double seconds)
+{
+  (void)seconds;
+
+  if( (regs[REG_CTRL3_C] & 0x40) && outputLocked[0] )
+    return;
+
+  regs[REG_OUT_TEMP_L] = pendingOutput[0] & 0xFF;
+  regs[REG_OUT_TEMP_L + 1] = (pendingOutput[0] >> 8) & 0xFF;
+  regs[REG_STATUS] |= 0x04;
+}
+
+//****************************************************************************//
+//
+//  FIFO
+//
+//****************************************************************************//
+
+bool LSM6DSOSimulator::fifoStopsWhenFull() const
+{
+  uint8_t mode = regs[REG_FIFO_CTRL4] & 0x07;
+  return mode == 1 || mode == 7;
+}
+
+bool LSM6DSOSimulator::compressionEnabled() const
+{
+  return (regs[REG_FIFO_CTRL2] & 0x40) && (embedded[EMB_FUNC_EN_B] & 0x08);
+}
+
+uint16_t LSM6DSOSimulator::watermark() const
+{
+  return regs[REG_FIFO_CTRL1] | ((regs[REG_FIFO_CTRL2] & 0x01) << 8);
+}
+
+uint32_t LSM6DSOSimulator::timestampTicks(double seconds) const
+{
+  if( !(regs[REG_CTRL10_C] & 0x20) )
+    return timestampFrozen;
+
+  double ticks = (seconds - timestampZero) * 40000.0 * trim();
+  return timestampFrozen + static_cast<uint32_t>(static_cast<uint64_t>(ticks));
+}
+
+// A new batching time slot bumps TAG_CNT and, if timestamp batching is on,
+// is preceded by a TIMESTAMP word every 1, 8 or 32 slots.
+void LSM6DSOSimulator::startSlot(double seconds)
+{
+  // Accelerometer and gyroscope batches of the same slot can land a few
+  // rounding errors apart.
+  if( fabs(seconds - lastSlotTime) < 1e-7 )
+    return;
+
+  lastSlotTime = seconds;
+  slotCounter++;
+
+  uint8_t decimation = 0;
+  switch( regs[REG_FIFO_CTRL4] >> 6 ){
+    case 1:
+      decimation = 1;
+      break;
+    case 2:
+      decimation = 8;
+      break;
+    case 3:
+      decimation = 32;
+      break;
+  }
+
+  if( decimation == 0 || !(regs[REG_CTRL10_C] & 0x20) )
+    return;
+
+  // The first slot after the FIFO or the counter starts always carries one.
+  if( slotsSinceTimestamp != TIMESTAMP_DUE && ++slotsSinceTimestamp < decimation )
+    return;
+
+  slotsSinceTimestamp = 0;
+
+  uint32_t ticks = timestampTicks(seconds);
+  uint8_t data[6] = { static_cast<uint8_t>(ticks), static_cast<uint8_t>(ticks >> 8),
+                      static_cast<uint8_t>(ticks >> 16), static_cast<uint8_t>(ticks >> 24), 0, 0 };
+  pushWord(TAG_TIMESTAMP, data);
+}
+
+void LSM6DSOSimulator::batch(uint8_t tag, double seconds, const int16_t raw[])
+{
+  if( (regs[REG_FIFO_CTRL4] & 0x07) == 0 )
+    return;
+
+  startSlot(seconds);
+
+  // COUNTER_BDR_REG1 TRIG_COUNTER_BDR picks the sensor that is counted.
+  bool gyroTrigger = (regs[REG_COUNTER_BDR_REG1] & 0x20) != 0;
+  uint16_t threshold = ((regs[REG_COUNTER_BDR_REG1] & 0x07) << 8) | regs[REG_COUNTER_BDR_REG2];
+  if( threshold != 0 && tag == (gyroTrigger ? TAG_GYRO : TAG_ACCEL) ){
+    if( ++batchCounter >= threshold ){
+      batchCounter = 0;
+      counterFlag = true;
+      if( counterPulsed() )
+        pulseCounter();
+    }
+  }
+
+  if( tag == TAG_TEMPERATURE || !compressionEnabled() ){
+    pushWord(tag, raw);
+    return;
+  }
+
+  if( tag == TAG_ACCEL )
+    compress(accelCompressor, TAG_ACCEL, raw);
+  else
+    compress(gyroCompressor, TAG_GYRO, raw);
+}
+
+static bool fits(const int16_t *from, const int16_t *to, int16_t limit)
+{
+  for( uint8_t i = 0; i < 3; i++ ){
+    int32_t diff = static_cast<int32_t>(to[i]) - from[i];
+    if( diff < -limit || diff > limit - 1 )
+      return false;
+  }
+  return true;
+}
+
+// Simplified compression: samples are held back until three are pending,
+// then packed as 3xC (5 bit differences) or 2xC (8 bit differences) when
+// they fit, uncompressed otherwise. UNCOPTR_RATE forces an uncompressed
+// word every 8, 16 or 32 batches.
+void LSM6DSOSimulator::compress(Compressor &state, uint8_t baseTag, const int16_t raw[])
+{
+  uint8_t forcedRate = 0;
+  switch( (regs[REG_FIFO_CTRL2] >> 1) & 0x03 ){
+    case 1:
+      forcedRate = 8;
+      break;
+    case 2:
+      forcedRate = 16;
+      break;
+    case 3:
+      forcedRate = 32;
+      break;
+  }
+
+  state.sinceUncompressed++;
+  bool forced = forcedRate != 0 && state.sinceUncompressed >= forcedRate;
+
+  bool accel = baseTag == TAG_ACCEL;
+
+  // Held back samples are one or two slots old by the time they're written.
+  if( !state.referenceValid || forced ){
+    for( uint8_t i = 0; i < state.numPending; i++ ){
+      if( state.numPending - i == 2 )
+        pushWord(accel ? TAG_ACCEL_T_2 : TAG_GYRO_T_2, state.pending[i]);
+      else
+        pushWord(accel ? TAG_ACCEL_T_1 : TAG_GYRO_T_1, state.pending[i]);
+    }
+    state.numPending = 0;
+
+    pushWord(baseTag, raw);
+    memcpy(state.reference, raw, sizeof(state.reference));
+    state.referenceValid = true;
+    state.sinceUncompressed = 0;
+    return;
+  }
+
+  memcpy(state.pending[state.numPending++], raw, sizeof(state.pending[0]));
+  if( state.numPending < 3 )
+    return;
+
+  const int16_t *previous = state.reference;
+  bool threeFit = true;
+  for( uint8_t i = 0; i < 3; i++ ){
+    if( !fits(previous, state.pending[i], 16) )
+      threeFit = false;
+    previous = state.pending[i];
+  }
+
+  uint8_t data[6];
+
+  if( threeFit ){
+    previous = state.reference;
+    for( uint8_t i = 0; i < 3; i++ ){
+      uint16_t packed = 0;
+      for( uint8_t j = 0; j < 3; j++ )
+        packed |= ((state.pending[i][j] - previous[j]) & 0x1F) << (5 * j);
+      data[2 * i] = packed & 0xFF;
+      data[2 * i + 1] = packed >> 8;
+      previous = state.pending[i];
+    }
+    pushWord(accel ? TAG_ACCEL_3xC : TAG_GYRO_3xC, data);
+    memcpy(state.reference, state.pending[2], sizeof(state.reference));
+    state.numPending = 0;
+    return;
+  }
+
+  if( fits(state.reference, state.pending[0], 128) && fits(state.pending[0], state.pending[1], 128) ){
+    for( uint8_t j = 0; j < 3; j++ ){
+      data[j] = static_cast<uint8_t>(state.pending[0][j] - state.reference[j]);
+      data[3 + j] = static_cast<uint8_t>(state.pending[1][j] - state.pending[0][j]);
+    }
+    pushWord(accel ? TAG_ACCEL_2xC : TAG_GYRO_2xC, data);
+    memcpy(state.reference, state.pending[1], sizeof(state.reference));
+  }
+  else {
+    pushWord(accel ? TAG_ACCEL_T_2 : TAG_GYRO_T_2, state.pending[0]);
+    memcpy(state.reference, state.pending[0], sizeof(state.reference));
+    memmove(state.pending[0], state.pending[1], sizeof(state.pending[0]));
+    memmove(state.pending[1], state.pending[2], sizeof(state.pending[0]));
+    state.numPending = 2;
+    return;
+  }
+
+  memmove(state.pending[0], state.pending[2], sizeof(state.pending[0]));
+  state.numPending = 1;
+}
+
+void LSM6DSOSimulator::pushWord(uint8_t tag, const int16_t raw[])
+{
+  uint8_t data[6];
+  for( uint8_t i = 0; i < 3; i++ ){
+    data[2 * i] = raw[i] & 0xFF;
+    data[2 * i + 1] = (raw[i] >> 8) & 0xFF;
+  }
+  pushWord(tag, data);
+}
+
+void LSM6DSOSimulator::pushWord(uint8_t tag, const uint8_t data[])
+{
+  FifoWord word;
+
+  // TAG_SENSOR[7:3], TAG_CNT[2:1], TAG_PARITY[0] (odd parity over the tag).
+  uint8_t tagByte = (tag << 3) | ((slotCounter & 0x03) << 1);
+  uint8_t ones = 0;
+  for( uint8_t bit = 1; bit < 8; bit++ )
+    ones += (tagByte >> bit) & 0x01;
+  if( (ones & 0x01) == 0 )
+    tagByte |= 0x01;
+
+  word.bytes[0] = tagByte;
+  memcpy(&word.bytes[1], data, 6);
+
+  if( fifo.size() >= fifoCapacity ){
+    stats.fifoOverruns++;
+    overrunLatched = true;
+    if( fifoStopsWhenFull() )
+      return;
+    fifo.pop_front();
+  }
+
+  fifo.push_back(word);
+  stats.fifoWords++;
+}
+
+void LSM6DSOSimulator::popFifo()
+{
+  if( fifo.empty() ){
+    memset(&regs[REG_FIFO_DATA_OUT_TAG], 0, 7);
+    return;
+  }
+
+  memcpy(&regs[REG_FIFO_DATA_OUT_TAG], fifo.front().bytes, 7);
+  fifo.pop_front();
+}
+
+//****************************************************************************//
+//
+//  Interrupt pins
+//
+//****************************************************************************//
+
+void LSM6DSOSimulator::updateInterrupts()
+{
+  uint16_t level = static_cast<uint16_t>(fifo.size());
+  bool wtm = watermark() != 0 && level >= watermark();
+  bool full = level >= fifoCapacity;
+  uint8_t status = regs[REG_STATUS];
+
+  uint8_t int1 = regs[REG_INT1_CTRL];
+  bool int1Active = ((int1 & 0x01) && (status & 0x01)) ||
+                    ((int1 & 0x02) && (status & 0x02)) ||
+                    ((int1 & 0x08) && wtm) ||
+                    ((int1 & 0x10) && overrunLatched) ||
+                    ((int1 & 0x20) && full) ||
+                    ((int1 & 0x40) && counterFlag && !counterPulsed());
+
+  uint8_t int2 = regs[REG_INT2_CTRL];
+  bool int2Active = ((int2 & 0x01) && (status & 0x01)) ||
+                    ((int2 & 0x02) && (status & 0x02)) ||
+                    ((int2 & 0x04) && (status & 0x04)) ||
+                    ((int2 & 0x08) && wtm) ||
+                    ((int2 & 0x10) && overrunLatched) ||
+                    ((int2 & 0x20) && full) ||
+                    ((int2 & 0x40) && counterFlag && !counterPulsed());
+
+  bool activeLow = (regs[REG_CTRL3_C] & 0x20) != 0;
+
+  if( int1Pin >= 0 && int1Active != int1Level ){
+    int1Level = int1Active;
+    hostSetPinLevel(int1Pin, int1Active != activeLow ? HIGH : LOW);
+  }
+  if( int2Pin >= 0 && int2Active != int2Level ){
+    int2Level = int2Active;
+    hostSetPinLevel(int2Pin, int2Active != activeLow ? HIGH : LOW);
+  }
+}
+
+// COUNTER_BDR_REG1 dataready_pulsed: the batch counter event is a short
+// pulse on the pins it is routed to instead of a level held until
+// FIFO_STATUS2 is read. A pin another source holds active shows no edge.
+bool LSM6DSOSimulator::counterPulsed() const
+{
+  return (regs[REG_COUNTER_BDR_REG1] & 0x80) != 0;
+}
+
+void LSM6DSOSimulator::pulseCounter()
+{
+  uint8_t active = (regs[REG_CTRL3_C] & 0x20) ? LOW : HIGH;
+  uint8_t idle = active == HIGH ? LOW : HIGH;
+
+  if( int1Pin >= 0 && (regs[REG_INT1_CTRL] & 0x40) && !int1Level ){
+    hostSetPinLevel(int1Pin, active);
+    hostSetPinLevel(int1Pin, idle);
+  }
+  if( int2Pin >= 0 && (regs[REG_INT2_CTRL] & 0x40) && !int2Level ){
+    hostSetPinLevel(int2Pin, active);
+    hostSetPinLevel(int2Pin, idle);
+  }
+}
+
+//****************************************************************************//
+//
+//  Register access
+//
+//****************************************************************************//
+
+// IF_INC steps the address after every byte; the FIFO output registers roll
+// back from FIFO_DATA_OUT_Z_H to FIFO_DATA_OUT_TAG.
+uint8_t LSM6DSOSimulator::nextAddress(uint8_t address) const
+{
+  if( !(regs[REG_CTRL3_C] & 0x04) )
+    return address;
+
+  if( address == REG_FIFO_DATA_OUT_Z_H )
+    return REG_FIFO_DATA_OUT_TAG;
+
+  return (address + 1) & 0x7F;
+}
+
+uint8_t LSM6DSOSimulator::readRegister(uint8_t address)
+{
+  address &= 0x7F;
+
+  if( address != REG_FUNC_CFG_ACCESS && (regs[REG_FUNC_CFG_ACCESS] & 0x80) ){
+
+    if( address == EMB_PAGE_VALUE && (embedded[EMB_PAGE_RW] & 0x20) ){
+      uint8_t page = embedded[EMB_PAGE_SEL] >> 4;
+      return pages[page][embedded[EMB_PAGE_ADDRESS]++];
+    }
+
+    return embedded[address];
+  }
+
+  if( address >= REG_OUT_TEMP_L && address <= REG_OUTZ_H_A ){
+    uint8_t pair = (address - REG_OUT_TEMP_L) / 2;
+    outputLocked[pair] = (address & 0x01) == 0;
+
+    if( address >= REG_OUTX_L_A ){
+      accelUnread = false;
+      regs[REG_STATUS] &= ~0x01;
+    }
+    else if( address >= REG_OUTX_L_G ){
+      gyroUnread = false;
+      regs[REG_STATUS] &= ~0x02;
+    }
+    else {
+      regs[REG_STATUS] &= ~0x04;
+    }
+
+    return regs[address];
+  }
+
+  if( address == REG_FIFO_STATUS1 ){
+    return fifo.size() & 0xFF;
+  }
+
+  if( address == REG_FIFO_STATUS2 ){
+    uint16_t level = static_cast<uint16_t>(fifo.size());
+    uint8_t value = (level >> 8) & 0x03;
+    if( overrunLatched )
+      value |= 0x08 | 0x40;
+    if( counterFlag )
+      value |= 0x10;
+    if( level >= fifoCapacity )
+      value |= 0x20;
+    if( watermark() != 0 && level >= watermark() )
+      value |= 0x80;
+
+    overrunLatched = false;
+    counterFlag = false;
+    return value;
+  }
+
+  if( address >= REG_TIMESTAMP0 && address <= REG_TIMESTAMP3 ){
+    if( address == REG_TIMESTAMP0 ){
+      uint32_t ticks = timestampTicks(now());
+      for( uint8_t i = 0; i < 4; i++ )
+        timestampLatch[i] = (ticks >> (8 * i)) & 0xFF;
+    }
+    return timestampLatch[address - REG_TIMESTAMP0];
+  }
+
+  if( address == REG_FIFO_DATA_OUT_TAG )
+    popFifo();
+
+  return regs[address];
+}
+
+void LSM6DSOSimulator::writeRegister(uint8_t address, uint8_t value)
+{
+  address &= 0x7F;
+
+  if( address == REG_FUNC_CFG_ACCESS ){
+    regs[address] = value;
+    return;
+  }
+
+  if( regs[REG_FUNC_CFG_ACCESS] & 0x80 ){
+
+    if( address == EMB_PAGE_VALUE && (embedded[EMB_PAGE_RW] & 0x40) ){
+      uint8_t page = embedded[EMB_PAGE_SEL] >> 4;
+      pages[page][embedded[EMB_PAGE_ADDRESS]++] = value;
+      return;
+    }
+
+    embedded[address] = value;
+    return;
+  }
+
+  switch( address ){
+
+    // Read only
+    case REG_WHO_AM_I:
+    case REG_STATUS:
+    case REG_FIFO_STATUS1:
+    case REG_FIFO_STATUS2:
+    case REG_INTERNAL_FREQ_FINE:
+      return;
+
+    case REG_CTRL3_C:
+      if( value & 0x01 ){
+        // SW_RESET restores every register to its default.
+        resetRegisters();
+        reschedule();
+        return;
+      }
+      regs[address] = value & 0x7E;
+      return;
+
+    case REG_CTRL10_C:
+      if( (value & 0x20) && !(regs[address] & 0x20) ){
+        timestampZero = now();
+        slotsSinceTimestamp = TIMESTAMP_DUE;
+      }
+      else if( !(value & 0x20) && (regs[address] & 0x20) )
+        timestampFrozen = timestampTicks(now());
+      regs[address] = value;
+      return;
+
+    case REG_TIMESTAMP2:
+      if( value == 0xAA ){
+        timestampZero = now();
+        timestampFrozen = 0;
+      }
+      return;
+
+    case REG_FIFO_CTRL4:
+      regs[address] = value;
+      if( (value & 0x07) == 0 ){
+        // Bypass empties the FIFO.
+        fifo.clear();
+        slotsSinceTimestamp = TIMESTAMP_DUE;
+        overrunLatched = false;
+        memset(&accelCompressor, 0, sizeof(accelCompressor));
+        memset(&gyroCompressor, 0, sizeof(gyroCompressor));
+      }
+      reschedule();
+      return;
+
+    case REG_CTRL1_XL:
+    case REG_CTRL2_G:
+    case REG_FIFO_CTRL3:
+      regs[address] = value;
+      reschedule();
+      return;
+
+    // RST_COUNTER_BDR restarts the batch counter and clears itself.
+    case REG_COUNTER_BDR_REG1:
+      if( value & 0x40 )
+        batchCounter = 0;
+      regs[address] = value & ~0x40;
+      return;
+
+    default:
+      if( address >= REG_OUT_TEMP_L && address <= REG_OUTZ_H_A )
+        return;
+      if( address >= REG_TIMESTAMP0 && address <= REG_TIMESTAMP3 )
+        return;
+      if( address >= REG_FIFO_DATA_OUT_TAG )
+        return;
+      regs[address] = value;
+      return;
+  }
+}
+
+//****************************************************************************//
+//
+//  Bus front ends
+//
+//****************************************************************************//
+
+bool LSM6DSOSimulator::i2cWrite(const uint8_t data[], size_t numBytes, bool sendStop)
+{
+  (void)sendStop;
+
+  if( numBytes == 0 )
+    return true;
+
+  pointer = data[0] & 0x7F;
+  for( size_t i = 1; i < numBytes; i++ ){
+    writeRegister(pointer, data[i]);
+    pointer = nextAddress(pointer);
+  }
+
+  updateInterrupts();
+  return true;
+}
+
+void LSM6DSOSimulator::i2cRead(uint8_t data[], size_t numBytes)
+{
+  for( size_t i = 0; i < numBytes; i++ ){
+    data[i] = readRegister(pointer);
+    pointer = nextAddress(pointer);
+  }
+
+  updateInterrupts();
+}
+
+void LSM6DSOSimulator::spiSelect(bool selected)
+{
+  spiSelected = selected;
+  spiAddressPhase = selected;
+
+  if( !selected )
+    updateInterrupts();
+}
+
+uint8_t LSM6DSOSimulator::spiTransfer(uint8_t data)
+{
+  if( !spiSelected )
+    return 0xFF;
+
+  if( spiAddressPhase ){
+    spiAddressPhase = false;
+    spiRead = (data & 0x80) != 0;
+    pointer = data & 0x7F;
+    return 0x00;
+  }
+
+  uint8_t output = 0x00;
+  if( spiRead )
+    output = readRegister(pointer);
+  else
+    writeRegister(pointer, data);
+
+  pointer = nextAddress(pointer);
+  return output;
+}
@@ -0,0 +1,200 @@
+/******************************************************************************
+LSM6DSOSimulator.h
+Register level model of the LSM6DSO for host builds
+
+The simulator sits behind the host Wire/SPI shims and answers the driver
+exactly as the part would, driven by the virtual clock in Arduino.h:
+
+  - main and embedded register banks, FUNC_CFG_ACCESS switching and the
+    advanced feature pages (PAGE_SEL/PAGE_ADDRESS/PAGE_VALUE/PAGE_RW)
+  - IF_INC auto-increment, including the FIFO_DATA_OUT roll-over
+  - output registers refreshed at the configured ODR (with the
+    INTERNAL_FREQ_FINE trim), STATUS_REG data-ready flags and BDU
+  - the tagged FIFO: batch data rates, watermark, bypass/FIFO/continuous
+    modes, temperature and timestamp batching, TAG_CNT and compression
+  - the 25us timestamp counter
+  - INT1/INT2 routing of data-ready, FIFO and batch counter events onto
+    host pins, so attachInterrupt() handlers fire; the batch counter event
+    latched or, with dataready_pulsed, one pulse per threshold
+  - accelerometer user offsets and software reset
+
+What the sensor "feels" comes from a motion function of time. The default
+is a level board rotating slowly about Z.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_SIMULATOR_H__
+#define __LSM6DSO_SIMULATOR_H__
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SPI.h"
+
+#include <deque>
+#include <functional>
+
+// Physical input to the simulated sensor.
+struct SimMotion {
+  double accel[3];      // g
+  double gyro[3];       // dps
+  double temperatureC;
+};
+
+class LSM6DSOSimulator : public HostI2CDevice, public HostSPIDevice, public HostClockListener
+{
+  public:
+
+    struct Statistics {
+      uint32_t accelSamples;    // output register updates
+      uint32_t gyroSamples;
+      uint32_t accelMissed;     // updates that overwrote an unread sample
+      uint32_t gyroMissed;
+      uint32_t fifoWords;       // words written into the FIFO
+      uint32_t fifoOverruns;    // words lost to a full FIFO
+    };
+
+    typedef std::function<void(double seconds, SimMotion &motion)> MotionFunction;
+
+    LSM6DSOSimulator();
+    ~LSM6DSOSimulator();
+
+    void attach(TwoWire &wire, uint8_t address = 0x6B);
+    void attachSPI(SPIClass &spi, uint8_t csPin);
+    void connectInterrupts(int int1Pin, int int2Pin = -1);
+
+    void setMotion(MotionFunction motion);
+    void setInternalFreqFine(int8_t trim);
+    void setFifoCapacity(uint16_t words);
+    void powerOnReset();
+
+    uint8_t peekRegister(uint8_t address) const;
+    uint8_t peekEmbedded(uint8_t address) const;
+    void    pokeEmbedded(uint8_t address, uint8_t value);
+    uint8_t peekPage(uint8_t page, uint8_t address) const;
+    void    pokePage(uint8_t page, uint8_t address, uint8_t value);
+    uint16_t fifoLevel() const { return static_cast<uint16_t>(fifo.size()); }
+
+    const Statistics &getStatistics() const { return stats; }
+    void resetStatistics();
+
+    // HostI2CDevice
+    bool i2cWrite(const uint8_t *data, size_t numBytes, bool sendStop);
+    void i2cRead(uint8_t *data, size_t numBytes);
+
+    // HostSPIDevice
+    void spiSelect(bool selected);
+    uint8_t spiTransfer(uint8_t data);
+
+    // HostClockListener
+    void onClockAdvance(uint64_t nowMicros);
+
+  private:
+
+    struct FifoWord {
+      uint8_t bytes[7];
+    };
+
+    struct Compressor {
+      int16_t reference[3];
+      bool referenceValid;
+      int16_t pending[3][3];
+      uint8_t numPending;
+      uint8_t sinceUncompressed;
+    };
+
+    void update(uint64_t nowMicros);
+    void reschedule();
+    void resetRegisters();
+
+    uint8_t readRegister(uint8_t address);
+    void writeRegister(uint8_t address, uint8_t value);
+    uint8_t nextAddress(uint8_t address) const;
+
+    void sampleAccel(double seconds);
+    void sampleGyro(double seconds);
+    void sampleTemperature(double seconds);
+    void batch(uint8_t tag, double seconds, const int16_t *raw);
+    void compress(Compressor &state, uint8_t baseTag, const int16_t *raw);
+    void pushWord(uint8_t tag, const int16_t *raw);
+    void pushWord(uint8_t tag, const uint8_t *data);
+    void startSlot(double seconds);
+    void popFifo();
+    void updateInterrupts();
+    bool counterPulsed() const;
+    void pulseCounter();
+
+    double trim() const;
+    double accelOdr() const;
+    double gyroOdr() const;
+    double accelBdr() const;
+    double gyroBdr() const;
+    double temperatureBdr() const;
+    uint32_t timestampTicks(double seconds) const;
+    double accelSensitivity() const;
+    double gyroSensitivity() const;
+    int16_t toRaw(double value, double sensitivity) const;
+    int16_t accelToRaw(double value, uint8_t axis) const;
+    bool fifoStopsWhenFull() const;
+    bool compressionEnabled() const;
+    uint16_t watermark() const;
+    double now() const;
+
+    uint8_t regs[128];
+    uint8_t embedded[128];
+    uint8_t pages[16][256];
+
+    std::deque<FifoWord> fifo;
+    uint16_t fifoCapacity;
+    bool overrunLatched;
+    bool counterFlag;
+    uint16_t batchCounter;
+
+    Compressor accelCompressor;
+    Compressor gyroCompressor;
+
+    // BDU: an output pair whose low byte was read keeps its value until
+    // its high byte is read too.
+    bool outputLocked[7];
+    int16_t pendingOutput[7];
+    bool accelUnread;
+    bool gyroUnread;
+
+    uint64_t currentMicros;
+    double nextAccel;
+    double nextGyro;
+    double nextAccelBatch;
+    double nextGyroBatch;
+    double nextTemperatureBatch;
+    double lastSlotTime;
+    uint8_t slotCounter;
+    uint8_t slotsSinceTimestamp;
+
+    double timestampZero;
+    uint32_t timestampFrozen;
+    uint8_t timestampLatch[4];
+
+    int8_t freqFine;
+    MotionFunction motion;
+
+    uint8_t pointer;
+    bool spiSelected;
+    bool spiAddressPhase;
+    bool spiRead;
+
+    int int1Pin;
+    int int2Pin;
+    bool int1Level;
+    bool int2Level;
+
+    TwoWire *wirePort;
+    uint8_t wireAddress;
+    SPIClass *spiPort;
+    uint8_t spiCsPin;
+
+    Statistics stats;
+};
+
+#endif  // End of __LSM6DSO_SIMULATOR_H__ definition check
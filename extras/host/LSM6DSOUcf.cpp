@@ -0,0 +1,254 @@
+#include "LSM6DSOUcf.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UCF_EMBEDDED_BANK 0x80
+
+LSM6DSOUcfCompiler::LSM6DSOUcfCompiler() :
+  writes(0),
+  waits(0),
+  bursts(0),
+  errorLine(0)
+{
+}
+
+bool LSM6DSOUcfCompiler::compile(const char text[], size_t length)
+{
+  std::vector<Write> source;
+
+  script.clear();
+  writes = 0;
+  waits = 0;
+  bursts = 0;
+  error.clear();
+  errorLine = 0;
+
+  if( !parse(text, length, source) )
+    return false;
+
+  generate(source);
+  return true;
+}
+
+//****************************************************************************//
+//
+//  Parsing
+//
+//****************************************************************************//
+
+static bool parseNumber(const std::string &token, int base, unsigned long limit, unsigned long &value)
+{
+  if( token.empty() )
+    return false;
+
+  char *end;
+  value = strtoul(token.c_str(), &end, base);
+  return *end == 0 && value <= limit;
+}
+
+// "Ac <register> <value>" in hex, "WAIT <milliseconds>" in decimal; blank
+// lines and lines starting with "--" or "//" are skipped.
+bool LSM6DSOUcfCompiler::parse(const char text[], size_t length, std::vector<Write> &output)
+{
+  size_t position = 0;
+  uint32_t line = 0;
+
+  while( position < length ){
+
+    size_t end = position;
+    while( end < length && text[end] != '\n' )
+      end++;
+    line++;
+
+    std::vector<std::string> tokens;
+    std::string token;
+    for( size_t i = position; i <= end; i++ ){
+      if( i == end || isspace(static_cast<unsigned char>(text[i])) ){
+        if( !token.empty() )
+          tokens.push_back(token);
+        token.clear();
+      }
+      else
+        token += text[i];
+    }
+    position = end + 1;
+
+    if( tokens.empty() || tokens[0].compare(0, 2, "--") == 0 || tokens[0].compare(0, 2, "//") == 0 )
+      continue;
+
+    std::string command = tokens[0];
+    for( size_t i = 0; i < command.size(); i++ )
+      command[i] = toupper(static_cast<unsigned char>(command[i]));
+
+    Write write = Write();
+    unsigned long address, value;
+
+    if( command == "AC" ){
+      if( tokens.size() != 3 || !parseNumber(tokens[1], 16, 0x7F, address) || !parseNumber(tokens[2], 16, 0xFF, value) ){
+        error = "expected Ac <register> <value> in hex";
+        errorLine = line;
+        return false;
+      }
+      write.address = static_cast<uint8_t>(address);
+      write.value = static_cast<uint8_t>(value);
+      writes++;
+    }
+    else if( command == "WAIT" ){
+      if( tokens.size() != 2 || !parseNumber(tokens[1], 10, 0xFFFF, value) ){
+        error = "expected WAIT <milliseconds>";
+        errorLine = line;
+        return false;
+      }
+      write.wait = true;
+      write.milliseconds = static_cast<uint16_t>(value);
+      waits++;
+    }
+    else {
+      error = "unknown command " + tokens[0];
+      errorLine = line;
+      return false;
+    }
+
+    output.push_back(write);
+  }
+
+  return true;
+}
+
+//****************************************************************************//
+//
+//  Script generation
+//
+//****************************************************************************//
+
+static void appendSingle(std::vector<uint8_t> &output, uint8_t address, uint8_t value)
+{
+  output.push_back(1);
+  output.push_back(address);
+  output.push_back(value);
+}
+
+// The source is cut at every bank switch and every main bank CTRL3_C
+// write, which go out on their own; the writes in between are merged.
+void LSM6DSOUcfCompiler::generate(const std::vector<Write> &source)
+{
+  size_t count = source.size();
+  bool embedded = false;
+  bool increment = true;
+  size_t first = 0;
+
+  for( size_t i = 0; i <= count; i++ ){
+
+    if( i < count ){
+      const Write &write = source[i];
+      bool barrier = !write.wait && (write.address == FUNC_CFG_ACCESS || (!embedded && write.address == CTRL3_C));
+      if( !barrier )
+        continue;
+    }
+
+    bursts += merge(source, first, i, increment, script);
+    if( i == count )
+      break;
+
+    const Write &write = source[i];
+    first = i + 1;
+
+    if( write.address == CTRL3_C && !embedded ){
+      appendSingle(script, write.address, write.value);
+      bursts++;
+      increment = (write.value & IF_INC_ENABLED) != 0;
+      continue;
+    }
+
+    // Entering the embedded bank: compare the stretch up to leaving it
+    // merged both ways, counting the two IF_INC records against the
+    // repeated register version.
+    if( !embedded && increment && (write.value & UCF_EMBEDDED_BANK) ){
+
+      size_t leave = i + 1;
+      while( leave < count && (source[leave].wait || source[leave].address != FUNC_CFG_ACCESS) )
+        leave++;
+
+      if( leave < count && !(source[leave].value & UCF_EMBEDDED_BANK) ){
+
+        std::vector<uint8_t> ascending, repeated;
+        uint32_t ascendingBursts = merge(source, i + 1, leave, true, ascending);
+        uint32_t repeatedBursts = merge(source, i + 1, leave, false, repeated);
+
+        if( repeatedBursts + 2 < ascendingBursts ){
+          script.push_back(SCRIPT_INC_OFF);
+          appendSingle(script, write.address, write.value);
+          script.insert(script.end(), repeated.begin(), repeated.end());
+          appendSingle(script, source[leave].address, source[leave].value);
+          script.push_back(SCRIPT_INC_ON);
+
+          bursts += repeatedBursts + 4;
+          i = leave;
+          first = leave + 1;
+          continue;
+        }
+      }
+    }
+
+    appendSingle(script, write.address, write.value);
+    bursts++;
+    embedded = (write.value & UCF_EMBEDDED_BANK) != 0;
+  }
+
+  script.push_back(SCRIPT_END);
+}
+
+uint32_t LSM6DSOUcfCompiler::merge(const std::vector<Write> &source, size_t first, size_t last,
+                                   bool increment, std::vector<uint8_t> &output) const
+{
+  uint32_t records = 0;
+  bool open = false;
+  size_t start = 0;
+  uint8_t address = 0;
+
+  for( size_t i = first; i < last; i++ ){
+
+    const Write &write = source[i];
+
+    if( write.wait ){
+      output.push_back(SCRIPT_WAIT);
+      output.push_back(write.milliseconds & 0xFF);
+      output.push_back(write.milliseconds >> 8);
+      open = false;
+      continue;
+    }
+
+    uint8_t length = open ? output[start] : 0;
+    uint8_t next = increment ? address + length : address;
+
+    if( open && length < SCRIPT_MAX_BURST && write.address == next ){
+      output.push_back(write.value);
+      output[start]++;
+      continue;
+    }
+
+    start = output.size();
+    appendSingle(output, write.address, write.value);
+    address = write.address;
+    open = true;
+    records++;
+  }
+
+  return records;
+}
+
+void LSM6DSOUcfCompiler::emit(FILE *output, const char *name) const
+{
+  fprintf(output, "// Generated by lsm6dso_ucf: %u register writes and %u waits as %u bursts.\n",
+          (unsigned)writes, (unsigned)waits, (unsigned)bursts);
+  fprintf(output, "// Apply with writeScript(%s).\n\n", name);
+  fprintf(output, "#include \"SparkFunLSM6DSO.h\"\n\n");
+  fprintf(output, "constexpr uint8_t %s[] PROGMEM = {", name);
+
+  for( size_t i = 0; i < script.size(); i++ )
+    fprintf(output, "%s0x%02X", i == 0 ? "\n  " : i % 12 == 0 ? ",\n  " : ", ", script[i]);
+
+  fprintf(output, "\n};\n");
+}
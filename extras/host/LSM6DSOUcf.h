@@ -0,0 +1,95 @@
+/******************************************************************************
+LSM6DSOUcf.h
+Compiler from ST .ucf configuration files to LSM6DSO write scripts
+
+ST's configuration tools export sensor setups (finite state machines,
+pedometer, filters) as .ucf text, one register write per line:
+
+  --Comment
+  Ac 10 40
+  WAIT 5
+
+LSM6DSOUcfCompiler turns that into a script for LSM6DSOCore::writeScript()
+(see SCRIPT_END in SparkFunLSM6DSO.h), merging consecutive writes into
+bursts. With IF_INC set, a write to the register after the previous one
+joins its burst; with it cleared, writes to the same register do.
+
+Writes to FUNC_CFG_ACCESS switch banks and writes to main bank CTRL3_C can
+change IF_INC, so no burst continues past either. Most writes between
+entering and leaving the embedded bank go to PAGE_VALUE, one byte of
+advanced page data each; where it saves records, the compiler clears IF_INC
+before entering the bank and sets it again after leaving, so those writes
+become bursts to a single register.
+
+  LSM6DSOUcfCompiler compiler;
+  if( compiler.compile(text, length) )
+    compiler.emit(stdout, "sensorSetup");
+
+Host only: needs the C++ library.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __LSM6DSO_UCF_H__
+#define __LSM6DSO_UCF_H__
+
+#include "SparkFunLSM6DSO.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class LSM6DSOUcfCompiler
+{
+  public:
+
+    LSM6DSOUcfCompiler();
+
+    // Replaces the script with the compiled text. On a syntax error returns
+    // false with getError() and getErrorLine() set.
+    bool compile(const char text[], size_t length);
+
+    const std::vector<uint8_t> &getScript() const { return script; }
+
+    // Register writes and waits in the source, and the bus writes the
+    // script makes, IF_INC changes included, before any splitting for the
+    // interface's buffer.
+    uint32_t getWrites() const { return writes; }
+    uint32_t getWaits() const { return waits; }
+    uint32_t getBursts() const { return bursts; }
+
+    const std::string &getError() const { return error; }
+    uint32_t getErrorLine() const { return errorLine; }
+
+    // Writes the script as a C++ header declaring a constexpr PROGMEM array.
+    void emit(FILE *output, const char *name) const;
+
+  private:
+
+    struct Write {
+      uint8_t address;
+      uint8_t value;
+      uint16_t milliseconds;
+      bool wait;
+    };
+
+    bool parse(const char text[], size_t length, std::vector<Write> &output);
+    void generate(const std::vector<Write> &source);
+    // Writes in [first, last) with IF_INC as given, into output. Returns
+    // the number of burst records.
+    uint32_t merge(const std::vector<Write> &source, size_t first, size_t last,
+                   bool increment, std::vector<uint8_t> &output) const;
+
+    std::vector<uint8_t> script;
+    uint32_t writes;
+    uint32_t waits;
+    uint32_t bursts;
+
+    std::string error;
+    uint32_t errorLine;
+};
+
+#endif  // End of __LSM6DSO_UCF_H__ definition check
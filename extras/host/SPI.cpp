@@ -0,0 +1,105 @@
+#include "SPI.h"
+
+SPIClass SPI;
+
+SPIClass::SPIClass()
+{
+  for( uint8_t i = 0; i < HOST_MAX_SPI_DEVICES; i++ )
+    devices[i] = 0;
+
+  selected = 0;
+  listening = false;
+  transactionCount = 0;
+  byteCount = 0;
+}
+
+// hostReset() drops pin listeners, so registration is redone here rather
+// than once in the constructor.
+void SPIClass::begin()
+{
+  hostRemovePinListener(this);
+  hostAddPinListener(this);
+  listening = true;
+}
+
+void SPIClass::end()
+{
+  if( listening ){
+    hostRemovePinListener(this);
+    listening = false;
+  }
+}
+
+void SPIClass::attachDevice(uint8_t csPin, HostSPIDevice *device)
+{
+  detachDevice(csPin);
+  begin();
+
+  for( uint8_t i = 0; i < HOST_MAX_SPI_DEVICES; i++ ){
+    if( devices[i] == 0 ){
+      pins[i] = csPin;
+      devices[i] = device;
+      return;
+    }
+  }
+}
+
+void SPIClass::detachDevice(uint8_t csPin)
+{
+  for( uint8_t i = 0; i < HOST_MAX_SPI_DEVICES; i++ ){
+    if( devices[i] != 0 && pins[i] == csPin ){
+      if( selected == devices[i] )
+        selected = 0;
+      devices[i] = 0;
+    }
+  }
+}
+
+void SPIClass::resetCounters()
+{
+  transactionCount = 0;
+  byteCount = 0;
+}
+
+void SPIClass::beginTransaction(SPISettings newSettings)
+{
+  settings = newSettings;
+}
+
+void SPIClass::onPinWrite(uint8_t pin, uint8_t level)
+{
+  for( uint8_t i = 0; i < HOST_MAX_SPI_DEVICES; i++ ){
+    if( devices[i] == 0 || pins[i] != pin )
+      continue;
+
+    if( level == LOW ){
+      transactionCount++;
+      selected = devices[i];
+      selected->spiSelect(true);
+    }
+    else if( selected == devices[i] ){
+      selected->spiSelect(false);
+      selected = 0;
+    }
+  }
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+  byteCount++;
+
+  if( settings.clock != 0 )
+    hostAdvanceNanos(8ULL * 1000000000ULL / settings.clock);
+
+  if( selected == 0 )
+    return 0xFF;
+
+  return selected->spiTransfer(data);
+}
+
+void SPIClass::transfer(void *buffer, size_t numBytes)
+{
+  uint8_t *data = static_cast<uint8_t *>(buffer);
+  for( size_t i = 0; i < numBytes; i++ )
+    data[i] = transfer(data[i]);
+}
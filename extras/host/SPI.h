@@ -0,0 +1,92 @@
+/******************************************************************************
+SPI.h
+Host (Linux) stand-in for the Arduino SPI library
+
+Transfers go to the HostSPIDevice whose chip select pin is currently driven
+low with digitalWrite(). Each byte advances the virtual clock by eight
+periods of the clock given in SPISettings.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __SPI_HOST_H__
+#define __SPI_HOST_H__
+
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+#define HOST_MAX_SPI_DEVICES 8
+
+// Implemented by simulated peripherals.
+class HostSPIDevice
+{
+  public:
+    virtual ~HostSPIDevice() { }
+
+    // Chip select went low (true) or high (false).
+    virtual void spiSelect(bool selected) = 0;
+
+    // Full duplex byte exchange while selected.
+    virtual uint8_t spiTransfer(uint8_t) = 0;
+};
+
+class SPISettings
+{
+  public:
+    SPISettings() : clock(4000000), bitOrder(MSBFIRST), dataMode(SPI_MODE0) { }
+    SPISettings(uint32_t clockHz, uint8_t order, uint8_t mode) : clock(clockHz), bitOrder(order), dataMode(mode) { }
+
+    uint32_t clock;
+    uint8_t bitOrder;
+    uint8_t dataMode;
+};
+
+class SPIClass : public HostPinListener
+{
+  public:
+
+    SPIClass();
+
+    void begin();
+    void end();
+    void beginTransaction(SPISettings);
+    void endTransaction() { }
+
+    uint8_t transfer(uint8_t);
+    void transfer(void *, size_t);
+
+    // Host hooks
+    void attachDevice(uint8_t csPin, HostSPIDevice *device);
+    void detachDevice(uint8_t csPin);
+
+    uint32_t getTransactionCount() const { return transactionCount; }
+    uint32_t getByteCount() const { return byteCount; }
+    void resetCounters();
+
+    void onPinWrite(uint8_t pin, uint8_t level);
+
+  private:
+
+    uint8_t pins[HOST_MAX_SPI_DEVICES];
+    HostSPIDevice *devices[HOST_MAX_SPI_DEVICES];
+    HostSPIDevice *selected;
+
+    SPISettings settings;
+    bool listening;
+
+    uint32_t transactionCount;
+    uint32_t byteCount;
+};
+
+extern SPIClass SPI;
+
+#endif  // End of __SPI_HOST_H__ definition check
@@ -0,0 +1,146 @@
+#include "Wire.h"
+
+TwoWire Wire;
+TwoWire Wire1;
+
+TwoWire::TwoWire()
+{
+  for( uint8_t i = 0; i < HOST_MAX_I2C_DEVICES; i++ )
+    devices[i] = 0;
+
+  busClock = 400000;
+  txAddress = 0;
+  txLength = 0;
+  rxLength = 0;
+  rxIndex = 0;
+  transactionCount = 0;
+  byteCount = 0;
+}
+
+void TwoWire::attachDevice(uint8_t address, HostI2CDevice *device)
+{
+  detachDevice(address);
+
+  for( uint8_t i = 0; i < HOST_MAX_I2C_DEVICES; i++ ){
+    if( devices[i] == 0 ){
+      addresses[i] = address;
+      devices[i] = device;
+      return;
+    }
+  }
+}
+
+void TwoWire::detachDevice(uint8_t address)
+{
+  for( uint8_t i = 0; i < HOST_MAX_I2C_DEVICES; i++ ){
+    if( devices[i] != 0 && addresses[i] == address )
+      devices[i] = 0;
+  }
+}
+
+HostI2CDevice *TwoWire::findDevice(uint8_t address)
+{
+  for( uint8_t i = 0; i < HOST_MAX_I2C_DEVICES; i++ ){
+    if( devices[i] != 0 && addresses[i] == address )
+      return devices[i];
+  }
+
+  return 0;
+}
+
+void TwoWire::resetCounters()
+{
+  transactionCount = 0;
+  byteCount = 0;
+}
+
+// Start or repeated start, address byte and numBytes data bytes, nine clocks
+// each, plus a stop.
+void TwoWire::chargeBusTime(size_t numBytes)
+{
+  transactionCount++;
+  byteCount += numBytes + 1;
+
+  if( busClock == 0 )
+    return;
+
+  uint64_t bits = 9 * (numBytes + 1) + 2;
+  hostAdvanceNanos(bits * 1000000000ULL / busClock);
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+  txAddress = address;
+  txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  if( txLength >= BUFFER_LENGTH )
+    return 0;
+
+  txBuffer[txLength++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t numBytes)
+{
+  size_t written = 0;
+  while( written < numBytes && write(data[written]) )
+    written++;
+
+  return written;
+}
+
+// Same return codes as the AVR core: 0 success, 2 address NACK, 3 data NACK.
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+  HostI2CDevice *device = findDevice(txAddress);
+
+  chargeBusTime(txLength);
+
+  if( device == 0 )
+    return 2;
+
+  if( !device->i2cWrite(txBuffer, txLength, sendStop) )
+    return 3;
+
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, bool sendStop)
+{
+  (void)sendStop;
+
+  HostI2CDevice *device = findDevice(address);
+
+  // The AVR core silently clips requests to its buffer size.
+  if( quantity > BUFFER_LENGTH )
+    quantity = BUFFER_LENGTH;
+
+  rxIndex = 0;
+  rxLength = 0;
+
+  chargeBusTime(quantity);
+
+  if( device == 0 )
+    return 0;
+
+  device->i2cRead(rxBuffer, quantity);
+  rxLength = quantity;
+
+  return quantity;
+}
+
+int TwoWire::available()
+{
+  return static_cast<int>(rxLength - rxIndex);
+}
+
+int TwoWire::read()
+{
+  if( rxIndex >= rxLength )
+    return -1;
+
+  return rxBuffer[rxIndex++];
+}
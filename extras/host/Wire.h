@@ -0,0 +1,93 @@
+/******************************************************************************
+Wire.h
+Host (Linux) stand-in for the Arduino Wire library
+
+Transactions are forwarded to HostI2CDevice objects attached by address.
+Like the AVR core, requestFrom() never returns more than BUFFER_LENGTH
+bytes; build with -DBUFFER_LENGTH=<n> to mimic other cores. Every transfer
+advances the virtual clock by the time it would take on the wire at the
+configured bus clock.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#ifndef __WIRE_HOST_H__
+#define __WIRE_HOST_H__
+
+#include "Arduino.h"
+
+#ifndef BUFFER_LENGTH
+#define BUFFER_LENGTH 32
+#endif
+
+#define HOST_MAX_I2C_DEVICES 8
+
+// Implemented by simulated peripherals.
+class HostI2CDevice
+{
+  public:
+    virtual ~HostI2CDevice() { }
+
+    // Bytes written by the controller in one transaction. Returns false to
+    // NACK.
+    virtual bool i2cWrite(const uint8_t *data, size_t numBytes, bool sendStop) = 0;
+
+    // Fills data with numBytes bytes read by the controller.
+    virtual void i2cRead(uint8_t *data, size_t numBytes) = 0;
+};
+
+class TwoWire
+{
+  public:
+
+    TwoWire();
+
+    void begin() { }
+    void end() { }
+    void setClock(uint32_t clock) { busClock = clock; }
+
+    void beginTransmission(uint8_t);
+    void beginTransmission(int address) { beginTransmission(static_cast<uint8_t>(address)); }
+    size_t write(uint8_t);
+    size_t write(const uint8_t *, size_t);
+    uint8_t endTransmission(bool sendStop = true);
+
+    uint8_t requestFrom(uint8_t, uint8_t, bool sendStop = true);
+    uint8_t requestFrom(int address, int quantity) { return requestFrom(static_cast<uint8_t>(address), static_cast<uint8_t>(quantity)); }
+    int available();
+    int read();
+
+    // Host hooks
+    void attachDevice(uint8_t address, HostI2CDevice *device);
+    void detachDevice(uint8_t address);
+
+    uint32_t getTransactionCount() const { return transactionCount; }
+    uint32_t getByteCount() const { return byteCount; }
+    void resetCounters();
+
+  private:
+
+    HostI2CDevice *findDevice(uint8_t);
+    void chargeBusTime(size_t numBytes);
+
+    uint8_t addresses[HOST_MAX_I2C_DEVICES];
+    HostI2CDevice *devices[HOST_MAX_I2C_DEVICES];
+
+    uint32_t busClock;
+    uint8_t txAddress;
+    uint8_t txBuffer[BUFFER_LENGTH];
+    size_t txLength;
+    uint8_t rxBuffer[BUFFER_LENGTH];
+    size_t rxLength;
+    size_t rxIndex;
+
+    uint32_t transactionCount;
+    uint32_t byteCount;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif  // End of __WIRE_HOST_H__ definition check
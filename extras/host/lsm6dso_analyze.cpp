@@ -0,0 +1,192 @@
+/******************************************************************************
+lsm6dso_analyze.cpp
+Per-axis statistics over a time range of a recording
+
+Usage: lsm6dso_analyze recording [fromSeconds [toSeconds]]
+
+Opens a stream capture, a compressed log or a raw FIFO word dump (told apart
+by the first bytes) through LSM6DSOLogFile.h, jumps to the range with the
+seek index and prints count, mean, standard deviation, minimum and maximum
+of each axis in raw counts. Seconds count from the first sample at the
+nominal 25us per tick.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#include "LSM6DSOLogFile.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TICKS_PER_SECOND 40000.0
+
+struct AxisStatistics {
+  uint64_t count;
+  double sum;
+  double sumSquares;
+  int16_t minimum;
+  int16_t maximum;
+
+  AxisStatistics() : count(0), sum(0), sumSquares(0), minimum(INT16_MAX), maximum(INT16_MIN) {}
+
+  void add(int16_t value)
+  {
+    count++;
+    sum += value;
+    sumSquares += static_cast<double>(value) * value;
+    if( value < minimum )
+      minimum = value;
+    if( value > maximum )
+      maximum = value;
+  }
+};
+
+static const char *axisNames[6] = { "gyro x", "gyro y", "gyro z", "accel x", "accel y", "accel z" };
+
+static void report(const AxisStatistics statistics[6])
+{
+  printf("%-8s %10s %10s %10s %8s %8s\n", "axis", "count", "mean", "stddev", "min", "max");
+  for( uint8_t i = 0; i < 6; i++ ){
+    const AxisStatistics &axis = statistics[i];
+    double mean = axis.count ? axis.sum / axis.count : 0;
+    double variance = axis.count ? axis.sumSquares / axis.count - mean * mean : 0;
+    printf("%-8s %10llu %10.2f %10.2f %8d %8d\n", axisNames[i], (unsigned long long)axis.count,
+           mean, sqrt(variance > 0 ? variance : 0), axis.count ? axis.minimum : 0, axis.count ? axis.maximum : 0);
+  }
+}
+
+// Whole columns at a time, straight from the mapping.
+static void analyzeStream(const LSM6DSOStreamFile &capture, double from, double to)
+{
+  uint64_t origin = capture.ticks(0);
+  size_t first = capture.findTicks(origin + static_cast<uint64_t>(from * TICKS_PER_SECOND));
+  size_t last = to > 0 ? capture.findTicks(origin + static_cast<uint64_t>(to * TICKS_PER_SECOND)) : capture.size();
+
+  AxisStatistics statistics[6];
+  for( uint8_t axis = 0; axis < 6; axis++ ){
+    LSM6DSOStreamFile::Column column = capture.column(static_cast<LSM6DSO_AXIS_t>(axis));
+    LSM6DSOStreamFile::Column::iterator value = column.at(first);
+    for( size_t i = first; i < last; i++, ++value )
+      statistics[axis].add(*value);
+  }
+
+  fprintf(stderr, "stream capture: %llu samples in %llu frames, %lu bad frames\n",
+          (unsigned long long)capture.size(), (unsigned long long)capture.getFrames(),
+          (unsigned long)capture.getCrcErrors());
+  report(statistics);
+}
+
+static void analyzeLog(const LSM6DSOLogFile &log, double from, double to)
+{
+  uint64_t origin = log.getIndex()[0].ticks;
+  uint64_t start = origin + static_cast<uint64_t>(from * TICKS_PER_SECOND);
+  uint64_t end = to > 0 ? origin + static_cast<uint64_t>(to * TICKS_PER_SECOND) : UINT64_MAX;
+
+  LSM6DSOLogReader reader = log.reader();
+  log.seekTicks(reader, start);
+
+  // Records carry the low 32 bits; widen them from the block's seek point.
+  LSM6DSOTickExtender extender;
+  extender.restart(log.getIndex()[log.getIndex().findTicks(start)].ticks);
+
+  AxisStatistics statistics[6];
+  streamRecord record;
+  while( reader.read(record) ){
+    uint64_t ticks = extender.extend(record.ticks);
+    if( ticks < start )
+      continue;
+    if( ticks >= end )
+      break;
+    for( uint8_t i = 0; i < 3; i++ ){
+      statistics[i].add(record.rawGyro[i]);
+      statistics[3 + i].add(record.rawAccel[i]);
+    }
+  }
+
+  fprintf(stderr, "compressed log: %llu samples in %llu blocks, %lu bad blocks\n",
+          (unsigned long long)log.size(), (unsigned long long)log.getBlocks(),
+          (unsigned long)log.getCrcErrors());
+  report(statistics);
+}
+
+static void analyzeFifo(const LSM6DSOFifoDump &dump, double from, double to)
+{
+  uint64_t origin = dump.getIndex().size() ? dump.getIndex()[0].ticks : 0;
+  uint64_t start = origin + static_cast<uint64_t>(from * TICKS_PER_SECOND);
+  uint64_t end = to > 0 ? origin + static_cast<uint64_t>(to * TICKS_PER_SECOND) : UINT64_MAX;
+
+  LSM6DSOFifoDump::Cursor cursor(dump);
+  cursor.seekTicks(start);
+
+  AxisStatistics statistics[6];
+  fifoDumpSample sample;
+  while( cursor.next(sample) ){
+    if( sample.ticks < start )
+      continue;
+    if( sample.ticks >= end )
+      break;
+    uint8_t base;
+    if( sample.sensorTag == GYROSCOPE_DATA )
+      base = 0;
+    else if( sample.sensorTag == ACCELEROMETER_DATA )
+      base = 3;
+    else
+      continue;
+    for( uint8_t i = 0; i < 3; i++ )
+      statistics[base + i].add(sample.raw[i]);
+  }
+
+  fprintf(stderr, "FIFO dump: %llu words, %lu ticks per slot\n",
+          (unsigned long long)dump.getWords(), (unsigned long)dump.getSlotTicks());
+  report(statistics);
+}
+
+int main(int argc, char *argv[])
+{
+  if( argc < 2 ){
+    fprintf(stderr, "usage: %s recording [fromSeconds [toSeconds]]\n", argv[0]);
+    return 1;
+  }
+
+  double from = argc > 2 ? atof(argv[2]) : 0;
+  double to = argc > 3 ? atof(argv[3]) : 0;
+
+  LSM6DSOMappedFile probe;
+  if( !probe.open(argv[1]) || probe.size() < 2 ){
+    fprintf(stderr, "can't read %s\n", argv[1]);
+    return 1;
+  }
+  uint8_t first = probe.data()[0];
+  uint8_t second = probe.data()[1];
+  probe.close();
+
+  if( first == STREAM_SYNC_1 && second == STREAM_SYNC_2 ){
+    LSM6DSOStreamFile capture;
+    if( !capture.open(argv[1]) ){
+      fprintf(stderr, "no valid frames in %s\n", argv[1]);
+      return 1;
+    }
+    analyzeStream(capture, from, to);
+  }
+  else if( first == LOG_SYNC_1 && second == LOG_SYNC_2 ){
+    LSM6DSOLogFile log;
+    if( !log.open(argv[1]) ){
+      fprintf(stderr, "no valid blocks in %s\n", argv[1]);
+      return 1;
+    }
+    analyzeLog(log, from, to);
+  }
+  else {
+    LSM6DSOFifoDump dump;
+    if( !dump.open(argv[1]) ){
+      fprintf(stderr, "no FIFO words in %s\n", argv[1]);
+      return 1;
+    }
+    analyzeFifo(dump, from, to);
+  }
+
+  return 0;
+}
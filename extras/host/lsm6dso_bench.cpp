@@ -0,0 +1,1478 @@
+/******************************************************************************
+lsm6dso_bench.cpp
+Acquisition path comparison against the simulated LSM6DSO
+
+Runs each way of getting data out of the driver for one second of virtual
+time with both sensors at 1660Hz and reports how much of the data made it
+to the host and what it cost on the bus. Because time only moves when the
+bus or delay() moves it, the numbers depend on the driver and the bus
+clock, never on the machine the benchmark runs on.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#include "SparkFunLSM6DSO.h"
+#include "SparkFunLSM6DSO_Ring.h"
+#include "SparkFunLSM6DSO_Batch.h"
+#include "SparkFunLSM6DSO_Fixed.h"
+#include "SparkFunLSM6DSO_AHRS.h"
+#include "SparkFunLSM6DSO_Calibration.h"
+#include "SparkFunLSM6DSO_EKF.h"
+#include "SparkFunLSM6DSO_Stream.h"
+#include "SparkFunLSM6DSO_Log.h"
+#include "SparkFunLSM6DSO_Group.h"
+#include "SparkFunLSM6DSO_FSM.h"
+#include "LSM6DSOSimulator.h"
+#include "LSM6DSOLogFile.h"
+#include "LSM6DSOUcf.h"
+
+#include <stdio.h>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <string.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  #define HOST_CYCLES() __rdtsc()
+#endif
+
+#define CS_PIN 10
+#define INT1_PIN 2
+#define RUN_MICROS 1000000ULL
+#define DRAIN_PERIOD_MS 10
+#define SAMPLE_RATE 1660
+
+struct Result {
+  uint32_t delivered;       // samples (or sample sets) handed to the sketch
+  uint32_t transactions;    // bus transactions
+  uint32_t bytes;           // bytes on the bus, address phases included
+  bool fifo;                // lost data is counted as overruns, not misses
+  LSM6DSOSimulator::Statistics device;
+};
+
+static void configure(LSM6DSO &imu)
+{
+  imu.setAccelRange(8);
+  imu.setAccelDataRate(SAMPLE_RATE);
+  imu.setGyroRange(500);
+  imu.setGyroDataRate(SAMPLE_RATE);
+  imu.setBlockDataUpdate(true);
+}
+
+static void configureFifo(LSM6DSO &imu, bool compressed)
+{
+  configure(imu);
+  imu.setFifoDepth(400);
+  imu.setAccelBatchDataRate(SAMPLE_RATE);
+  imu.setGyroBatchDataRate(SAMPLE_RATE);
+  imu.setFifoCompression(compressed);
+  imu.setFifoMode(FIFO_MODE_CONTINUOUS);
+}
+
+static void finish(Result &result, LSM6DSOSimulator &sim, bool spi)
+{
+  if( spi ){
+    result.transactions = SPI.getTransactionCount();
+    result.bytes = SPI.getByteCount();
+  }
+  else {
+    result.transactions = Wire.getTransactionCount();
+    result.bytes = Wire.getByteCount();
+  }
+  result.device = sim.getStatistics();
+}
+
+static void startRun(LSM6DSOSimulator &sim)
+{
+  sim.resetStatistics();
+  Wire.resetCounters();
+  SPI.resetCounters();
+}
+
+// Six readFloat calls per loop, each a separate two byte read.
+static Result perAxisPolling()
+{
+  Result result = Result();
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+
+  sim.attach(Wire);
+  imu.begin();
+  configure(imu);
+  startRun(sim);
+
+  uint64_t end = hostMicros() + RUN_MICROS;
+  while( hostMicros() < end ){
+    volatile float value;
+    value = imu.readFloatAccelX();
+    value = imu.readFloatAccelY();
+    value = imu.readFloatAccelZ();
+    value = imu.readFloatGyroX();
+    value = imu.readFloatGyroY();
+    value = imu.readFloatGyroZ();
+    (void)value;
+    result.delivered++;
+  }
+
+  finish(result, sim, false);
+  return result;
+}
+
+// One 14 byte burst per loop.
+static Result burstPolling()
+{
+  Result result = Result();
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+
+  sim.attach(Wire);
+  imu.begin();
+  configure(imu);
+  startRun(sim);
+
+  imuData data;
+  uint64_t end = hostMicros() + RUN_MICROS;
+  while( hostMicros() < end ){
+    if( imu.readAll(data) )
+      result.delivered++;
+  }
+
+  finish(result, sim, false);
+  return result;
+}
+
+// Data ready polling, counting the fresh accelerometer and gyroscope
+// samples: listenDataReady() and then readAll() when something is ready,
+// or pollAll() doing both in one transaction.
+static Result readyPolling(bool combined, pollStatistics &stats)
+{
+  Result result = Result();
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+
+  sim.attach(Wire);
+  imu.begin();
+  configure(imu);
+  startRun(sim);
+  imu.resetPollStatistics();
+
+  imuData data;
+  uint64_t end = hostMicros() + RUN_MICROS;
+  while( hostMicros() < end ){
+    uint8_t ready;
+    if( combined )
+      ready = imu.pollAll(data);
+    else {
+      ready = imu.listenDataReady();
+      if( ready && !imu.readAll(data) )
+        ready = 0;
+    }
+    result.delivered += ((ready & ACCEL_DATA_READY) != 0) + ((ready & GYRO_DATA_READY) != 0);
+  }
+
+  stats = imu.getPollStatistics();
+  finish(result, sim, false);
+  return result;
+}
+
+// Sleep, then drain everything the FIFO collected.
+static Result fifoDrain(bool spi, bool compressed)
+{
+  Result result = Result();
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+
+  if( spi ){
+    sim.attachSPI(SPI, CS_PIN);
+    imu.beginSPI(CS_PIN);
+  }
+  else {
+    sim.attach(Wire);
+    imu.begin();
+  }
+  configureFifo(imu, compressed);
+  startRun(sim);
+  result.fifo = true;
+
+  fifoData samples[64];
+  uint64_t end = hostMicros() + RUN_MICROS;
+  while( hostMicros() < end ){
+    delay(DRAIN_PERIOD_MS);
+    uint16_t count;
+    while( (count = imu.fifoRead(samples, 64)) != 0 )
+      result.delivered += count;
+  }
+
+  finish(result, sim, spi);
+  return result;
+}
+
+// Drain the whole backlog with one fifoReadWords() call and decode it in
+// place; the bus chunking is left entirely to readBulk().
+static Result bulkFifoDrain(bool spi)
+{
+  Result result = Result();
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+
+  if( spi ){
+    sim.attachSPI(SPI, CS_PIN);
+    imu.beginSPI(CS_PIN);
+  }
+  else {
+    sim.attach(Wire);
+    imu.begin();
+  }
+  configureFifo(imu, false);
+  startRun(sim);
+  result.fifo = true;
+
+  static uint8_t words[(FIFO_MAX_WORDS + 1) * FIFO_WORD_LENGTH];
+  fifoData samples[FIFO_MAX_SAMPLES_PER_WORD];
+  uint64_t end = hostMicros() + RUN_MICROS;
+  while( hostMicros() < end ){
+    delay(DRAIN_PERIOD_MS);
+    uint16_t count = imu.fifoReadWords(words, imu.getUnreadFifoWords());
+    for( uint16_t i = 0; i < count; i++ )
+      result.delivered += imu.decodeFifoWord(&words[i * FIFO_WORD_LENGTH], samples);
+  }
+
+  finish(result, sim, spi);
+  return result;
+}
+
+// "lost" is samples the sensor produced that never reached the host: output
+// register updates overwritten unread when polling, FIFO overruns otherwise.
+static void report(const char *name, const Result &result)
+{
+  uint32_t lost = result.fifo ? result.device.fifoOverruns
+                              : result.device.accelMissed + result.device.gyroMissed;
+
+  printf("%-26s %10u %10u %10u %8u %8u\n", name,
+         (unsigned)result.delivered, (unsigned)result.transactions, (unsigned)result.bytes,
+         (unsigned)lost, (unsigned)result.device.fifoWords);
+}
+
+// Host CPU time to turn a full FIFO's worth of raw words into floats, once
+// through fifoData and once through LSM6DSOBatch, next to the virtual bus
+// time it took to read them over SPI.
+static void postProcessing()
+{
+  const uint16_t NUM_WORDS = FIFO_MAX_WORDS + 1;
+  const int REPEAT = 200;
+
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+  sim.attachSPI(SPI, CS_PIN);
+  imu.beginSPI(CS_PIN);
+  configureFifo(imu, false);
+  imu.setFifoDepth(0);
+  delay(200);
+
+  static uint8_t words[NUM_WORDS * FIFO_WORD_LENGTH];
+  uint64_t busStart = hostMicros();
+  uint16_t numWords = imu.fifoReadWords(words, imu.getUnreadFifoWords());
+  uint64_t busMicros = hostMicros() - busStart;
+
+  static fifoData samples[NUM_WORDS * FIFO_MAX_SAMPLES_PER_WORD];
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for( int r = 0; r < REPEAT; r++ ){
+    imu.resetFifoDecoder();
+    uint32_t count = 0;
+    for( uint16_t i = 0; i < numWords; i++ )
+      count += imu.decodeFifoWord(&words[i * FIFO_WORD_LENGTH], &samples[count]);
+  }
+  double aosMicros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / REPEAT;
+
+  static LSM6DSOBatch<NUM_WORDS> batch;
+  static float x[NUM_WORDS], y[NUM_WORDS], z[NUM_WORDS];
+  start = std::chrono::steady_clock::now();
+  for( int r = 0; r < REPEAT; r++ ){
+    imu.resetFifoDecoder();
+    batch.clear();
+    batch.append(imu, words, numWords);
+    batch.convertAccel(x, y, z, imu.getAccelSensitivity());
+    batch.convertGyro(x, y, z, imu.getGyroSensitivity());
+  }
+  double soaMicros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / REPEAT;
+
+  printf("\n%u words: SPI read %llu us (virtual), fifoData decode %.1f us, batch decode+convert %.1f us (host CPU)\n",
+         (unsigned)numWords, (unsigned long long)busMicros, aosMicros, soaMicros);
+}
+
+// calcAccelMilli()/calcGyroMilli() against lroundf() of the float path over
+// every raw count at every full scale. Where the exact value sits on a half
+// unit the float product lands either side of it, so a tie may round the
+// other way by 1; anything else has to match. The batch conversions and
+// LSM6DSOFixed have to agree with calc*Milli() everywhere.
+#define MILLI_HALF 32768
+
+static LSM6DSOBatch<MILLI_HALF> milliBatch;
+static int32_t milliColumns[6][MILLI_HALF];
+
+// Every int16 count through convertAccelMilli()/convertGyroMilli(), in two
+// halves since a batch holds at most 65535 samples.
+static uint32_t batchMilliMismatches(LSM6DSO &imu, bool accel)
+{
+  uint32_t mismatches = 0;
+
+  for( int32_t base = -MILLI_HALF; base < MILLI_HALF; base += MILLI_HALF ){
+    for( int32_t k = 0; k < MILLI_HALF; k++ )
+      for( uint8_t axis = 0; axis < 3; axis++ ){
+        milliBatch.accel[axis][k] = static_cast<int16_t>(base + k);
+        milliBatch.gyro[axis][k] = static_cast<int16_t>(base + k);
+      }
+    milliBatch.accelCount = MILLI_HALF;
+    milliBatch.gyroCount = MILLI_HALF;
+
+    if( accel )
+      milliBatch.convertAccelMilli(milliColumns[0], milliColumns[1], milliColumns[2], imu.getAccelMilliScale());
+    else
+      milliBatch.convertGyroMilli(milliColumns[0], milliColumns[1], milliColumns[2], imu.getGyroMilliScale());
+
+    for( int32_t k = 0; k < MILLI_HALF; k++ ){
+      int16_t raw = static_cast<int16_t>(base + k);
+      int32_t milli = accel ? imu.calcAccelMilli(raw) : imu.calcGyroMilli(raw);
+      for( uint8_t axis = 0; axis < 3; axis++ )
+        mismatches += milliColumns[axis][k] != milli;
+    }
+  }
+
+  return mismatches;
+}
+
+template <LSM6DSOAccelFS ACCEL_FS, LSM6DSOGyroFS GYRO_FS>
+static uint32_t fixedMilliMismatches(LSM6DSO &imu, bool accel)
+{
+  typedef LSM6DSOFixed<ACCEL_FS, LSM6DSOOdr::Hz104, GYRO_FS> Fixed;
+  uint32_t mismatches = 0;
+
+  for( int32_t x = -32768; x <= 32767; x++ ){
+    int16_t raw = static_cast<int16_t>(x);
+    if( accel )
+      mismatches += Fixed::calcAccelMilli(raw) != imu.calcAccelMilli(raw);
+    else
+      mismatches += Fixed::calcGyroMilli(raw) != imu.calcGyroMilli(raw);
+  }
+
+  return mismatches;
+}
+
+static void milliPath()
+{
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+  sim.attach(Wire);
+  imu.begin();
+
+  const uint16_t ACCEL_RANGES[] = { 2, 4, 8, 16 };
+  const uint16_t GYRO_RANGES[] = { 125, 250, 500, 1000, 2000 };
+  bool passed = true;
+
+  printf("\nmilli path against lroundf(float * 1000), all int16 counts:\n");
+  for( int i = 0; i < 9; i++ ){
+    bool accel = i < 4;
+    if( accel )
+      imu.setAccelRange(ACCEL_RANGES[i]);
+    else if( GYRO_RANGES[i - 4] == 125 )
+      imu.writeRegister(CTRL2_G, FS_G_125dps);   // setGyroRange() stops at 250
+    else
+      imu.setGyroRange(GYRO_RANGES[i - 4]);
+
+    // Sensitivity in micro-units per LSB, to find the exact half unit ties.
+    int32_t micro = accel ? lroundf(imu.getAccelSensitivity() * 1e6f) : lroundf(imu.getGyroSensitivity() * 1e6f);
+    uint32_t mismatches = 0, ties = 0, tiesFlipped = 0;
+    for( int32_t x = -32768; x <= 32767; x++ ){
+      int16_t raw = static_cast<int16_t>(x);
+      long expected = accel ? lroundf(imu.calcAccel(raw) * 1000.0f) : lroundf(imu.calcGyro(raw) * 1000.0f);
+      int32_t milli = accel ? imu.calcAccelMilli(raw) : imu.calcGyroMilli(raw);
+      bool tie = (x * micro) % 1000 == 500 || (x * micro) % 1000 == -500;
+      ties += tie;
+      if( milli == expected )
+        continue;
+      if( tie && labs(milli - expected) == 1 )
+        tiesFlipped++;
+      else
+        mismatches++;
+    }
+
+    uint32_t batchMismatches = batchMilliMismatches(imu, accel);
+
+    uint32_t fixedMismatches;
+    switch( i ){
+      case 0: fixedMismatches = fixedMilliMismatches<LSM6DSOAccelFS::g2, LSM6DSOGyroFS::dps250>(imu, true); break;
+      case 1: fixedMismatches = fixedMilliMismatches<LSM6DSOAccelFS::g4, LSM6DSOGyroFS::dps250>(imu, true); break;
+      case 2: fixedMismatches = fixedMilliMismatches<LSM6DSOAccelFS::g8, LSM6DSOGyroFS::dps250>(imu, true); break;
+      case 3: fixedMismatches = fixedMilliMismatches<LSM6DSOAccelFS::g16, LSM6DSOGyroFS::dps250>(imu, true); break;
+      case 4: fixedMismatches = fixedMilliMismatches<LSM6DSOAccelFS::g2, LSM6DSOGyroFS::dps125>(imu, false); break;
+      case 5: fixedMismatches = fixedMilliMismatches<LSM6DSOAccelFS::g2, LSM6DSOGyroFS::dps250>(imu, false); break;
+      case 6: fixedMismatches = fixedMilliMismatches<LSM6DSOAccelFS::g2, LSM6DSOGyroFS::dps500>(imu, false); break;
+      case 7: fixedMismatches = fixedMilliMismatches<LSM6DSOAccelFS::g2, LSM6DSOGyroFS::dps1000>(imu, false); break;
+      default: fixedMismatches = fixedMilliMismatches<LSM6DSOAccelFS::g2, LSM6DSOGyroFS::dps2000>(imu, false); break;
+    }
+
+    printf("  %s %4u%-3s %u mismatches, %u of %u half unit ties rounded the other way by float; "
+           "batch %u, fixed %u off calc*Milli()\n",
+           accel ? "accel" : "gyro ", accel ? ACCEL_RANGES[i] : GYRO_RANGES[i - 4], accel ? "g" : "dps",
+           (unsigned)mismatches, (unsigned)tiesFlipped, (unsigned)ties,
+           (unsigned)batchMismatches, (unsigned)fixedMismatches);
+    passed = passed && mismatches == 0 && batchMismatches == 0 && fixedMismatches == 0;
+  }
+  printf("  %s\n", passed ? "ok" : "FAILED");
+}
+
+// Batch counter events on INT1, stamped into a ring by the pin handler and
+// drained by the loop, as the ring's header describes. The counter fires
+// every 16 accelerometer samples, about every 10ms; a loop that waits
+// 100ms between drains overflows the 8 entry ring.
+#define RING_THRESHOLD 16
+
+static LSM6DSOEventRing<8> counterEvents;
+static uint32_t counterInterrupts;
+
+static void counterISR()
+{
+  counterInterrupts++;
+  counterEvents.push(micros());
+}
+
+static void ringEvents(uint32_t loopMs)
+{
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+  sim.attach(Wire);
+  sim.connectInterrupts(INT1_PIN);
+  imu.begin();
+  configureFifo(imu, false);
+
+  counterEvents.clear();
+  counterEvents.resetStatistics();
+  counterInterrupts = 0;
+  attachInterrupt(digitalPinToInterrupt(INT1_PIN), counterISR, RISING);
+
+  // Pulsed, so every threshold is an edge whether or not the loop has read
+  // FIFO_STATUS2 yet. RST_COUNTER_BDR must not stick in the shadow and
+  // restart the counter on every later threshold change.
+  imu.writeRegister(COUNTER_BDR_REG1, DATAREADY_PULSED_ENABLED | RST_COUNTER_BDR_ENABLED);
+  imu.setBatchCounterThreshold(RING_THRESHOLD);
+  imu.setInterruptOne(INT1_CNT_BDR_ENABLED);
+  bool resetCleared = !(imu.readShadow(COUNTER_BDR_REG1) & RST_COUNTER_BDR_ENABLED) &&
+                      (imu.readShadow(COUNTER_BDR_REG1) & DATAREADY_PULSED_ENABLED);
+
+  fifoData samples[256];
+  uint32_t stamps[8];
+  uint32_t popped = 0;
+  uint32_t accelSamples = 0;
+
+  uint64_t end = hostMicros() + RUN_MICROS;
+  while( hostMicros() < end ){
+    delay(loopMs);
+
+    uint8_t count;
+    while( (count = counterEvents.pop(stamps, 8)) > 0 )
+      popped += count;
+
+    uint16_t numSamples;
+    while( (numSamples = imu.fifoRead(samples, 256)) > 0 )
+      for( uint16_t i = 0; i < numSamples; i++ )
+        if( samples[i].fifoTag == ACCELEROMETER_DATA )
+          accelSamples++;
+  }
+  detachInterrupt(digitalPinToInterrupt(INT1_PIN));
+
+  uint16_t drops = counterEvents.getDropCount();
+  // Samples batched before the threshold was set aren't counted.
+  uint32_t thresholds = accelSamples / RING_THRESHOLD;
+  bool accounted = popped + counterEvents.available() + drops == counterInterrupts &&
+                   counterInterrupts <= thresholds && thresholds - counterInterrupts <= 1;
+
+  printf("INT1 batch counter, loop every %3ums: %u interrupts for %u accel samples, %u popped, %u dropped, "
+         "high water %u/%u%s%s\n",
+         (unsigned)loopMs, (unsigned)counterInterrupts, (unsigned)accelSamples, (unsigned)popped,
+         (unsigned)drops, (unsigned)counterEvents.getHighWater(), (unsigned)counterEvents.capacity(),
+         accounted ? "" : " (events unaccounted for)", resetCleared ? "" : " (RST_COUNTER_BDR kept)");
+}
+
+// Bus transfers to bring the sensor up at the benchmark settings, through
+// the runtime setters and through the compile time configured front end.
+static void initCost()
+{
+  LSM6DSOSimulator sim;
+  sim.attach(Wire);
+
+  LSM6DSO imu;
+  Wire.resetCounters();
+  imu.begin();
+  configure(imu);
+  uint32_t runtime = Wire.getTransactionCount();
+
+  LSM6DSOFixed<LSM6DSOAccelFS::g8, LSM6DSOOdr::Hz1660, LSM6DSOGyroFS::dps500> fixed;
+  Wire.resetCounters();
+  fixed.begin();
+  uint32_t compiled = Wire.getTransactionCount();
+
+  printf("\ninit transfers, I2C: runtime setters %u, LSM6DSOFixed %u\n", (unsigned)runtime, (unsigned)compiled);
+
+  // The 1.6Hz ODR code is 12.5Hz unless high performance mode is off.
+  imu.writeRegister(CTRL1_XL, ODR_XL_1_6Hz);
+  float highPerf = imu.getAccelDataRate();
+  imu.setHighPerfAccel(false);
+  float lowPower = imu.getAccelDataRate();
+  printf("ODR_XL_1_6Hz reads back %.1fHz in high performance mode, %.1fHz in low power: %s\n",
+         highPerf, lowPower, highPerf == 12.5f && lowPower == 1.6f ? "ok" : "FAILED");
+}
+
+// Writing and reading back 300 bytes of the advanced feature pages, across
+// a page boundary: a byte per transaction as the application note's
+// pseudo code does it, then writePage() and readPage().
+static void pageAccess()
+{
+  const uint16_t START = 0x04C0;
+  const uint16_t LENGTH = 300;
+
+  LSM6DSOSimulator sim;
+  sim.attach(Wire);
+  LSM6DSO imu;
+  imu.begin();
+
+  uint8_t pattern[LENGTH];
+  for( uint16_t i = 0; i < LENGTH; i++ )
+    pattern[i] = static_cast<uint8_t>(i * 7 + 3);
+
+  Wire.resetCounters();
+  imu.enableEmbeddedFunctions(true);
+  imu.writeRegister(PAGE_RW, PAGE_WRITE_ENABLED);
+  for( uint16_t i = 0; i < LENGTH; i++ ){
+    uint16_t position = START + i;
+    if( i == 0 || (position & 0xFF) == 0 ){
+      imu.writeRegister(PAGE_SEL, ((position >> 8) << PAGE_SEL_SHIFT) | PAGE_SEL_RESERVED);
+      imu.writeRegister(PAGE_ADDRESS, position & 0xFF);
+    }
+    imu.writeRegister(PAGE_VALUE, pattern[i]);
+  }
+  imu.writeRegister(PAGE_RW, PAGE_RW_DISABLED);
+  imu.enableEmbeddedFunctions(false);
+  uint32_t byteWise = Wire.getTransactionCount();
+
+  for( uint16_t i = 0; i < LENGTH; i++ )
+    pattern[i] ^= 0x5A;
+
+  // Latched embedded interrupts share PAGE_RW and must survive the access.
+  sim.pokeEmbedded(PAGE_RW, EMB_FUNC_LIR_ENABLED);
+
+  Wire.resetCounters();
+  bool success = imu.writePage(pattern, START, LENGTH) == IMU_SUCCESS;
+  uint32_t written = Wire.getTransactionCount();
+  bool latched = sim.peekEmbedded(PAGE_RW) == EMB_FUNC_LIR_ENABLED;
+
+  uint8_t readBack[LENGTH];
+  Wire.resetCounters();
+  success &= imu.readPage(readBack, START, LENGTH) == IMU_SUCCESS;
+  uint32_t read = Wire.getTransactionCount();
+
+  uint16_t mismatches = 0;
+  for( uint16_t i = 0; i < LENGTH; i++ ){
+    uint16_t position = START + i;
+    if( readBack[i] != pattern[i] || sim.peekPage(position >> 8, position & 0xFF) != pattern[i] )
+      mismatches++;
+  }
+
+  // A main bank access inside a guard is refused, and IF_INC is back after.
+  bool refused;
+  {
+    LSM6DSOEmbeddedBank bank(imu);
+    uint8_t regVal;
+    refused = imu.readRegister(&regVal, WHO_AM_I_REG) != IMU_SUCCESS;
+  }
+  bool restored = (sim.peekRegister(CTRL3_C) & IF_INC_ENABLED) && !(sim.peekRegister(FUNC_CFG_ACCESS) & 0x80);
+
+  printf("page access, %u bytes: byte-wise write %u transfers, writePage %u, readPage %u, %u mismatches%s, stray access %s, bank %s, EMB_FUNC_LIR %s\n",
+         (unsigned)LENGTH, (unsigned)byteWise, (unsigned)written, (unsigned)read, (unsigned)mismatches,
+         success ? "" : " (failed)", refused ? "refused" : "let through", restored ? "restored" : "left open",
+         latched ? "kept" : "lost");
+}
+
+// Three programs of 24, 40 and 56 bytes in the image format. Only the
+// program headers are meaningful; the simulator stores programs but
+// doesn't run them.
+static uint8_t fsmImage[FSM_IMAGE_HEADER_LENGTH + 24 + 40 + 56];
+
+static void fsmAccess()
+{
+  const uint8_t sizes[3] = { 24, 40, 56 };
+
+  fsmImage[0] = 3;
+  fsmImage[1] = FSM_ODR_52Hz;
+  fsmImage[2] = 0x10;
+  fsmImage[3] = 0x00;
+  uint16_t offset = FSM_IMAGE_HEADER_LENGTH;
+  for( uint8_t p = 0; p < 3; p++ ){
+    for( uint8_t i = 0; i < sizes[p]; i++ )
+      fsmImage[offset + i] = static_cast<uint8_t>(p * 31 + i);
+    fsmImage[offset + FSM_PROGRAM_SIZE_OFFSET] = sizes[p];
+    offset += sizes[p];
+  }
+
+  LSM6DSOSimulator sim;
+  sim.attach(Wire);
+  LSM6DSO imu;
+  imu.begin();
+
+  Wire.resetCounters();
+  bool loaded = lsm6dsoLoadFsm(imu, fsmImage, sizeof(fsmImage));
+  uint32_t loadTransfers = Wire.getTransactionCount();
+
+  uint16_t mismatches = 0;
+  for( uint16_t i = 0; i < sizeof(fsmImage) - FSM_IMAGE_HEADER_LENGTH; i++ ){
+    uint16_t position = FSM_START_ADDRESS + i;
+    if( sim.peekPage(position >> 8, position & 0xFF) != fsmImage[FSM_IMAGE_HEADER_LENGTH + i] )
+      mismatches++;
+  }
+  if( sim.peekPage(FSM_PROGRAMS >> 8, FSM_PROGRAMS & 0xFF) != 3 || sim.peekEmbedded(FSM_ENABLE_A) != 0x07 ||
+      !(sim.peekEmbedded(EMB_FUNC_EN_B) & FSM_EN) || ((sim.peekEmbedded(EMB_FUNC_ODR_CFG_B) >> FSM_ODR_SHIFT) & 0x07) != FSM_ODR_52Hz )
+    mismatches++;
+
+  for( uint8_t i = 0; i < FSM_MAX_PROGRAMS; i++ )
+    sim.pokeEmbedded(FSM_OUTS1 + i, 0xA0 + i);
+
+  fsmOutputs outputs;
+  Wire.resetCounters();
+  bool read = lsm6dsoReadFsmOutputs(imu, outputs);
+  uint32_t readTransfers = Wire.getTransactionCount();
+  for( uint8_t i = 0; i < FSM_MAX_PROGRAMS; i++ )
+    if( outputs.outs[i] != 0xA0 + i )
+      mismatches++;
+
+  // Register by register, each FSM_OUTS with its own bank switch.
+  Wire.resetCounters();
+  for( uint8_t i = 0; i < FSM_MAX_PROGRAMS; i++ ){
+    uint8_t regVal;
+    imu.enableEmbeddedFunctions(true);
+    imu.readRegister(&regVal, FSM_OUTS1 + i);
+    imu.enableEmbeddedFunctions(false);
+  }
+  uint32_t naiveTransfers = Wire.getTransactionCount();
+
+  printf("FSM: %u byte image loaded in %u transfers%s, outputs read in %u (register by register %u), %u mismatches\n",
+         (unsigned)sizeof(fsmImage), (unsigned)loadTransfers, loaded ? "" : " (failed)",
+         (unsigned)readTransfers, (unsigned)naiveTransfers, (unsigned)mismatches + (read ? 0 : 1));
+}
+
+// A .ucf laid out the way ST's tools export a state machine setup: main
+// bank configuration, the embedded function registers, the FSM settings
+// and a 440 byte program through PAGE_VALUE, then the data rates. Applied
+// line by line with writeRegister() on one simulator and as a compiled
+// script on another, then every register and page is compared.
+static void ucfReplay()
+{
+  std::string ucf = "--LSM6DSO configuration\n";
+  char line[32];
+  for( uint8_t address = CTRL1_XL; address <= CTRL10_C; address++ ){
+    snprintf(line, sizeof(line), "Ac %02X %02X\n", address, address == CTRL3_C ? 0x44 : 0x00);
+    ucf += line;
+  }
+  ucf += "Ac 01 80\nAc 04 00\nAc 05 01\nAc 5F 53\nAc 46 07\nAc 47 00\n"
+         "Ac 0A 00\nAc 0B 07\nAc 0C 00\nAc 0E 00\nAc 0F 00\nAc 10 00\n"
+         "Ac 17 40\nAc 02 11\nAc 08 7A\nAc 09 10\nAc 09 00\nAc 09 03\nAc 09 00\nAc 09 00\nAc 09 04\n";
+  for( uint16_t i = 0; i < 440; i++ ){
+    uint16_t position = FSM_START_ADDRESS + i;
+    if( i == 0 || (position & 0xFF) == 0 ){
+      snprintf(line, sizeof(line), "Ac 02 %02X\nAc 08 %02X\n", ((position >> 8) << PAGE_SEL_SHIFT) | PAGE_SEL_RESERVED, position & 0xFF);
+      ucf += line;
+    }
+    snprintf(line, sizeof(line), "Ac 09 %02X\n", (i * 37 + 11) & 0xFF);
+    ucf += line;
+  }
+  ucf += "Ac 02 01\nAc 17 00\nAc 04 00\nAc 05 01\nAc 01 00\n"
+         "WAIT 2\nAc 10 40\nAc 11 40\nAc 5E 02\n";
+
+  LSM6DSOUcfCompiler compiler;
+  if( !compiler.compile(ucf.data(), ucf.size()) ){
+    printf("ucf: line %u: %s\n", (unsigned)compiler.getErrorLine(), compiler.getError().c_str());
+    return;
+  }
+
+  LSM6DSOSimulator lineSim, scriptSim;
+  lineSim.attach(Wire, DEFAULT_ADDRESS);
+  scriptSim.attach(Wire, ALT_ADDRESS);
+  LSM6DSO lineImu, scriptImu;
+  lineImu.begin(DEFAULT_ADDRESS);
+  scriptImu.begin(ALT_ADDRESS);
+
+  Wire.resetCounters();
+  for( size_t position = 0; position < ucf.size(); ){
+    size_t end = ucf.find('\n', position);
+    unsigned address, value;
+    if( sscanf(ucf.c_str() + position, "Ac %x %x", &address, &value) == 2 )
+      lineImu.writeRegister(address, value);
+    else if( sscanf(ucf.c_str() + position, "WAIT %u", &value) == 1 )
+      delay(value);
+    position = end + 1;
+  }
+  uint32_t lineTransfers = Wire.getTransactionCount();
+
+  Wire.resetCounters();
+  bool applied = scriptImu.writeScript(compiler.getScript().data()) == IMU_SUCCESS;
+  uint32_t scriptTransfers = Wire.getTransactionCount();
+
+  // Output, timestamp and FIFO registers move on their own.
+  uint32_t differences = 0;
+  for( uint16_t address = 0; address < 0x80; address++ ){
+    bool live = address == STATUS_REG || (address >= OUT_TEMP_L && address <= OUTZ_H_A) ||
+                address == FIFO_STATUS1 || address == FIFO_STATUS2 ||
+                (address >= TIMESTAMP0_REG && address <= TIMESTAMP0_REG + 3) || address >= FIFO_DATA_OUT_TAG;
+    if( !live && lineSim.peekRegister(address) != scriptSim.peekRegister(address) )
+      differences++;
+    if( lineSim.peekEmbedded(address) != scriptSim.peekEmbedded(address) )
+      differences++;
+  }
+  for( uint16_t position = 0; position < 0x1000; position++ )
+    if( lineSim.peekPage(position >> 8, position & 0xFF) != scriptSim.peekPage(position >> 8, position & 0xFF) )
+      differences++;
+
+  printf("ucf: %u writes, %u waits: line by line %u transfers, script %u bursts, %u bytes, %u transfers%s, %u differences\n",
+         (unsigned)compiler.getWrites(), (unsigned)compiler.getWaits(), (unsigned)lineTransfers,
+         (unsigned)compiler.getBursts(), (unsigned)compiler.getScript().size(), (unsigned)scriptTransfers,
+         applied ? "" : " (failed)", (unsigned)differences);
+}
+
+// Level for 200ms, then rolling about X at 30 dps for three seconds to 90
+// degrees and holding there.
+#define ROLL_DPS 30.0
+#define ROLL_SECONDS 3.0
+static double rollStartSeconds;
+
+static void rollMotion(double seconds, SimMotion &motion)
+{
+  double t = seconds - rollStartSeconds;
+  double rolling = t < 0 ? 0 : t > ROLL_SECONDS ? ROLL_SECONDS : t;
+  double angle = ROLL_DPS * rolling * M_PI / 180;
+
+  motion.accel[0] = 0;
+  motion.accel[1] = sin(angle);
+  motion.accel[2] = cos(angle);
+  motion.gyro[0] = t >= 0 && t < ROLL_SECONDS ? ROLL_DPS : 0;
+  motion.gyro[1] = 0;
+  motion.gyro[2] = 0;
+  motion.temperatureC = 27.5;
+}
+
+static float rollError(float w, float x, float y, float z)
+{
+  float roll, pitch, yaw;
+  lsm6dsoQuaternionToEuler(w, x, y, z, roll, pitch, yaw);
+  return fmaxf(fabsf(roll - static_cast<float>(ROLL_DPS * ROLL_SECONDS)), fabsf(pitch));
+}
+
+// Madgwick and Mahony through updateFifo() with sensor timestamps; then
+// LSM6DSOMahonyQ30 and the float Mahony filter given the same raw counts
+// and nominal step, to compare the integer version with the original.
+static void ahrsAccuracy()
+{
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+  sim.attachSPI(SPI, CS_PIN);
+  sim.setMotion(rollMotion);
+  imu.beginSPI(CS_PIN);
+  configureFifo(imu, false);
+  imu.enableTimestamp();
+
+  LSM6DSOAhrs madgwick(AHRS_MADGWICK);
+  LSM6DSOAhrs mahony(AHRS_MAHONY);
+  LSM6DSOAhrs mahonyRaw(AHRS_MAHONY);
+  LSM6DSOMahonyQ30 mahonyQ30;
+
+  uint16_t gyroMilliScale = imu.getGyroMilliScale();
+  mahonyQ30.setGyroMilliScale(gyroMilliScale);
+  const float dpsPerCount = gyroMilliScale / (1000.0f * (1 << GYRO_MILLI_SHIFT));
+  const uint32_t STEP_NS = 1000000000UL / SAMPLE_RATE;
+
+  int16_t accelRaw[3] = { 0, 0, 0 };
+  bool accelSeen = false;
+  float q30Difference = 0;
+
+  uint8_t words[FIFO_WORDS_PER_BURST * FIFO_WORD_LENGTH];
+  fifoData samples[FIFO_WORDS_PER_BURST];
+  rollStartSeconds = hostMicros() / 1e6 + 0.2;
+  uint64_t end = hostMicros() + static_cast<uint64_t>((ROLL_SECONDS + 1.2) * 1e6);
+
+  while( hostMicros() < end ){
+    delay(DRAIN_PERIOD_MS);
+
+    uint16_t unread = imu.getUnreadFifoWords();
+    while( unread > 0 ){
+      uint16_t burst = unread > FIFO_WORDS_PER_BURST ? FIFO_WORDS_PER_BURST : unread;
+      if( imu.fifoReadWords(words, burst) != burst )
+        break;
+      unread -= burst;
+
+      uint16_t count = 0;
+      for( uint16_t i = 0; i < burst; i++ ){
+        const uint8_t *word = &words[i * FIFO_WORD_LENGTH];
+        count += imu.decodeFifoWord(word, &samples[count]);
+
+        int16_t raw[3];
+        for( uint8_t axis = 0; axis < 3; axis++ )
+          raw[axis] = static_cast<int16_t>(word[1 + 2 * axis] | (word[2 + 2 * axis] << 8));
+
+        uint8_t tag = word[0] >> 3;
+        if( tag == ACCELEROMETER_DATA ){
+          memcpy(accelRaw, raw, sizeof(raw));
+          accelSeen = true;
+        }
+        else if( tag == GYROSCOPE_DATA && accelSeen ){
+          mahonyQ30.update(raw, accelRaw, STEP_NS);
+          mahonyRaw.update(raw[0] * dpsPerCount, raw[1] * dpsPerCount, raw[2] * dpsPerCount,
+                           accelRaw[0], accelRaw[1], accelRaw[2], STEP_NS * 1e-9f);
+
+          float fixed[4], floating[4];
+          mahonyQ30.getQuaternion(fixed[0], fixed[1], fixed[2], fixed[3]);
+          mahonyRaw.getQuaternion(floating[0], floating[1], floating[2], floating[3]);
+          for( uint8_t j = 0; j < 4; j++ )
+            q30Difference = fmaxf(q30Difference, fabsf(fixed[j] - floating[j]));
+        }
+      }
+
+      madgwick.updateFifo(samples, count);
+      mahony.updateFifo(samples, count);
+    }
+  }
+
+  float w, x, y, z;
+  madgwick.getQuaternion(w, x, y, z);
+  float madgwickError = rollError(w, x, y, z);
+  mahony.getQuaternion(w, x, y, z);
+  float mahonyError = rollError(w, x, y, z);
+  mahonyQ30.getQuaternion(w, x, y, z);
+  float q30Error = rollError(w, x, y, z);
+
+  printf("AHRS, %.0f dps to %.0f deg roll: Madgwick error %.3f deg, Mahony %.3f deg, "
+         "Mahony Q30 %.3f deg, Q30 against float on the same counts %.1e\n",
+         ROLL_DPS, ROLL_DPS * ROLL_SECONDS, madgwickError, mahonyError, q30Error, q30Difference);
+}
+
+// Host CPU cost of one LSM6DSOEkf step, predict alone and predict plus an
+// accelerometer correction. Cycles are TSC ticks where the machine has one.
+static void ekfCost()
+{
+  const int STEPS = 200000;
+  const float DT = 1.0f / SAMPLE_RATE;
+
+  LSM6DSOEkf ekf;
+  ekf.correct(0, 0, 1);
+
+  double predictNs[2];
+  double predictCycles[2] = { 0, 0 };
+
+  for( int pass = 0; pass < 2; pass++ ){
+#ifdef HOST_CYCLES
+    uint64_t cycleStart = HOST_CYCLES();
+#endif
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for( int i = 0; i < STEPS; i++ ){
+      float phase = i * DT;
+      if( pass == 0 )
+        ekf.predict(1.0f, -0.5f, 0.25f, DT);
+      else
+        ekf.update(1.0f, -0.5f, 0.25f, 0.01f * phase, 0, 1.0f, DT);
+    }
+    predictNs[pass] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / STEPS;
+#ifdef HOST_CYCLES
+    predictCycles[pass] = static_cast<double>(HOST_CYCLES() - cycleStart) / STEPS;
+#endif
+  }
+
+  printf("EKF step (host CPU): predict %.0f ns / %.0f cycles, predict+correct %.0f ns / %.0f cycles, budget at %uHz %.0f ns\n",
+         predictNs[0], predictCycles[0], predictNs[1], predictCycles[1], SAMPLE_RATE, 1e9 / SAMPLE_RATE);
+}
+
+// A board with a known accelerometer offset and scale and gyroscope bias,
+// turned through the six calibration positions. calibrationPosition picks
+// the axis pointing up (axis * 2) or down (axis * 2 + 1).
+static const double TRUE_OFFSET[3] = { 0.030, -0.020, 0.045 };     // g
+static const double TRUE_SCALE[3] = { 1.010, 0.985, 1.020 };
+static const double TRUE_BIAS[3] = { 0.50, -0.30, 0.80 };          // dps
+static int calibrationPosition;
+
+static void calibrationMotion(double seconds, SimMotion &motion)
+{
+  static std::mt19937 generator(2);
+  std::normal_distribution<double> accelNoise(0, 0.002);
+  std::normal_distribution<double> gyroNoise(0, 0.11);
+  (void)seconds;
+
+  for( int i = 0; i < 3; i++ ){
+    double gravity = 0;
+    if( calibrationPosition / 2 == i )
+      gravity = calibrationPosition % 2 ? -1 : 1;
+    motion.accel[i] = TRUE_SCALE[i] * gravity + TRUE_OFFSET[i] + accelNoise(generator);
+    motion.gyro[i] = TRUE_BIAS[i] + gyroNoise(generator);
+  }
+  motion.temperatureC = 25;
+}
+
+// Fresh FIFO data for 200ms in the current position, into the calibrator
+// or, without one, averaged into zMean.
+static void calibrationCapture(LSM6DSO &imu, LSM6DSOCalibrator *calibrator,
+                               const imuCalibration *correction, double zMean[2])
+{
+  imu.setFifoMode(FIFO_MODE_DISABLED);
+  imu.setFifoMode(FIFO_MODE_CONTINUOUS);
+
+  fifoData samples[128];
+  uint32_t count = 0;
+  zMean[0] = zMean[1] = 0;
+
+  for( int i = 0; i < 20; i++ ){
+    delay(DRAIN_PERIOD_MS);
+    uint16_t numSamples = imu.fifoRead(samples, 128);
+    if( calibrator )
+      calibrator->addSamples(samples, numSamples);
+    for( uint16_t j = 0; correction && j < numSamples; j++ ){
+      if( samples[j].fifoTag != ACCELEROMETER_DATA )
+        continue;
+      zMean[0] += samples[j].zAccel;
+      lsm6dsoCorrectSample(*correction, samples[j]);
+      zMean[1] += samples[j].zAccel;
+      count++;
+    }
+  }
+
+  if( count > 0 ){
+    zMean[0] /= count;
+    zMean[1] /= count;
+  }
+}
+
+static void calibration()
+{
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+  sim.attach(Wire);
+  sim.setMotion(calibrationMotion);
+  imu.begin();
+  configureFifo(imu, false);
+
+  LSM6DSOCalibrator calibrator(imu);
+  calibrator.begin();
+
+  double zMean[2];
+  for( calibrationPosition = 0; calibrationPosition < 6; calibrationPosition++ ){
+    calibrator.startCapture();
+    calibrationCapture(imu, &calibrator, NULL, zMean);
+    calibrator.finishCapture();
+  }
+
+  imuCalibration result;
+  bool solved = calibrator.solve(result) && calibrator.getPositions() == CALIBRATION_ALL_POSITIONS;
+
+  double weight = result.accelOffsetWeight == USER_OFFSET_2_6 ? 1.0 / 64 : 1.0 / 1024;
+  double offsetError = 0, scaleError = 0, biasError = 0;
+  for( int i = 0; i < 3; i++ ){
+    offsetError = fmax(offsetError, fabs(result.accelOffset[i] * weight - TRUE_OFFSET[i]));
+    scaleError = fmax(scaleError, fabs(result.accelScale[i] - TRUE_SCALE[i]));
+    biasError = fmax(biasError, fabs(result.gyroBias[i] - TRUE_BIAS[i]));
+  }
+  // Within a step of the offset weight, noise included.
+  bool recovered = solved && offsetError <= 1.5 * weight && scaleError < 0.002 && biasError < 0.05;
+
+  // The blob round trip, and a flipped bit caught by the CRC.
+  uint8_t blob[CALIBRATION_BLOB_LENGTH];
+  imuCalibration restored;
+  uint8_t length = lsm6dsoPackCalibration(result, blob);
+  bool roundTrip = lsm6dsoUnpackCalibration(blob, length, restored) &&
+                   memcmp(restored.accelOffset, result.accelOffset, 3) == 0 &&
+                   memcmp(restored.accelScale, result.accelScale, sizeof(result.accelScale)) == 0 &&
+                   memcmp(restored.gyroBias, result.gyroBias, sizeof(result.gyroBias)) == 0;
+  blob[12] ^= 0x04;
+  bool corruptionCaught = !lsm6dsoUnpackCalibration(blob, length, restored);
+
+  // Z up with the offset in the sensor: raw keeps the scale error, the
+  // corrected sample doesn't.
+  calibrationPosition = 4;
+  bool applied = lsm6dsoApplyCalibration(imu, result);
+  calibrationCapture(imu, NULL, &result, zMean);
+
+  printf("calibration: offset error %.4f g, scale error %.4f, gyro bias error %.3f dps: %s; "
+         "FIFO z %.4f g raw, %.4f g corrected%s; blob %s, corruption %s\n",
+         offsetError, scaleError, biasError, recovered ? "recovered" : "NOT recovered",
+         zMean[0], zMean[1], applied ? "" : " (offset not applied)",
+         roundTrip ? "round trip ok" : "round trip FAILED", corruptionCaught ? "caught" : "MISSED");
+}
+
+// Collects whatever is printed, standing in for a serial port.
+class CapturePrint : public Print
+{
+  public:
+    std::vector<uint8_t> bytes;
+
+    using Print::write;
+    size_t write(uint8_t c) { bytes.push_back(c); return 1; }
+    size_t write(const uint8_t *buffer, size_t size) { bytes.insert(bytes.end(), buffer, buffer + size); return size; }
+};
+
+// One second of FIFO data sent on as text, the way the example sketch
+// prints, and as LSM6DSOStreamEncoder frames, then decoded again.
+static void streamOutput()
+{
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+  sim.attachSPI(SPI, CS_PIN);
+  imu.beginSPI(CS_PIN);
+  configureFifo(imu, false);
+  imu.enableTimestamp();
+
+  std::vector<uint8_t> words;
+  uint64_t end = hostMicros() + RUN_MICROS;
+  while( hostMicros() < end ){
+    delay(DRAIN_PERIOD_MS);
+    uint16_t unread = imu.getUnreadFifoWords();
+    size_t used = words.size();
+    words.resize(used + unread * FIFO_WORD_LENGTH);
+    uint16_t count = imu.fifoReadWords(&words[used], unread);
+    words.resize(used + count * FIFO_WORD_LENGTH);
+  }
+  uint16_t numWords = words.size() / FIFO_WORD_LENGTH;
+
+  CapturePrint text;
+  fifoData samples[FIFO_MAX_SAMPLES_PER_WORD];
+  imu.resetFifoDecoder();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for( uint16_t i = 0; i < numWords; i++ ){
+    uint8_t count = imu.decodeFifoWord(&words[i * FIFO_WORD_LENGTH], samples);
+    for( uint8_t j = 0; j < count; j++ ){
+      if( samples[j].fifoTag == GYROSCOPE_DATA ){
+        text.println(samples[j].xGyro, 3);
+        text.println(samples[j].yGyro, 3);
+        text.println(samples[j].zGyro, 3);
+      }
+      else if( samples[j].fifoTag == ACCELEROMETER_DATA ){
+        text.println(samples[j].xAccel, 3);
+        text.println(samples[j].yAccel, 3);
+        text.println(samples[j].zAccel, 3);
+      }
+    }
+  }
+  double textMicros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+  CapturePrint binary;
+  LSM6DSOStreamEncoder encoder(binary);
+  imu.resetFifoDecoder();
+  start = std::chrono::steady_clock::now();
+  encoder.begin(imu);
+  encoder.addFifoWords(imu, &words[0], numWords);
+  encoder.flush();
+  double binaryMicros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+  // The decoded milli fields have to match the scalar path on the sensor.
+  LSM6DSOStreamDecoder decoder;
+  streamRecord record;
+  uint32_t records = 0;
+  uint32_t milliMismatches = 0;
+  for( size_t i = 0; i < binary.bytes.size(); i++ )
+    if( decoder.push(binary.bytes[i]) )
+      for( uint8_t j = 0; decoder.getRecord(j, record); j++ ){
+        for( uint8_t k = 0; k < 3; k++ )
+          if( record.milliGyro[k] != imu.calcGyroMilli(record.rawGyro[k]) ||
+              record.milliAccel[k] != imu.calcAccelMilli(record.rawAccel[k]) )
+            milliMismatches++;
+        records++;
+      }
+
+  printf("1s of 6-axis output: text %u bytes (%.0f us host CPU), binary %u bytes (%.0f us), "
+         "%u records decoded, %u bad frames, %u milli mismatches\n",
+         (unsigned)text.bytes.size(), textMicros, (unsigned)binary.bytes.size(), binaryMicros,
+         (unsigned)records, (unsigned)decoder.getCrcErrors(), (unsigned)milliMismatches);
+}
+
+// Walking-like motion plus white noise at the datasheet densities over an
+// 830 Hz bandwidth, about 2 mg and 0.11 dps rms. Without it the simulator is
+// perfectly smooth and any delta coder looks better than it is.
+static void noisyMotion(double seconds, SimMotion &motion)
+{
+  static std::mt19937 generator(1);
+  std::normal_distribution<double> accelNoise(0, 0.002);
+  std::normal_distribution<double> gyroNoise(0, 0.11);
+  double step = 2 * M_PI * 1.8 * seconds;
+
+  motion.accel[0] = 0.15 * sin(step) + accelNoise(generator);
+  motion.accel[1] = 0.05 * sin(0.5 * step) + accelNoise(generator);
+  motion.accel[2] = 1.0 + 0.25 * sin(step + 0.3) + accelNoise(generator);
+  motion.gyro[0] = 20 * sin(step) + gyroNoise(generator);
+  motion.gyro[1] = 8 * sin(0.5 * step + 1) + gyroNoise(generator);
+  motion.gyro[2] = 5 + 15 * sin(0.5 * step) + gyroNoise(generator);
+  motion.temperatureC = 27.5;
+}
+
+// Collects the dates lsm6dsoPairFifoWords() hands to an encoder.
+struct TickSink {
+  std::vector<uint32_t> ticks;
+
+  bool addSample(const int16_t gyro[3], const int16_t accel[3], uint32_t sampleTicks)
+  {
+    (void)gyro;
+    (void)accel;
+    ticks.push_back(sampleTicks);
+    return false;
+  }
+};
+
+static void logCompression()
+{
+  LSM6DSOSimulator sim;
+  LSM6DSO imu;
+  sim.attachSPI(SPI, CS_PIN);
+  sim.setMotion(noisyMotion);
+  imu.beginSPI(CS_PIN);
+  configureFifo(imu, false);
+  imu.enableTimestamp();
+
+  // Draining stops once for 400ms, long enough for the 400 word FIFO to
+  // overrun, so the recording has a gap that blocks must not span.
+  std::vector<uint8_t> words;
+  uint64_t start = hostMicros();
+  uint64_t end = start + RUN_MICROS;
+  bool paused = false;
+  while( hostMicros() < end ){
+    if( !paused && hostMicros() - start > RUN_MICROS / 2 ){
+      delay(400);
+      paused = true;
+    }
+    delay(DRAIN_PERIOD_MS);
+    uint16_t unread = imu.getUnreadFifoWords();
+    size_t used = words.size();
+    words.resize(used + unread * FIFO_WORD_LENGTH);
+    uint16_t count = imu.fifoReadWords(&words[used], unread);
+    words.resize(used + count * FIFO_WORD_LENGTH);
+  }
+  uint16_t numWords = words.size() / FIFO_WORD_LENGTH;
+
+  // The time of every pair as the FIFO decoder dates it, to check the
+  // period based dating of blocks against.
+  TickSink truth;
+  fifoPairState pairing = fifoPairState();
+  imu.resetFifoDecoder();
+  lsm6dsoPairFifoWords(imu, &words[0], numWords, pairing, truth);
+
+  CapturePrint binary;
+  LSM6DSOStreamEncoder stream(binary);
+  imu.resetFifoDecoder();
+  stream.begin(imu);
+  stream.addFifoWords(imu, &words[0], numWords);
+  stream.flush();
+
+  const int passes = 20;
+  CapturePrint compressed;
+  LSM6DSOLogEncoder encoder(compressed);
+  std::chrono::steady_clock::time_point clock = std::chrono::steady_clock::now();
+  for( int pass = 0; pass < passes; pass++ ){
+    compressed.bytes.clear();
+    imu.resetFifoDecoder();
+    encoder.begin(imu);
+    encoder.addFifoWords(imu, &words[0], numWords);
+    encoder.flush();
+  }
+  double encodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - clock).count();
+
+  // Every decoded sample must match the uncompressed stream, and be dated
+  // within a tick or two of the decoder's time; a reader stopping early
+  // counts too.
+  LSM6DSOStreamDecoder decoder;
+  std::vector<streamRecord> expected;
+  streamRecord record;
+  for( size_t i = 0; i < binary.bytes.size(); i++ )
+    if( decoder.push(binary.bytes[i]) )
+      for( uint8_t j = 0; decoder.getRecord(j, record); j++ )
+        expected.push_back(record);
+
+  LSM6DSOLogReader reader(&compressed.bytes[0], compressed.bytes.size());
+  uint32_t records = 0;
+  uint32_t mismatches = 0;
+  uint32_t worstTicks = 0;
+  clock = std::chrono::steady_clock::now();
+  for( int pass = 0; pass < passes; pass++ ){
+    reader.rewind();
+    records = 0;
+    mismatches = 0;
+    while( reader.read(record) ){
+      if( records >= expected.size() || records >= truth.ticks.size() )
+        mismatches++;
+      else {
+        for( uint8_t i = 0; i < 3; i++ )
+          if( record.rawGyro[i] != expected[records].rawGyro[i] ||
+              record.rawAccel[i] != expected[records].rawAccel[i] ||
+              record.milliGyro[i] != expected[records].milliGyro[i] ||
+              record.milliAccel[i] != expected[records].milliAccel[i] )
+            mismatches++;
+
+        int32_t tickError = static_cast<int32_t>(record.ticks - truth.ticks[records]);
+        uint32_t ticksOff = tickError < 0 ? -tickError : tickError;
+        if( ticksOff > worstTicks )
+          worstTicks = ticksOff;
+        if( ticksOff > 2 || static_cast<int32_t>(expected[records].ticks - truth.ticks[records]) > 2 ||
+            static_cast<int32_t>(truth.ticks[records] - expected[records].ticks) > 2 )
+          mismatches++;
+      }
+      records++;
+    }
+    if( records != expected.size() || records != truth.ticks.size() )
+      mismatches++;
+  }
+  double decodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - clock).count();
+
+  uint32_t middle = expected[expected.size() / 2].ticks;
+  bool seekOk = reader.seekTicks(middle) && reader.read(record) &&
+                static_cast<int32_t>(record.ticks - middle) <= 0;
+
+  // Offline side: index the three recorded forms in place, then check
+  // binary searched lookups against a linear scan of the column.
+  clock = std::chrono::steady_clock::now();
+  LSM6DSOStreamFile streamFile;
+  LSM6DSOLogFile logFile;
+  LSM6DSOFifoDump dump;
+  bool opened = streamFile.open(&binary.bytes[0], binary.bytes.size()) &&
+                logFile.open(&compressed.bytes[0], compressed.bytes.size()) &&
+                dump.open(&words[0], words.size());
+  double indexMicros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - clock).count();
+
+  const int lookups = 1000;
+  uint32_t wrongLookups = 0;
+  uint64_t origin = streamFile.ticks(0);
+  uint64_t span = streamFile.ticks(streamFile.size() - 1) - origin;
+  std::mt19937 generator(2);
+  std::vector<uint64_t> targets;
+  for( int i = 0; i < lookups; i++ )
+    targets.push_back(origin + generator() % (span + 1));
+
+  clock = std::chrono::steady_clock::now();
+  size_t found = 0;
+  for( int i = 0; i < lookups; i++ )
+    found += streamFile.findTicks(targets[i]);
+  double lookupNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - clock).count();
+
+  LSM6DSOStreamFile::Column gyroX = streamFile.column(AXIS_GYRO_X);
+  for( int i = 0; i < lookups; i++ ){
+    size_t sample = streamFile.findTicks(targets[i]);
+    size_t scan = 0;
+    while( scan < streamFile.size() && streamFile.ticks(scan) < targets[i] )
+      scan++;
+    if( sample != scan || (sample < streamFile.size() && gyroX[sample] != expected[sample].rawGyro[0]) )
+      wrongLookups++;
+  }
+
+  fifoDumpSample fifoSample;
+  LSM6DSOFifoDump::Cursor cursor(dump);
+  uint32_t fifoSamples = 0;
+  while( cursor.next(fifoSample) )
+    fifoSamples++;
+
+  printf("offline index: %u frames, %u blocks, %u FIFO seek points (%u ticks/slot, %u samples) in %.0f us, "
+         "findTicks %.0f ns, %u wrong lookups%s\n",
+         (unsigned)streamFile.getFrames(), (unsigned)logFile.getBlocks(), (unsigned)dump.getIndex().size(),
+         (unsigned)dump.getSlotTicks(), (unsigned)fifoSamples, indexMicros, lookupNs / lookups,
+         (unsigned)wrongLookups, opened ? "" : ", open failed");
+
+  uint32_t samples = encoder.getSamples();
+  printf("compressed log: %u samples, stream %u bytes, log %u bytes (%.2fx smaller than raw, "
+         "%.1f ns/sample encode, %.1f ns/sample decode), %u of %u read, %u mismatches, "
+         "worst date %u ticks off, seek %s\n",
+         (unsigned)samples, (unsigned)binary.bytes.size(), (unsigned)compressed.bytes.size(),
+         samples * 12.0 / compressed.bytes.size(), encodeNs / passes / samples,
+         decodeNs / passes / samples, (unsigned)records, (unsigned)truth.ticks.size(),
+         (unsigned)mismatches, (unsigned)worstTicks, seekOk ? "ok" : "failed");
+}
+
+// Gyro Z saws from -1800 to +1800 dps once a second, so a sample's value
+// says when within the second it was taken, to 20us per LSB at 2000dps.
+#define SAW_DPS 1800.0
+
+static void sawMotion(double seconds, SimMotion &motion)
+{
+  double phase = seconds - floor(seconds);
+  motion.accel[0] = 0;
+  motion.accel[1] = 0;
+  motion.accel[2] = 1;
+  motion.gyro[0] = 0;
+  motion.gyro[1] = 0;
+  motion.gyro[2] = -SAW_DPS + 2 * SAW_DPS * phase;
+  motion.temperatureC = 27.5;
+}
+
+// Distance in us between a time and the one the saw value implies, modulo
+// the one second period. Samples near the jump say nothing and give -1.
+static double sawError(uint64_t timeNs, int16_t rawGyroZ)
+{
+  double dps = rawGyroZ * 0.070;
+  if( fabs(dps) > SAW_DPS - 100 )
+    return -1;
+
+  double implied = (dps + SAW_DPS) / (2 * SAW_DPS);
+  double actual = (timeNs % 1000000000ULL) / 1e9;
+  double error = fabs(actual - implied);
+  if( error > 0.5 )
+    error = 1 - error;
+  return error * 1e6;
+}
+
+struct GroupSink {
+  uint32_t samples;
+  double errorSum[LSM6DSO_GROUP_MAX];
+  uint32_t errorCount[LSM6DSO_GROUP_MAX];
+
+  bool addSample(uint8_t member, uint8_t sensorTag, const int16_t raw[3], uint64_t timeNs)
+  {
+    samples++;
+    if( sensorTag == GYROSCOPE_DATA && timeNs != 0 ){
+      double error = sawError(timeNs, raw[2]);
+      if( error >= 0 ){
+        errorSum[member] += error;
+        errorCount[member]++;
+      }
+    }
+    return true;
+  }
+};
+
+#define GROUP_SENSORS 4
+#define GROUP_RATE 416
+
+// Four sensors on two 400kHz buses with clock trims up to 1.2% apart, a
+// gyro saw tooth telling each sample's true time. Naively each one is
+// drained in turn the way the examples drain one, getUnreadFifoWords() and
+// fifoRead() into a 64 entry buffer.
+static void sensorGroup(bool grouped, bool idleMember = false)
+{
+  static TwoWire secondBus;
+  TwoWire *buses[2] = { &Wire, &secondBus };
+  const int8_t trims[GROUP_SENSORS] = { -5, 3, 8, -2 };
+
+  LSM6DSOSimulator sims[GROUP_SENSORS];
+  LSM6DSO imus[GROUP_SENSORS];
+  LSM6DSOGroup group;
+
+  for( uint8_t i = 0; i < GROUP_SENSORS; i++ ){
+    TwoWire &bus = *buses[i % 2];
+    uint8_t address = i < 2 ? DEFAULT_ADDRESS : ALT_ADDRESS;
+    bus.setClock(400000);
+    sims[i].attach(bus, address);
+    sims[i].setInternalFreqFine(trims[i]);
+    sims[i].setMotion(sawMotion);
+    imus[i].begin(address, bus);
+
+    imus[i].setAccelRange(8);
+    imus[i].setAccelDataRate(GROUP_RATE);
+    imus[i].setGyroRange(2000);
+    imus[i].setGyroDataRate(GROUP_RATE);
+    // An idle member batches nothing, so its FIFO never has words to read.
+    uint16_t batchRate = idleMember && i == 0 ? 0 : GROUP_RATE;
+    imus[i].setAccelBatchDataRate(batchRate);
+    imus[i].setGyroBatchDataRate(batchRate);
+    imus[i].setFifoMode(FIFO_MODE_CONTINUOUS);
+    imus[i].enableTimestamp();
+    group.add(imus[i]);
+  }
+
+  // Sequentially, each counter is taken as started when its reset was
+  // sent, then the words batched before the reset are dropped.
+  uint64_t startNs[GROUP_SENSORS];
+  if( grouped )
+    group.begin();
+  else
+    for( uint8_t i = 0; i < GROUP_SENSORS; i++ ){
+      startNs[i] = hostMicros() * 1000;
+      imus[i].resetTimestamp();
+      imus[i].setFifoMode(FIFO_MODE_DISABLED);
+      imus[i].setFifoMode(FIFO_MODE_CONTINUOUS);
+    }
+
+  for( uint8_t i = 0; i < GROUP_SENSORS; i++ )
+    sims[i].resetStatistics();
+  Wire.resetCounters();
+  secondBus.resetCounters();
+
+  GroupSink sink = GroupSink();
+  uint64_t end = hostMicros() + 3 * RUN_MICROS;
+  fifoData samples[64];
+
+  while( hostMicros() < end ){
+    if( grouped ){
+      if( group.service(sink) == 0 )
+        delay(1);
+    }
+    else {
+      for( uint8_t i = 0; i < GROUP_SENSORS; i++ ){
+        if( imus[i].getUnreadFifoWords() == 0 )
+          continue;
+        uint16_t count = imus[i].fifoRead(samples, 64);
+        for( uint16_t j = 0; j < count; j++ ){
+          sink.samples++;
+          if( samples[j].fifoTag == GYROSCOPE_DATA && samples[j].timestampNs != 0 ){
+            double error = sawError(startNs[i] + samples[j].timestampNs, static_cast<int16_t>(lround(samples[j].zGyro / 0.070)));
+            if( error >= 0 ){
+              sink.errorSum[i] += error;
+              sink.errorCount[i]++;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  uint32_t lost = 0;
+  for( uint8_t i = 0; i < GROUP_SENSORS; i++ )
+    lost += sims[i].getStatistics().fifoOverruns;
+
+  double worst = 0;
+  for( uint8_t i = 0; i < GROUP_SENSORS; i++ )
+    if( sink.errorCount[i] && sink.errorSum[i] / sink.errorCount[i] > worst )
+      worst = sink.errorSum[i] / sink.errorCount[i];
+
+  printf("%-26s %10u %10u %10u %8u   timeline error %.0f us (worst sensor mean)\n",
+         idleMember ? "4 sensors, group, 1 idle" : grouped ? "4 sensors, group" : "4 sensors, sequential",
+         (unsigned)sink.samples, (unsigned)(Wire.getTransactionCount() + secondBus.getTransactionCount()),
+         (unsigned)(Wire.getByteCount() + secondBus.getByteCount()), (unsigned)lost, worst);
+}
+
+int main()
+{
+  printf("%-26s %10s %10s %10s %8s %8s\n", "path (1s @ 1660Hz)",
+         "delivered", "transfers", "bytes", "lost", "fifoWrd");
+
+  report("per-axis polling, I2C", perAxisPolling());
+  report("readAll polling, I2C", burstPolling());
+  pollStatistics pollStats;
+  report("status, then readAll, I2C", readyPolling(false, pollStats));
+  report("status+data polling, I2C", readyPolling(true, pollStats));
+  report("FIFO drain, I2C", fifoDrain(false, false));
+  report("FIFO drain, SPI", fifoDrain(true, false));
+  report("bulk FIFO drain, I2C", bulkFifoDrain(false));
+  report("bulk FIFO drain, SPI", bulkFifoDrain(true));
+  report("compressed FIFO, I2C", fifoDrain(false, true));
+  sensorGroup(false);
+  sensorGroup(true);
+  sensorGroup(true, true);
+
+  printf("\nstatus+data polling: %u polls, %u found nothing new, %u accel and %u gyro samples\n",
+         (unsigned)pollStats.polls, (unsigned)pollStats.emptyPolls,
+         (unsigned)pollStats.accelSamples, (unsigned)pollStats.gyroSamples);
+
+  postProcessing();
+  milliPath();
+  ringEvents(DRAIN_PERIOD_MS);
+  ringEvents(100);
+  initCost();
+  pageAccess();
+  fsmAccess();
+  ucfReplay();
+  ahrsAccuracy();
+  ekfCost();
+  calibration();
+  streamOutput();
+  logCompression();
+
+  return 0;
+}
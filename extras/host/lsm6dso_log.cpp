@@ -0,0 +1,81 @@
+/******************************************************************************
+lsm6dso_log.cpp
+Decode a compressed LSM6DSO log into CSV
+
+Usage: lsm6dso_log log [startTicks]
+
+Maps the LSM6DSOLogEncoder file into memory and prints one CSV line per
+sample, in the same columns as lsm6dso_stream: sensor time in ticks,
+gyroscope in mdps and accelerometer in mg. With startTicks it jumps to the
+block holding that time instead of decoding the log from the beginning.
+Block errors go to stderr at the end.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#include "SparkFunLSM6DSO_Log.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+  if( argc < 2 ){
+    fprintf(stderr, "usage: %s log [startTicks]\n", argv[0]);
+    return 1;
+  }
+
+  int file = open(argv[1], O_RDONLY);
+  struct stat info;
+  if( file < 0 || fstat(file, &info) != 0 ){
+    fprintf(stderr, "can't open %s\n", argv[1]);
+    return 1;
+  }
+
+  const uint8_t *data = 0;
+  if( info.st_size > 0 ){
+    void *mapping = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if( mapping == MAP_FAILED ){
+      fprintf(stderr, "can't map %s\n", argv[1]);
+      return 1;
+    }
+    data = static_cast<const uint8_t *>(mapping);
+  }
+
+  LSM6DSOLogReader reader(data, info.st_size);
+  uint32_t startTicks = 0;
+  if( argc > 2 ){
+    startTicks = strtoul(argv[2], 0, 0);
+    if( !reader.seekTicks(startTicks) )
+      reader.rewind();
+  }
+
+  streamRecord record;
+  uint32_t records = 0;
+
+  printf("ticks,gx_mdps,gy_mdps,gz_mdps,ax_mg,ay_mg,az_mg\n");
+
+  while( reader.read(record) ){
+    if( static_cast<int32_t>(record.ticks - startTicks) < 0 )
+      continue;
+    printf("%lu,%ld,%ld,%ld,%ld,%ld,%ld\n", (unsigned long)record.ticks,
+           (long)record.milliGyro[0], (long)record.milliGyro[1], (long)record.milliGyro[2],
+           (long)record.milliAccel[0], (long)record.milliAccel[1], (long)record.milliAccel[2]);
+    records++;
+  }
+
+  fprintf(stderr, "%lu records, %lu bad blocks, %lu bytes skipped\n",
+          (unsigned long)records, (unsigned long)reader.getCrcErrors(),
+          (unsigned long)reader.getSkippedBytes());
+
+  if( data )
+    munmap(const_cast<uint8_t *>(data), info.st_size);
+  close(file);
+  return 0;
+}
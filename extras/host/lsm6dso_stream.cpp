@@ -0,0 +1,61 @@
+/******************************************************************************
+lsm6dso_stream.cpp
+Decode a binary LSM6DSO stream into CSV
+
+Usage: lsm6dso_stream [capture]
+
+Reads LSM6DSOStreamEncoder frames from the file, or from stdin without one,
+and prints one CSV line per record: sensor time in ticks, gyroscope in mdps
+and accelerometer in mg. Frame errors go to stderr at the end. On Linux a
+board streaming over USB serial can be read directly:
+
+  stty -F /dev/ttyACM0 921600 raw
+  lsm6dso_stream /dev/ttyACM0 > capture.csv
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#include "SparkFunLSM6DSO_Stream.h"
+
+#include <stdio.h>
+
+int main(int argc, char *argv[])
+{
+  FILE *input = stdin;
+  if( argc > 1 ){
+    input = fopen(argv[1], "rb");
+    if( !input ){
+      fprintf(stderr, "can't open %s\n", argv[1]);
+      return 1;
+    }
+  }
+
+  LSM6DSOStreamDecoder decoder;
+  streamRecord record;
+  uint32_t records = 0;
+  int value;
+
+  printf("ticks,gx_mdps,gy_mdps,gz_mdps,ax_mg,ay_mg,az_mg\n");
+
+  while( (value = fgetc(input)) != EOF ){
+    if( !decoder.push(static_cast<uint8_t>(value)) )
+      continue;
+
+    for( uint8_t i = 0; decoder.getRecord(i, record); i++ ){
+      printf("%lu,%ld,%ld,%ld,%ld,%ld,%ld\n", (unsigned long)record.ticks,
+             (long)record.milliGyro[0], (long)record.milliGyro[1], (long)record.milliGyro[2],
+             (long)record.milliAccel[0], (long)record.milliAccel[1], (long)record.milliAccel[2]);
+      records++;
+    }
+  }
+
+  fprintf(stderr, "%lu records, %lu bad frames, %lu lost frames, %lu bytes skipped\n",
+          (unsigned long)records, (unsigned long)decoder.getCrcErrors(),
+          (unsigned long)decoder.getLostFrames(), (unsigned long)decoder.getSkippedBytes());
+
+  if( input != stdin )
+    fclose(input);
+  return 0;
+}
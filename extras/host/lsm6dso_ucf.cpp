@@ -0,0 +1,53 @@
+/******************************************************************************
+lsm6dso_ucf.cpp
+Compile an ST .ucf configuration into an LSM6DSO write script
+
+Usage: lsm6dso_ucf file.ucf [name] > setup.h
+
+Prints a header declaring the script as a constexpr PROGMEM array, named
+name or lsm6dsoScript, for LSM6DSOCore::writeScript(). How many register
+writes went into how many bursts goes to stderr.
+
+This code is released under the [MIT License](http://opensource.org/licenses/MIT).
+
+Distributed as-is; no warranty is given.
+******************************************************************************/
+
+#include "LSM6DSOUcf.h"
+
+#include <stdio.h>
+#include <string>
+
+int main(int argc, char *argv[])
+{
+  if( argc < 2 ){
+    fprintf(stderr, "usage: %s file.ucf [name]\n", argv[0]);
+    return 1;
+  }
+
+  FILE *file = fopen(argv[1], "rb");
+  if( !file ){
+    fprintf(stderr, "can't open %s\n", argv[1]);
+    return 1;
+  }
+
+  std::string text;
+  char buffer[4096];
+  size_t count;
+  while( (count = fread(buffer, 1, sizeof(buffer), file)) > 0 )
+    text.append(buffer, count);
+  fclose(file);
+
+  LSM6DSOUcfCompiler compiler;
+  if( !compiler.compile(text.data(), text.size()) ){
+    fprintf(stderr, "%s:%u: %s\n", argv[1], (unsigned)compiler.getErrorLine(), compiler.getError().c_str());
+    return 1;
+  }
+
+  compiler.emit(stdout, argc > 2 ? argv[2] : "lsm6dsoScript");
+
+  fprintf(stderr, "%u writes and %u waits as %u bursts, %u script bytes\n",
+          (unsigned)compiler.getWrites(), (unsigned)compiler.getWaits(),
+          (unsigned)compiler.getBursts(), (unsigned)compiler.getScript().size());
+  return 0;
+}